@@ -0,0 +1,6 @@
+#pragma once
+// Host port: "cycles" are nanoseconds of CLOCK_MONOTONIC, truncated like
+// the device's 32-bit CCOUNT
+#include <stdint.h>
+
+uint32_t esp_cpu_get_cycle_count(void);
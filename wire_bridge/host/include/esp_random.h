@@ -0,0 +1,7 @@
+#pragma once
+// Host port: esp_random() from the kernel's getrandom() (port.c)
+#include <stdint.h>
+#include <stddef.h>
+
+uint32_t esp_random(void);
+void     esp_fill_random(void *buf, size_t len);
@@ -0,0 +1,16 @@
+#pragma once
+// Host port: the SPIFFS partition is a directory (the base path, created
+// on registration) with a fixed size, 3 MB as in partitions.csv (port.c)
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    const char *base_path;
+    const char *partition_label;
+    size_t max_files;
+    bool format_if_mount_failed;
+} esp_vfs_spiffs_conf_t;
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf);
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes);
@@ -0,0 +1,33 @@
+#pragma once
+// Host port: FreeRTOS types and critical sections on pthreads (port.c).
+// Every portMUX is the same process-wide recursive mutex.
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+
+void host_crit_enter(void);
+void host_crit_exit(void);
+
+#define portENTER_CRITICAL(m) do { (void)(m); host_crit_enter(); } while (0)
+#define portEXIT_CRITICAL(m)  do { (void)(m); host_crit_exit(); } while (0)
+#define taskENTER_CRITICAL(m) portENTER_CRITICAL(m)
+#define taskEXIT_CRITICAL(m)  portEXIT_CRITICAL(m)
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE  1
+#define pdFALSE 0
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define configTICK_RATE_HZ 1000
+#define configMAX_PRIORITIES 25
+#define portNUM_PROCESSORS 2            // topologies name the ESP32's cores
+#define tskNO_AFFINITY     0x7FFFFFFF
+#define portMAX_DELAY      ((TickType_t)0xFFFFFFFFu)
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))      // 1 tick = 1 ms
@@ -0,0 +1,24 @@
+#pragma once
+// Host port: tasks are detached pthreads with a notification counter
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core);
+void       vTaskDelete(TaskHandle_t t);       // NULL = self
+void       vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *name);
+UBaseType_t  uxTaskPriorityGet(TaskHandle_t t);
+BaseType_t   xPortGetCoreID(void);
+uint32_t     ulTaskGetRunTimeCounter(TaskHandle_t t);
+UBaseType_t  uxTaskGetStackHighWaterMark(TaskHandle_t t);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t);
+uint32_t   ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
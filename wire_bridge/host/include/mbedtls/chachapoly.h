@@ -0,0 +1,25 @@
+#pragma once
+// Host port: the mbedTLS ChaCha20-Poly1305 calls crypt.c makes, on OpenSSL
+// (port_crypto.c)
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_ERR_CHACHAPOLY_AUTH_FAILED -0x0056
+
+typedef struct {
+    void *evp;                  // EVP_CIPHER_CTX
+} mbedtls_chachapoly_context;
+
+void mbedtls_chachapoly_init(mbedtls_chachapoly_context *ctx);
+int  mbedtls_chachapoly_setkey(mbedtls_chachapoly_context *ctx, const unsigned char key[32]);
+int  mbedtls_chachapoly_encrypt_and_tag(mbedtls_chachapoly_context *ctx, size_t length,
+                                        const unsigned char nonce[12],
+                                        const unsigned char *aad, size_t aad_len,
+                                        const unsigned char *input, unsigned char *output,
+                                        unsigned char tag[16]);
+int  mbedtls_chachapoly_auth_decrypt(mbedtls_chachapoly_context *ctx, size_t length,
+                                     const unsigned char nonce[12],
+                                     const unsigned char *aad, size_t aad_len,
+                                     const unsigned char tag[16],
+                                     const unsigned char *input, unsigned char *output);
+void mbedtls_chachapoly_free(mbedtls_chachapoly_context *ctx);
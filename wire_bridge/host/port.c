@@ -0,0 +1,684 @@
+// port.c — Linux side of the ESP-IDF / FreeRTOS stand-ins in include/
+//
+// Just enough of each API for the bridge core: critical sections, tasks
+// with notifications, queues, esp_timer on a dispatch thread, heap_caps
+// on the C heap, NVS held in memory and SPIFFS as a directory. All blocking waits are on CLOCK_MONOTONIC.
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_random.h"
+#include "esp_spiffs.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+static pthread_mutex_t s_crit = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_crit_enter(void)
+{
+    pthread_mutex_lock(&s_crit);
+}
+
+void host_crit_exit(void)
+{
+    pthread_mutex_unlock(&s_crit);
+}
+
+const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_ERR";
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint32_t esp_cpu_get_cycle_count(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec);
+}
+
+// Condition variables wait on CLOCK_MONOTONIC; ticks are ms
+static void cond_init(pthread_cond_t *cv)
+{
+    pthread_condattr_t a;
+    pthread_condattr_init(&a);
+    pthread_condattr_setclock(&a, CLOCK_MONOTONIC);
+    pthread_cond_init(cv, &a);
+    pthread_condattr_destroy(&a);
+}
+
+static void deadline_after_us(struct timespec *ts, int64_t us)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += us / 1000000;
+    ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000;
+    }
+}
+
+// false = timed out
+static bool cond_wait_ticks(pthread_cond_t *cv, pthread_mutex_t *mu, const struct timespec *dl, TickType_t ticks)
+{
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(cv, mu);
+        return true;
+    }
+    return pthread_cond_timedwait(cv, mu, dl) == 0;
+}
+
+// ---- tasks ----
+
+struct host_task {
+    TaskFunction_t  fn;
+    void           *arg;
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    uint32_t        notify;
+    pthread_t       th;
+    UBaseType_t     prio;
+};
+
+static __thread struct host_task *t_self;
+
+static void *task_main(void *p)
+{
+    struct host_task *t = (struct host_task *)p;
+    t_self = t;
+    t->fn(t->arg);
+    return NULL;
+}
+
+static struct host_task *task_new(TaskFunction_t fn, void *arg)
+{
+    struct host_task *t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    t->fn = fn;
+    t->arg = arg;
+    pthread_mutex_init(&t->mu, NULL);
+    cond_init(&t->cv);
+    return t;
+}
+
+// core = CPU (core % online CPUs) for the thread's affinity, or
+// tskNO_AFFINITY. Stack and priority are the kernel's: threads are CFS.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack,
+                                   void *arg, UBaseType_t prio, TaskHandle_t *out, BaseType_t core)
+{
+    (void)stack;
+
+    struct host_task *t = task_new(fn, arg);
+    if (!t) return pdFAIL;
+    t->prio = prio;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (core != tskNO_AFFINITY) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET((int)(core % (ncpu > 0 ? ncpu : 1)), &set);
+        pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    pthread_t th;
+    int rc = pthread_create(&th, &attr, task_main, t);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        free(t);
+        return pdFAIL;
+    }
+    t->th = th;
+    if (name) {
+        char n[16];
+        strncpy(n, name, sizeof(n) - 1);
+        n[sizeof(n) - 1] = 0;
+        pthread_setname_np(th, n);
+    }
+    pthread_detach(th);
+    if (out) *out = t;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack,
+                       void *arg, UBaseType_t prio, TaskHandle_t *out)
+{
+    return xTaskCreatePinnedToCore(fn, name, stack, arg, prio, out, tskNO_AFFINITY);
+}
+
+static struct host_task *task_self(void)
+{
+    // a thread not started by xTaskCreate gets its record on first use
+    if (!t_self) {
+        t_self = task_new(NULL, NULL);
+        if (t_self) t_self->th = pthread_self();
+    }
+    return t_self;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return task_self();
+}
+
+// Driver tasks (emac_rx, wifi, taskLVGL) do not exist here
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+    (void)name;
+    return NULL;
+}
+
+void vTaskDelete(TaskHandle_t t)
+{
+    // only self-deletion; the record stays, handles may still be held
+    if (t == NULL || t == t_self) pthread_exit(NULL);
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t t)
+{
+    if (!t) t = task_self();
+    return t ? t->prio : 0;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+}
+
+// Thread CPU time in µs, as FreeRTOS run-time stats on esp_timer count
+uint32_t ulTaskGetRunTimeCounter(TaskHandle_t t)
+{
+    clockid_t clk;
+    struct timespec ts;
+    if (!t || pthread_getcpuclockid(t->th, &clk) != 0 || clock_gettime(clk, &ts) != 0) return 0;
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000);
+}
+
+// Not measured: threads have the kernel's stack
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t t)
+{
+    (void)t;
+    return 0;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t t)
+{
+    pthread_mutex_lock(&t->mu);
+    t->notify++;
+    pthread_cond_signal(&t->cv);
+    pthread_mutex_unlock(&t->mu);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    struct host_task *t = task_self();
+
+    struct timespec dl;
+    if (ticks != portMAX_DELAY) deadline_after_us(&dl, (int64_t)ticks * 1000);
+
+    pthread_mutex_lock(&t->mu);
+    while (t->notify == 0 && ticks != 0) {
+        if (!cond_wait_ticks(&t->cv, &t->mu, &dl, ticks)) break;
+    }
+    uint32_t v = t->notify;
+    if (v) t->notify = clear ? 0 : v - 1;
+    pthread_mutex_unlock(&t->mu);
+    return v;
+}
+
+// ---- queues ----
+
+struct host_queue {
+    pthread_mutex_t mu;
+    pthread_cond_t  cv;
+    uint32_t len, isz, head, count;
+    uint8_t  buf[];
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t len, UBaseType_t item_size)
+{
+    struct host_queue *q = calloc(1, sizeof(*q) + (size_t)len * item_size);
+    if (!q) return NULL;
+    pthread_mutex_init(&q->mu, NULL);
+    cond_init(&q->cv);
+    q->len = len;
+    q->isz = item_size;
+    return q;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    struct timespec dl;
+    if (ticks != portMAX_DELAY) deadline_after_us(&dl, (int64_t)ticks * 1000);
+
+    pthread_mutex_lock(&q->mu);
+    while (q->count == q->len) {
+        if (ticks == 0 || !cond_wait_ticks(&q->cv, &q->mu, &dl, ticks)) {
+            pthread_mutex_unlock(&q->mu);
+            return pdFALSE;
+        }
+    }
+    memcpy(q->buf + (size_t)((q->head + q->count) % q->len) * q->isz, item, q->isz);
+    q->count++;
+    pthread_cond_broadcast(&q->cv);
+    pthread_mutex_unlock(&q->mu);
+    return pdTRUE;
+}
+
+static BaseType_t queue_take(QueueHandle_t q, void *item, TickType_t ticks, bool remove)
+{
+    struct timespec dl;
+    if (ticks != portMAX_DELAY) deadline_after_us(&dl, (int64_t)ticks * 1000);
+
+    pthread_mutex_lock(&q->mu);
+    while (q->count == 0) {
+        if (ticks == 0 || !cond_wait_ticks(&q->cv, &q->mu, &dl, ticks)) {
+            pthread_mutex_unlock(&q->mu);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, q->buf + (size_t)q->head * q->isz, q->isz);
+    if (remove) {
+        q->head = (q->head + 1) % q->len;
+        q->count--;
+        pthread_cond_broadcast(&q->cv);
+    }
+    pthread_mutex_unlock(&q->mu);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    return queue_take(q, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    return queue_take(q, item, ticks, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->mu);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->mu);
+    return n;
+}
+
+// ---- esp_timer: one dispatch thread, callbacks run there in due order ----
+
+#define HOST_TIMERS_MAX 16
+
+struct esp_timer {
+    esp_timer_cb_t cb;
+    void          *arg;
+    bool           armed;
+    int64_t        due_us;
+    int64_t        period_us;    // 0 = one-shot
+};
+
+static struct esp_timer s_timers[HOST_TIMERS_MAX];
+static int s_ntimers;
+static pthread_mutex_t s_tm_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_tm_cv;
+static pthread_once_t s_tm_once = PTHREAD_ONCE_INIT;
+
+static void *timer_main(void *arg)
+{
+    (void)arg;
+    pthread_mutex_lock(&s_tm_mu);
+    for (;;) {
+        struct esp_timer *next = NULL;
+        for (int i = 0; i < s_ntimers; i++) {
+            struct esp_timer *t = &s_timers[i];
+            if (t->armed && (!next || t->due_us < next->due_us)) next = t;
+        }
+        if (!next) {
+            pthread_cond_wait(&s_tm_cv, &s_tm_mu);
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (next->due_us > now) {
+            struct timespec dl;
+            deadline_after_us(&dl, next->due_us - now);
+            pthread_cond_timedwait(&s_tm_cv, &s_tm_mu, &dl);
+            continue;                        // rescan: timers may have changed
+        }
+
+        if (next->period_us) {
+            next->due_us += next->period_us;
+            if (next->due_us <= now) next->due_us = now + next->period_us;   // skip missed periods
+        } else {
+            next->armed = false;
+        }
+        esp_timer_cb_t cb = next->cb;
+        void *cb_arg = next->arg;
+
+        pthread_mutex_unlock(&s_tm_mu);
+        cb(cb_arg);
+        pthread_mutex_lock(&s_tm_mu);
+    }
+    return NULL;
+}
+
+static void timer_start_thread(void)
+{
+    cond_init(&s_tm_cv);
+    pthread_t th;
+    pthread_create(&th, NULL, timer_main, NULL);
+    pthread_setname_np(th, "esp_timer");
+    pthread_detach(th);
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (!args || !args->callback || !out) return ESP_ERR_INVALID_ARG;
+    pthread_once(&s_tm_once, timer_start_thread);
+
+    pthread_mutex_lock(&s_tm_mu);
+    if (s_ntimers >= HOST_TIMERS_MAX) {
+        pthread_mutex_unlock(&s_tm_mu);
+        return ESP_ERR_NO_MEM;
+    }
+    struct esp_timer *t = &s_timers[s_ntimers++];
+    t->cb = args->callback;
+    t->arg = args->arg;
+    t->armed = false;
+    pthread_mutex_unlock(&s_tm_mu);
+
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_arm(esp_timer_handle_t t, uint64_t us, bool periodic)
+{
+    pthread_mutex_lock(&s_tm_mu);
+    if (t->armed) {
+        pthread_mutex_unlock(&s_tm_mu);
+        return ESP_ERR_INVALID_STATE;        // as on the device
+    }
+    t->armed = true;
+    t->due_us = esp_timer_get_time() + (int64_t)us;
+    t->period_us = periodic ? (int64_t)us : 0;
+    pthread_cond_signal(&s_tm_cv);
+    pthread_mutex_unlock(&s_tm_mu);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t t, uint64_t timeout_us)
+{
+    return timer_arm(t, timeout_us, false);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t t, uint64_t period_us)
+{
+    return timer_arm(t, period_us, true);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_tm_mu);
+    bool was = t->armed;
+    t->armed = false;
+    pthread_mutex_unlock(&s_tm_mu);
+    return was ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t t)
+{
+    esp_timer_stop(t);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t t)
+{
+    pthread_mutex_lock(&s_tm_mu);
+    bool a = t->armed;
+    pthread_mutex_unlock(&s_tm_mu);
+    return a;
+}
+
+// ---- NVS: namespace/key -> bytes, in memory ----
+
+#define HOST_NVS_MAX 32
+
+typedef struct {
+    char     ns[16];
+    char     key[16];
+    size_t   len;
+    uint8_t *data;
+} nvs_entry_t;
+
+static nvs_entry_t s_nvs[HOST_NVS_MAX];
+static char s_nvs_ns[HOST_NVS_MAX][16];    // handle - 1 -> namespace
+static int s_nvs_handles;
+static pthread_mutex_t s_nvs_mu = PTHREAD_MUTEX_INITIALIZER;
+
+esp_err_t nvs_open(const char *ns, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    (void)mode;
+    pthread_mutex_lock(&s_nvs_mu);
+    int h = -1;
+    for (int i = 0; i < s_nvs_handles; i++) {
+        if (strncmp(s_nvs_ns[i], ns, 15) == 0) h = i;
+    }
+    if (h < 0 && s_nvs_handles < HOST_NVS_MAX) {
+        h = s_nvs_handles++;
+        strncpy(s_nvs_ns[h], ns, 15);
+    }
+    pthread_mutex_unlock(&s_nvs_mu);
+    if (h < 0) return ESP_ERR_NO_MEM;
+    *out = (nvs_handle_t)(h + 1);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t h)
+{
+    (void)h;
+}
+
+esp_err_t nvs_commit(nvs_handle_t h)
+{
+    (void)h;
+    return ESP_OK;
+}
+
+static nvs_entry_t *nvs_find(nvs_handle_t h, const char *key, bool create)
+{
+    if (h == 0 || (int)h > s_nvs_handles) return NULL;
+    const char *ns = s_nvs_ns[h - 1];
+    nvs_entry_t *free_e = NULL;
+
+    for (int i = 0; i < HOST_NVS_MAX; i++) {
+        nvs_entry_t *e = &s_nvs[i];
+        if (!e->data) {
+            if (!free_e) free_e = e;
+            continue;
+        }
+        if (strncmp(e->ns, ns, 15) == 0 && strncmp(e->key, key, 15) == 0) return e;
+    }
+    if (!create || !free_e) return NULL;
+    strncpy(free_e->ns, ns, 15);
+    strncpy(free_e->key, key, 15);
+    return free_e;
+}
+
+static esp_err_t nvs_get(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    pthread_mutex_lock(&s_nvs_mu);
+    nvs_entry_t *e = nvs_find(h, key, false);
+    esp_err_t err = ESP_OK;
+    if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out) {
+        *len = e->len;
+    } else if (*len < e->len) {
+        err = ESP_ERR_NVS_INVALID_LENGTH;
+    } else {
+        memcpy(out, e->data, e->len);
+        *len = e->len;
+    }
+    pthread_mutex_unlock(&s_nvs_mu);
+    return err;
+}
+
+static esp_err_t nvs_set(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    uint8_t *copy = malloc(len ? len : 1);
+    if (!copy) return ESP_ERR_NO_MEM;
+    memcpy(copy, value, len);
+
+    pthread_mutex_lock(&s_nvs_mu);
+    nvs_entry_t *e = nvs_find(h, key, true);
+    if (e) {
+        free(e->data);
+        e->data = copy;
+        e->len = len;
+    }
+    pthread_mutex_unlock(&s_nvs_mu);
+    if (!e) free(copy);
+    return e ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t h, const char *key, char *out, size_t *len)
+{
+    return nvs_get(h, key, out, len);
+}
+
+esp_err_t nvs_set_str(nvs_handle_t h, const char *key, const char *value)
+{
+    return nvs_set(h, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t h, const char *key, void *out, size_t *len)
+{
+    return nvs_get(h, key, out, len);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t h, const char *key, const void *value, size_t len)
+{
+    return nvs_set(h, key, value, len);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t h, const char *key, uint32_t *out)
+{
+    size_t len = sizeof(*out);
+    return nvs_get(h, key, out, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t h, const char *key, uint32_t value)
+{
+    return nvs_set(h, key, &value, sizeof(value));
+}
+
+// ---- heap_caps: the C heap ----
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps)
+{
+    (void)caps;
+    void *p;
+    return posix_memalign(&p, alignment, size) == 0 ? p : NULL;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+void heap_caps_free(void *ptr)
+{
+    free(ptr);
+}
+
+// ---- esp_random ----
+
+void esp_fill_random(void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len) {
+        ssize_t n = getrandom(p, len, 0);
+        if (n <= 0) continue;       // EINTR; the pool is ready after boot
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+uint32_t esp_random(void)
+{
+    uint32_t v;
+    esp_fill_random(&v, sizeof(v));
+    return v;
+}
+
+// ---- SPIFFS: one partition, a directory ----
+
+#define HOST_SPIFFS_BYTES (3u << 20)
+
+static char s_spiffs_base[128];
+
+esp_err_t esp_vfs_spiffs_register(const esp_vfs_spiffs_conf_t *conf)
+{
+    if (!conf || !conf->base_path || strlen(conf->base_path) >= sizeof(s_spiffs_base)) return ESP_ERR_INVALID_ARG;
+    if (mkdir(conf->base_path, 0755) != 0 && errno != EEXIST) return ESP_FAIL;
+    strcpy(s_spiffs_base, conf->base_path);
+    return ESP_OK;
+}
+
+// used = the files in the directory
+esp_err_t esp_spiffs_info(const char *partition_label, size_t *total_bytes, size_t *used_bytes)
+{
+    (void)partition_label;
+    DIR *d = s_spiffs_base[0] ? opendir(s_spiffs_base) : NULL;
+    if (!d) return ESP_ERR_INVALID_STATE;
+
+    size_t used = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        char path[sizeof(s_spiffs_base) + 256];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", s_spiffs_base, e->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) used += (size_t)st.st_size;
+    }
+    closedir(d);
+    *total_bytes = HOST_SPIFFS_BYTES;
+    *used_bytes = used;
+    return ESP_OK;
+}
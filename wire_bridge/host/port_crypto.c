@@ -0,0 +1,132 @@
+// port_crypto.c — mbedTLS AEAD calls used by crypt.c, on OpenSSL's EVP
+//
+// Each context keeps one EVP_CIPHER_CTX keyed at setkey; a call only
+// sets the nonce, so per-datagram cost is the cipher itself (AES-NI /
+// SIMD ChaCha on x86, unlike the ESP32).
+
+#include <string.h>
+#include <openssl/evp.h>
+
+#include "mbedtls/gcm.h"
+#include "mbedtls/chachapoly.h"
+
+static int evp_setkey(void **evp, const EVP_CIPHER *cipher, const unsigned char *key)
+{
+    if (!*evp) *evp = EVP_CIPHER_CTX_new();
+    if (!*evp) return -1;
+    // direction is chosen per call; key schedule once
+    if (EVP_CipherInit_ex(*evp, cipher, NULL, NULL, NULL, 1) != 1) return -1;
+    if (EVP_CIPHER_CTX_ctrl(*evp, EVP_CTRL_AEAD_SET_IVLEN, 12, NULL) != 1) return -1;
+    return EVP_CipherInit_ex(*evp, NULL, NULL, key, NULL, -1) == 1 ? 0 : -1;
+}
+
+static int evp_seal(void *evp, size_t len, const unsigned char *iv,
+                    const unsigned char *aad, size_t aad_len,
+                    const unsigned char *in, unsigned char *out, size_t tag_len, unsigned char *tag)
+{
+    int n;
+    if (!evp || EVP_CipherInit_ex(evp, NULL, NULL, NULL, iv, 1) != 1) return -1;
+    if (aad_len && EVP_CipherUpdate(evp, NULL, &n, aad, (int)aad_len) != 1) return -1;
+    if (len && EVP_CipherUpdate(evp, out, &n, in, (int)len) != 1) return -1;
+    if (EVP_CipherFinal_ex(evp, out + len, &n) != 1) return -1;
+    return EVP_CIPHER_CTX_ctrl(evp, EVP_CTRL_AEAD_GET_TAG, (int)tag_len, tag) == 1 ? 0 : -1;
+}
+
+// 0 = authentic, 1 = tag mismatch, -1 = error
+static int evp_open(void *evp, size_t len, const unsigned char *iv,
+                    const unsigned char *aad, size_t aad_len,
+                    const unsigned char *tag, size_t tag_len,
+                    const unsigned char *in, unsigned char *out)
+{
+    int n;
+    unsigned char t[16];
+    if (!evp || tag_len > sizeof(t)) return -1;
+    memcpy(t, tag, tag_len);      // input may be overwritten in place
+    if (EVP_CipherInit_ex(evp, NULL, NULL, NULL, iv, 0) != 1) return -1;
+    if (aad_len && EVP_CipherUpdate(evp, NULL, &n, aad, (int)aad_len) != 1) return -1;
+    if (len && EVP_CipherUpdate(evp, out, &n, in, (int)len) != 1) return -1;
+    if (EVP_CIPHER_CTX_ctrl(evp, EVP_CTRL_AEAD_SET_TAG, (int)tag_len, t) != 1) return -1;
+    return EVP_CipherFinal_ex(evp, out + len, &n) == 1 ? 0 : 1;
+}
+
+// ---- GCM ----
+
+void mbedtls_gcm_init(mbedtls_gcm_context *ctx)
+{
+    ctx->evp = NULL;
+}
+
+int mbedtls_gcm_setkey(mbedtls_gcm_context *ctx, mbedtls_cipher_id_t cipher,
+                       const unsigned char *key, unsigned int keybits)
+{
+    const EVP_CIPHER *c = keybits == 128 ? EVP_aes_128_gcm() :
+                          keybits == 192 ? EVP_aes_192_gcm() :
+                          keybits == 256 ? EVP_aes_256_gcm() : NULL;
+    if (cipher != MBEDTLS_CIPHER_ID_AES || !c) return MBEDTLS_ERR_GCM_BAD_INPUT;
+    return evp_setkey(&ctx->evp, c, key) == 0 ? 0 : MBEDTLS_ERR_GCM_BAD_INPUT;
+}
+
+int mbedtls_gcm_crypt_and_tag(mbedtls_gcm_context *ctx, int mode, size_t length,
+                              const unsigned char *iv, size_t iv_len,
+                              const unsigned char *add, size_t add_len,
+                              const unsigned char *input, unsigned char *output,
+                              size_t tag_len, unsigned char *tag)
+{
+    if (mode != MBEDTLS_GCM_ENCRYPT || iv_len != 12) return MBEDTLS_ERR_GCM_BAD_INPUT;
+    return evp_seal(ctx->evp, length, iv, add, add_len, input, output, tag_len, tag) == 0
+           ? 0 : MBEDTLS_ERR_GCM_BAD_INPUT;
+}
+
+int mbedtls_gcm_auth_decrypt(mbedtls_gcm_context *ctx, size_t length,
+                             const unsigned char *iv, size_t iv_len,
+                             const unsigned char *add, size_t add_len,
+                             const unsigned char *tag, size_t tag_len,
+                             const unsigned char *input, unsigned char *output)
+{
+    if (iv_len != 12) return MBEDTLS_ERR_GCM_BAD_INPUT;
+    int r = evp_open(ctx->evp, length, iv, add, add_len, tag, tag_len, input, output);
+    return r == 0 ? 0 : r > 0 ? MBEDTLS_ERR_GCM_AUTH_FAILED : MBEDTLS_ERR_GCM_BAD_INPUT;
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context *ctx)
+{
+    EVP_CIPHER_CTX_free(ctx->evp);
+    ctx->evp = NULL;
+}
+
+// ---- ChaCha20-Poly1305 ----
+
+void mbedtls_chachapoly_init(mbedtls_chachapoly_context *ctx)
+{
+    ctx->evp = NULL;
+}
+
+int mbedtls_chachapoly_setkey(mbedtls_chachapoly_context *ctx, const unsigned char key[32])
+{
+    return evp_setkey(&ctx->evp, EVP_chacha20_poly1305(), key);
+}
+
+int mbedtls_chachapoly_encrypt_and_tag(mbedtls_chachapoly_context *ctx, size_t length,
+                                       const unsigned char nonce[12],
+                                       const unsigned char *aad, size_t aad_len,
+                                       const unsigned char *input, unsigned char *output,
+                                       unsigned char tag[16])
+{
+    return evp_seal(ctx->evp, length, nonce, aad, aad_len, input, output, 16, tag);
+}
+
+int mbedtls_chachapoly_auth_decrypt(mbedtls_chachapoly_context *ctx, size_t length,
+                                    const unsigned char nonce[12],
+                                    const unsigned char *aad, size_t aad_len,
+                                    const unsigned char tag[16],
+                                    const unsigned char *input, unsigned char *output)
+{
+    int r = evp_open(ctx->evp, length, nonce, aad, aad_len, tag, 16, input, output);
+    return r == 0 ? 0 : MBEDTLS_ERR_CHACHAPOLY_AUTH_FAILED;
+}
+
+void mbedtls_chachapoly_free(mbedtls_chachapoly_context *ctx)
+{
+    EVP_CIPHER_CTX_free(ctx->evp);
+    ctx->evp = NULL;
+}
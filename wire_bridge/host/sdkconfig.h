@@ -0,0 +1,99 @@
+#pragma once
+// Host port: the Kconfig defaults (main/Kconfig) with the Linux UDP
+// transport in place of the Wi-Fi ones. Options go on and off with -D on
+// the make line, e.g. make EXTRA="-DCONFIG_WB_FEC=1 -DCONFIG_WB_LP=0".
+
+// the AP end unless built as the STA (make check's sink)
+#if !CONFIG_WB_ROLE_STA
+#define CONFIG_WB_ROLE_AP 1
+#endif
+#define CONFIG_WB_TRANSPORT_LINUX 1
+
+#ifndef CONFIG_WB_UDP_PORT
+#define CONFIG_WB_UDP_PORT 3333
+#endif
+#define CONFIG_WB_MAX_PAYLOAD 1200
+#define CONFIG_WB_REASM_SLOTS 4
+#define CONFIG_WB_REASM_TIMEOUT_MS 50
+#ifndef CONFIG_WB_POOL_FRAMES
+#if CONFIG_WB_HUB
+#define CONFIG_WB_POOL_FRAMES 65
+#elif CONFIG_WB_ARQ
+#define CONFIG_WB_POOL_FRAMES 69
+#else
+#define CONFIG_WB_POOL_FRAMES 53
+#endif
+#endif
+
+#define CONFIG_WB_TXQ_DEPTH_RT 8
+#define CONFIG_WB_TXQ_DEPTH_CTRL 8
+#define CONFIG_WB_TXQ_DEPTH_BE 16
+#define CONFIG_WB_TXQ_DEPTH_BULK 16
+
+#ifndef CONFIG_WB_FDB
+#define CONFIG_WB_FDB 1
+#endif
+#define CONFIG_WB_FDB_SIZE 256
+#define CONFIG_WB_FDB_AGE_S 300
+
+#ifndef CONFIG_WB_PMTU
+#define CONFIG_WB_PMTU 1
+#endif
+#define CONFIG_WB_PMTU_PROBE_MS 1000
+#define CONFIG_WB_PMTU_RSSI_WEAK -70
+
+#ifndef CONFIG_WB_LP
+#define CONFIG_WB_LP 1
+#endif
+#define CONFIG_WB_LP_INTERVAL_MS 100
+
+#ifndef CONFIG_WB_AGG
+#define CONFIG_WB_AGG 1
+#endif
+#define CONFIG_WB_AGG_MAX_FRAME 256
+#ifndef CONFIG_WB_AGG_FLUSH_US
+#define CONFIG_WB_AGG_FLUSH_US 300
+#endif
+
+#ifndef CONFIG_WB_LAT
+#define CONFIG_WB_LAT 1
+#endif
+
+#ifndef CONFIG_WB_CAP
+#define CONFIG_WB_CAP 1
+#endif
+#define CONFIG_WB_CAP_RING_KB 32
+#define CONFIG_WB_CAP_SNAPLEN 128
+#define CONFIG_WB_CAP_POINTS 3
+#if !CONFIG_WB_CAP_TRIG_MATCH && !CONFIG_WB_CAP_TRIG_DROP
+#define CONFIG_WB_CAP_TRIG_MANUAL 1
+#endif
+#ifndef CONFIG_WB_CAP_FILTER
+#define CONFIG_WB_CAP_FILTER ""
+#endif
+#ifndef CONFIG_WB_CAP_POST_FRAMES
+#define CONFIG_WB_CAP_POST_FRAMES 0
+#endif
+#define CONFIG_WB_CAP_FILE_KB 512
+
+// Used when an option above is switched on with -D
+#define CONFIG_WB_FEC_GROUP 4
+#define CONFIG_WB_FEC_HOLD_MS 5
+#define CONFIG_WB_ARQ_WINDOW 16
+#define CONFIG_WB_ARQ_BUDGET_MS 40
+#define CONFIG_WB_ARQ_NACK_MS 4
+#define CONFIG_WB_DMX_STREAMS 8
+#define CONFIG_WB_DMX_KEY_MS 1000
+#define CONFIG_WB_COMP_MIN 64
+#define CONFIG_WB_TOPO ""
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS 1
+#define CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER 1
+#define CONFIG_WB_CRYPT_KEY "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+#define CONFIG_WB_PF_DEFAULT_RULES "drop udp dst 5353; drop udp dst 1900; drop icmp6 type 134"
+#define CONFIG_WB_SHAPE_POLICY_DELAY 1
+#define CONFIG_WB_SHAPE_RT_KBPS 0
+#define CONFIG_WB_SHAPE_CTRL_KBPS 0
+#define CONFIG_WB_SHAPE_BE_KBPS 0
+#define CONFIG_WB_SHAPE_BULK_KBPS 10000
+#define CONFIG_WB_SHAPE_BCAST_KBPS 2000
+#define CONFIG_WB_SHAPE_BURST_KB 16
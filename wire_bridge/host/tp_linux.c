@@ -0,0 +1,106 @@
+// tp_linux.c — wb_transport_t over one Linux UDP socket
+//
+// The host port runs point-to-point only: datagrams go to the configured
+// peer address and only datagrams from it are handed to the tunnel, so
+// several instances can share a host on different ports (or netns).
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+#include "transport.h"
+#include "bridge_cfg.h"
+#include "tp_linux.h"
+#include "task_topo.h"
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "wb_tp_linux";
+
+#define WB_LINUX_MTU 1472         // one 1500-byte IPv4 packet, as on the device
+
+static wb_tp_rx_cb_t s_rx = NULL;
+static int s_sock = -1;
+static struct sockaddr_in s_local;
+static struct sockaddr_in s_peer;
+
+void wb_tp_linux_config(const struct sockaddr_in *local, const struct sockaddr_in *peer)
+{
+    s_local = *local;
+    s_peer = *peer;
+}
+
+static void linux_rx_task(void *arg)
+{
+    (void)arg;
+    uint8_t rxbuf[2048] __attribute__((aligned(4)));
+
+    while (1) {
+        struct sockaddr_in src;
+        socklen_t slen = sizeof(src);
+        int n = recvfrom(s_sock, rxbuf, sizeof(rxbuf), 0, (struct sockaddr *)&src, &slen);
+        if (n <= 0) continue;
+        if (src.sin_addr.s_addr != s_peer.sin_addr.s_addr || src.sin_port != s_peer.sin_port) continue;
+        s_rx(WB_IP_STA_LAST, rxbuf, n);
+    }
+}
+
+static bool linux_open(wb_tp_rx_cb_t rx)
+{
+    s_rx = rx;
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s_sock < 0) {
+        ESP_LOGE(TAG, "socket: %s", strerror(errno));
+        return false;
+    }
+
+    // room for a burst while the RX task is descheduled
+    int rcvbuf = 4 << 20;
+    (void)setsockopt(s_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (bind(s_sock, (struct sockaddr *)&s_local, sizeof(s_local)) != 0) {
+        ESP_LOGE(TAG, "bind %s:%u: %s", inet_ntoa(s_local.sin_addr), ntohs(s_local.sin_port),
+                 strerror(errno));
+        close(s_sock);
+        s_sock = -1;
+        return false;
+    }
+
+    wb_task_create(WB_STAGE_UDP_RX, linux_rx_task, NULL, NULL);
+    return true;
+}
+
+static int linux_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    (void)to;                             // the one peer
+
+    struct iovec iov[WB_SEG_MAX];
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) {
+        iov[i].iov_base = (void *)seg[i].p;
+        iov[i].iov_len = seg[i].len;
+        n += seg[i].len;
+    }
+    if (n > WB_LINUX_MTU) return -1;
+
+    struct msghdr msg = {
+        .msg_name = &s_peer,
+        .msg_namelen = sizeof(s_peer),
+        .msg_iov = iov,
+        .msg_iovlen = nseg,
+    };
+    return (int)sendmsg(s_sock, &msg, 0);
+}
+
+const wb_transport_t wb_tp_linux = {
+    .name = "linux",
+    .mtu  = WB_LINUX_MTU,
+    .open = linux_open,
+    .send = linux_send,
+};
@@ -0,0 +1,6 @@
+#pragma once
+// tp_linux.h — host port transport: tunnel datagrams on a plain UDP socket
+#include <netinet/in.h>
+
+// Before wb_udp_start(): our bind address and the one peer's address
+void wb_tp_linux_config(const struct sockaddr_in *local, const struct sockaddr_in *peer);
@@ -0,0 +1,593 @@
+// wb_bench.c — tunnel codec hot paths on the host, one key=value line per result
+//
+// The tunnel from libwbcore.a runs against a capture transport: frames go
+// in through the ETH callback path (FDB + wb_udp_send_frame), udp_tx_task
+// fragments / aggregates / encodes them into datagrams that are stored,
+// then the datagrams are replayed into the tunnel's RX entry point
+// (handle_packet: validation, reassembly, codecs, frame callback), with
+// optional reordering and loss on the way. Stages:
+//   tx       ETH callback path up to the TX queue, wall time per call
+//   tx_task  udp_tx_task CPU time (thread clock), wake-ups included
+//   rx       datagram replay to the UDP -> ETH callback, wall time
+// Per stage: ns/frame (median of the rounds), frames/s at that cost,
+// heap and frame-pool allocations per frame. With -C, packet capture is
+// armed at all four points (not triggered: the ring only, no file I/O).
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "udp_tunnel.h"
+#include "transport.h"
+#include "fdb.h"
+#include "wb_proto.h"
+#include "bridge_cfg.h"
+#include "capture.h"
+#include "wb_stats.h"
+
+#include "freertos/FreeRTOS.h"
+
+#ifndef WB_BENCH_REV
+#define WB_BENCH_REV "unknown"
+#endif
+
+// Options that are off are undefined in sdkconfig.h
+#ifndef CONFIG_WB_FEC
+#define CONFIG_WB_FEC 0
+#endif
+#ifndef CONFIG_WB_ARQ
+#define CONFIG_WB_ARQ 0
+#endif
+#ifndef CONFIG_WB_HC
+#define CONFIG_WB_HC 0
+#endif
+#ifndef CONFIG_WB_COMP
+#define CONFIG_WB_COMP 0
+#endif
+#ifndef CONFIG_WB_DMX_DELTA
+#define CONFIG_WB_DMX_DELTA 0
+#endif
+#ifndef CONFIG_WB_CRYPT
+#define CONFIG_WB_CRYPT 0
+#endif
+#if !CONFIG_WB_CRYPT
+#define WB_BENCH_CRYPT "none"
+#elif CONFIG_WB_CRYPT_CHACHAPOLY
+#define WB_BENCH_CRYPT "chachapoly"
+#else
+#define WB_BENCH_CRYPT "aes-gcm"
+#endif
+
+#define MAX_FRAMES    65535            // frame index rides in the IPv4 ID
+#define ARENA_BYTES   (128u << 20)
+#define MAX_DGRAMS    (MAX_FRAMES * 4)
+
+// ---- allocation counters (ld --wrap, see Makefile) ----
+
+static volatile bool s_count_allocs;
+static uint32_t s_heap_allocs, s_pool_allocs;          // tunnel tasks, replay
+static uint32_t s_heap_allocs_in, s_pool_allocs_in;    // ETH callback path
+static __thread bool t_eth_side;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t sz);
+void *__real_realloc(void *p, size_t n);
+uint8_t *__real_wb_pool_alloc(void);
+uint8_t *__real_wb_pool_alloc_keep(uint32_t keep);
+
+static inline void count_heap(void)
+{
+    if (s_count_allocs) __atomic_fetch_add(t_eth_side ? &s_heap_allocs_in : &s_heap_allocs, 1, __ATOMIC_RELAXED);
+}
+
+static inline void count_pool(void)
+{
+    if (s_count_allocs) __atomic_fetch_add(t_eth_side ? &s_pool_allocs_in : &s_pool_allocs, 1, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t n)              { count_heap(); return __real_malloc(n); }
+void *__wrap_calloc(size_t n, size_t sz)   { count_heap(); return __real_calloc(n, sz); }
+void *__wrap_realloc(void *p, size_t n)    { count_heap(); return __real_realloc(p, n); }
+
+// pool: only allocations that got a buffer (a full TX queue refuses some)
+uint8_t *__wrap_wb_pool_alloc(void)
+{
+    uint8_t *b = __real_wb_pool_alloc();
+    if (b) count_pool();
+    return b;
+}
+
+uint8_t *__wrap_wb_pool_alloc_keep(uint32_t keep)
+{
+    uint8_t *b = __real_wb_pool_alloc_keep(keep);
+    if (b) count_pool();
+    return b;
+}
+
+// ---- capture transport: stands in for tp_linux.c ----
+
+typedef struct {
+    uint32_t off;
+    uint16_t len;
+} dgram_t;
+
+static uint8_t *s_arena;
+static uint32_t s_arena_used;
+static dgram_t s_dg[MAX_DGRAMS];
+static uint32_t s_ndg;                 // written by udp_tx_task, read after it idles
+static uint32_t s_nsent;               // every send, control included
+static wb_tp_rx_cb_t s_tunnel_rx;
+static clockid_t s_tx_clock;
+static volatile bool s_tx_clock_ok;
+
+static bool cap_open(wb_tp_rx_cb_t rx)
+{
+    s_tunnel_rx = rx;
+    return true;
+}
+
+// udp_tx_task
+static int cap_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    (void)to;
+    if (!s_tx_clock_ok) {
+        pthread_getcpuclockid(pthread_self(), &s_tx_clock);
+        s_tx_clock_ok = true;
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) n += seg[i].len;
+    if (n > 1472) return -1;
+    __atomic_fetch_add(&s_nsent, 1, __ATOMIC_RELEASE);
+
+    // the copy stands in for the socket's; control datagrams are not replayed
+    bool ctrl = false;
+#if !CONFIG_WB_CRYPT
+    wb_hdr_t h;
+    memcpy(&h, seg[0].p, sizeof(h));
+    ctrl = h.flags & WB_F_CTRL;
+#endif
+    // sealed, the flags are ciphertext: with LP and PMTU off a TX round
+    // sends data only, and each round's fresh sequence numbers pass the
+    // replay window once
+    if (ctrl || s_ndg >= MAX_DGRAMS || s_arena_used + n > ARENA_BYTES) return (int)n;
+
+    uint8_t *o = s_arena + s_arena_used;
+    for (int i = 0; i < nseg; i++) {
+        memcpy(o, seg[i].p, seg[i].len);
+        o += seg[i].len;
+    }
+    s_dg[s_ndg].off = s_arena_used;
+    s_dg[s_ndg].len = (uint16_t)n;
+    s_arena_used += (uint32_t)n;
+    __atomic_store_n(&s_ndg, s_ndg + 1, __ATOMIC_RELEASE);
+    return (int)n;
+}
+
+const wb_transport_t wb_tp_linux = {
+    .name = "capture",
+    .mtu  = 1472,
+    .open = cap_open,
+    .send = cap_send,
+};
+
+// ---- frame mixes: IPv4/UDP frames, index in the IP ID ----
+
+static const uint8_t s_mac_dst[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x02 };
+static const uint8_t s_mac_src[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x01 };
+
+typedef struct {
+    uint8_t  *data;
+    uint16_t *len;
+    uint32_t  n;
+} mix_t;
+
+static uint32_t s_rng = 0x2545F491;
+
+static uint32_t rnd(void)
+{
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void ipv4_udp(uint8_t *f, uint16_t len, uint16_t id, uint16_t sport, uint16_t dport)
+{
+    memcpy(f, s_mac_dst, 6);
+    memcpy(f + 6, s_mac_src, 6);
+    put16(f + 12, 0x0800);
+
+    uint8_t *ip = f + 14;
+    memset(ip, 0, 20);
+    ip[0] = 0x45;
+    put16(ip + 2, (uint16_t)(len - 14));
+    put16(ip + 4, id);
+    ip[8] = 64;
+    ip[9] = 17;
+    ip[12] = 10; ip[15] = 1;
+    ip[16] = 10; ip[19] = 2;
+
+    uint8_t *udp = ip + 20;
+    put16(udp, sport);
+    put16(udp + 2, dport);
+    put16(udp + 4, (uint16_t)(len - 34));
+    put16(udp + 6, 0);
+}
+
+// ArtDmx, 512 channels, a few of them moving each frame
+static uint16_t artdmx(uint8_t *f, uint16_t id, uint8_t *levels, uint16_t universe)
+{
+    uint16_t len = 14 + 20 + 8 + 18 + 512;
+    ipv4_udp(f, len, id, 6454, 6454);
+
+    uint8_t *p = f + 42;
+    memcpy(p, "Art-Net", 8);
+    p[8] = 0x00; p[9] = 0x50;              // OpDmx
+    p[10] = 0; p[11] = 14;                 // protocol version
+    p[12] = (uint8_t)id;                   // sequence
+    p[13] = 0;
+    p[14] = (uint8_t)universe;
+    p[15] = (uint8_t)(universe >> 8);
+    put16(p + 16, 512);
+    for (int k = 0; k < 24; k++) levels[rnd() % 512]++;
+    memcpy(p + 18, levels, 512);
+    return len;
+}
+
+static uint16_t imix_len(uint32_t i)
+{
+    uint32_t k = i % 12;
+    return k < 7 ? 64 : k < 11 ? 576 : 1514;
+}
+
+static bool mix_build(mix_t *m, const char *name, uint32_t n)
+{
+    static uint8_t levels[8][512];
+
+    m->n = n;
+    m->data = malloc((size_t)n * 1514);
+    m->len = malloc((size_t)n * sizeof(uint16_t));
+    if (!m->data || !m->len) return false;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t *f = m->data + (size_t)i * 1514;
+        uint16_t len;
+
+        if (strcmp(name, "dmx") == 0 && i % 10 < 7) {
+            // 70% Art-Net over 8 universes, the rest IMIX
+            len = artdmx(f, (uint16_t)i, levels[i % 8], (uint16_t)(i % 8));
+        } else {
+            len = strcmp(name, "64") == 0 ? 64 : strcmp(name, "1514") == 0 ? 1514 : imix_len(i);
+            ipv4_udp(f, len, (uint16_t)i, 40000, 5000);
+            for (uint16_t k = 42; k < len; k++) f[k] = (uint8_t)rnd();
+        }
+        m->len[i] = len;
+    }
+    return true;
+}
+
+static void mix_free(mix_t *m)
+{
+    free(m->data);
+    free(m->len);
+}
+
+// ---- frame callbacks: bridge_core.c without counters and filter ----
+
+static const mix_t *s_cur;
+static uint32_t s_delivered, s_bad;
+static uint8_t s_eth_out[WB_MAX_FRAME];
+
+// UDP -> ETH: the copy stands in for wb_eth_send()
+static void on_udp_frame(const uint8_t *frame, size_t len, void *user)
+{
+    (void)user;
+    uint16_t id = len >= 20 ? (uint16_t)(frame[18] << 8 | frame[19]) : 0xFFFF;
+    if (!s_cur || id >= s_cur->n || s_cur->len[id] != len) {
+        s_bad++;
+        return;
+    }
+    memcpy(s_eth_out, frame, len);
+    wb_cap_frame(WB_CAP_ETH_OUT, frame, len);
+    s_delivered++;
+}
+
+// ETH -> UDP
+static bool on_eth_frame(const uint8_t *frame, size_t len)
+{
+    wb_cap_frame(WB_CAP_ETH_IN, frame, len);
+#if CONFIG_WB_FDB
+    if (wb_fdb_eth_in(frame, (uint16_t)len)) return true;
+#endif
+    return wb_udp_send_frame(frame, len);
+}
+
+// ---- timing ----
+
+static inline uint64_t now_ns(clockid_t c)
+{
+    struct timespec ts;
+    clock_gettime(c, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t s_clock_cost;          // one now_ns(CLOCK_MONOTONIC) pair
+
+static void calibrate(void)
+{
+    uint64_t t0 = now_ns(CLOCK_MONOTONIC);
+    for (int i = 0; i < 100000; i++) {
+        volatile uint64_t a = now_ns(CLOCK_MONOTONIC);
+        (void)a;
+    }
+    s_clock_cost = (now_ns(CLOCK_MONOTONIC) - t0) / 100000;
+}
+
+// Wait for udp_tx_task to go quiet: no datagram for idle_us
+static void tx_drain(uint32_t idle_us)
+{
+    uint32_t last = __atomic_load_n(&s_nsent, __ATOMIC_ACQUIRE);
+    for (;;) {
+        usleep(idle_us);
+        uint32_t n = __atomic_load_n(&s_nsent, __ATOMIC_ACQUIRE);
+        if (n == last) return;
+        last = n;
+    }
+}
+
+typedef struct {
+    double   ns;                       // per frame
+    uint32_t heap, pool;               // allocations in the run
+} sample_t;
+
+// tx + tx_task: push every frame of the mix through the tunnel
+static uint32_t s_queue_full;          // wb_udp_send_frame refusals, retried
+
+static void run_tx(const mix_t *m, sample_t *tx, sample_t *task)
+{
+    s_ndg = 0;
+    s_arena_used = 0;
+
+    uint64_t cpu0 = s_tx_clock_ok ? now_ns(s_tx_clock) : 0;
+    uint64_t in_ns = 0;
+    s_heap_allocs = s_pool_allocs = s_heap_allocs_in = s_pool_allocs_in = 0;
+    s_count_allocs = true;
+    t_eth_side = true;
+
+    for (uint32_t i = 0; i < m->n; i++) {
+        const uint8_t *f = m->data + (size_t)i * 1514;
+        for (;;) {
+            uint64_t t0 = now_ns(CLOCK_MONOTONIC);
+            bool ok = on_eth_frame(f, m->len[i]);
+            uint64_t t1 = now_ns(CLOCK_MONOTONIC);
+            if (ok) {
+                in_ns += t1 - t0;
+                break;
+            }
+            // TX queue full: let udp_tx_task catch up, refusals not timed
+            s_queue_full++;
+            sched_yield();
+        }
+    }
+    t_eth_side = false;
+    tx_drain(2000);
+
+    s_count_allocs = false;
+    uint64_t cpu1 = s_tx_clock_ok ? now_ns(s_tx_clock) : 0;
+
+    int64_t in_net = (int64_t)in_ns - (int64_t)(s_clock_cost * m->n);
+    tx->ns = in_net > 0 ? (double)in_net / m->n : 0;
+    tx->heap = s_heap_allocs_in;
+    tx->pool = s_pool_allocs_in;
+    task->ns = (double)(cpu1 - cpu0) / m->n;
+    task->heap = s_heap_allocs;
+    task->pool = s_pool_allocs;
+}
+
+typedef enum { IMP_NONE, IMP_REORDER, IMP_LOSS, IMP_BOTH } impair_t;
+static const char *const s_imp_name[] = { "none", "reorder", "loss", "reorder+loss" };
+
+// Replay order: with reorder, 5% of datagrams swap with one up to 3 later;
+// with loss, 1% are dropped
+static uint32_t replay_plan(uint32_t *order, uint32_t n, impair_t imp)
+{
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if ((imp == IMP_LOSS || imp == IMP_BOTH) && rnd() % 100 == 0) continue;
+        order[k++] = i;
+    }
+    if (imp == IMP_REORDER || imp == IMP_BOTH) {
+        for (uint32_t i = 0; i + 3 < k; i++) {
+            if (rnd() % 20) continue;
+            uint32_t j = i + 1 + rnd() % 3, t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+    }
+    return k;
+}
+
+static void run_rx(const mix_t *m, impair_t imp, sample_t *rx)
+{
+    static uint32_t order[MAX_DGRAMS];
+    uint32_t n = replay_plan(order, s_ndg, imp);
+
+    s_cur = m;
+    s_delivered = 0;
+    s_heap_allocs = s_pool_allocs = 0;
+    s_count_allocs = true;
+
+    uint64_t t0 = now_ns(CLOCK_MONOTONIC);
+    for (uint32_t i = 0; i < n; i++) {
+        const dgram_t *d = &s_dg[order[i]];
+        s_tunnel_rx(WB_IP_STA_LAST, s_arena + d->off, d->len);
+    }
+    uint64_t t1 = now_ns(CLOCK_MONOTONIC);
+
+    s_count_allocs = false;
+    rx->ns = (double)(t1 - t0) / m->n;
+    rx->heap = s_heap_allocs;
+    rx->pool = s_pool_allocs;
+}
+
+static int cmp_sample(const void *a, const void *b)
+{
+    double x = ((const sample_t *)a)->ns, y = ((const sample_t *)b)->ns;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *stage, const char *mix, const char *imp, uint32_t frames,
+                   sample_t *s, int rounds, const char *extra)
+{
+    qsort(s, rounds, sizeof(*s), cmp_sample);
+    const sample_t *med = &s[rounds / 2];
+    printf("stage=%s mix=%s impair=%s frames=%u ns_per_frame=%.1f ns_min=%.1f frames_per_s=%.0f "
+           "heap_allocs_per_frame=%.3f pool_allocs_per_frame=%.3f%s\n",
+           stage, mix, imp, frames, med->ns, s[0].ns, med->ns > 0 ? 1e9 / med->ns : 0.0,
+           (double)med->heap / frames, (double)med->pool / frames, extra);
+    fflush(stdout);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-n frames] [-r rounds] [-m mix,...] [-i impair,...] [-C]\n"
+            "  mixes:   64 imix 1514 dmx          (default: all)\n"
+            "  impairs: none reorder loss both    (default: all)\n"
+            "  -C       packet capture armed at all points (needs CONFIG_WB_CAP)\n", argv0);
+}
+
+static bool listed(const char *list, const char *item)
+{
+    if (!list) return true;
+    size_t n = strlen(item);
+    for (const char *p = list; (p = strstr(p, item)) != NULL; p += n) {
+        bool start = p == list || p[-1] == ',';
+        bool end = p[n] == 0 || p[n] == ',';
+        if (start && end) return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 20000;
+    int rounds = 5;
+    const char *mixes = NULL, *impairs = NULL;
+    bool cap = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:r:m:i:Ch")) != -1) {
+        switch (c) {
+        case 'n': frames = (uint32_t)atoi(optarg); break;
+        case 'r': rounds = atoi(optarg); break;
+        case 'm': mixes = optarg; break;
+        case 'i': impairs = optarg; break;
+        case 'C': cap = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (frames == 0 || frames > MAX_FRAMES || rounds < 1 || rounds > 64) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    s_arena = malloc(ARENA_BYTES);
+    if (!s_arena) return 1;
+    calibrate();
+    wb_udp_start(on_udp_frame, NULL);
+#if CONFIG_WB_CAP
+    if (cap) {
+        wb_cap_cfg_t cc = *wb_cap_default_cfg();
+        cc.points = (1u << WB_CAP_POINTS) - 1;
+        cc.trigger = WB_CAP_TRIG_MANUAL;
+        wb_cap_init();
+        esp_err_t err;
+        while ((err = wb_cap_arm(&cc)) == ESP_ERR_INVALID_STATE) usleep(1000);    // storage mounting
+        if (err != ESP_OK) return 1;
+    }
+#else
+    if (cap) {
+        fprintf(stderr, "-C: built without CONFIG_WB_CAP\n");
+        return 2;
+    }
+#endif
+
+    printf("bench=wb_tunnel rev=%s transport=%s payload=%d agg=%d fec=%d arq=%d hc=%d comp=%d dmx_delta=%d "
+           "crypt=%s cap=%s clock_ns=%llu\n", WB_BENCH_REV, WB_TRANSPORT->name, CONFIG_WB_MAX_PAYLOAD,
+           CONFIG_WB_AGG, CONFIG_WB_FEC, CONFIG_WB_ARQ, CONFIG_WB_HC, CONFIG_WB_COMP, CONFIG_WB_DMX_DELTA,
+           WB_BENCH_CRYPT, !CONFIG_WB_CAP ? "out" : cap ? "armed" : "off", (unsigned long long)s_clock_cost);
+
+    static const char *const mix_names[] = { "64", "imix", "1514", "dmx" };
+    static const char *const imp_keys[] = { "none", "reorder", "loss", "both" };
+
+    for (size_t mi = 0; mi < sizeof(mix_names) / sizeof(mix_names[0]); mi++) {
+        if (!listed(mixes, mix_names[mi])) continue;
+
+        mix_t m;
+        if (!mix_build(&m, mix_names[mi], frames)) return 1;
+
+        sample_t tx[64], task[64];
+        int ntx = 0;
+        s_queue_full = 0;
+        for (int imp = IMP_NONE; imp <= IMP_BOTH; imp++) {
+            if (!listed(impairs, imp_keys[imp])) continue;
+
+            sample_t rx[64];
+            uint32_t dgrams = 0, delivered = 0, bad0 = s_bad;
+            sample_t warm_tx, warm_task, warm_rx;
+
+            // warm-up round: caches, FDB, codec state, tx clock discovery
+            run_tx(&m, &warm_tx, &warm_task);
+            run_rx(&m, (impair_t)imp, &warm_rx);
+
+            for (int r = 0; r < rounds; r++) {
+                run_tx(&m, &tx[ntx % 64], &task[ntx % 64]);
+                ntx++;
+                dgrams = s_ndg;
+                run_rx(&m, (impair_t)imp, &rx[r]);
+                delivered = s_delivered;
+            }
+
+            char extra[128];
+            snprintf(extra, sizeof(extra), " dgrams=%u delivered=%u bad=%u", dgrams, delivered, s_bad - bad0);
+            report("rx", mix_names[mi], s_imp_name[imp], frames, rx, rounds, extra);
+        }
+
+        if (ntx) {
+            int n = ntx < 64 ? ntx : 64;
+            char extra[64];
+            snprintf(extra, sizeof(extra), " queue_full=%u", s_queue_full);
+            report("tx", mix_names[mi], "none", frames, tx, n, extra);
+            report("tx_task", mix_names[mi], "none", frames, task, n, "");
+        }
+        mix_free(&m);
+    }
+
+#if CONFIG_WB_CAP
+    if (cap) {
+        // recorder cost per frame seen, all mixes; "cycles" are ns here
+        wb_stats_t st;
+        wb_stats_snapshot(&st);
+        uint64_t seen = st.c[WB_CTR_CAP_FRAMES] + st.c[WB_CTR_CAP_FILTERED] + st.c[WB_CTR_CAP_LOST];
+        printf("stage=cap frames=%llu ns_per_frame=%.1f kept=%llu lost=%llu\n",
+               (unsigned long long)seen, seen ? (double)st.c[WB_CTR_CAP_CYCLES] / seen : 0.0,
+               (unsigned long long)st.c[WB_CTR_CAP_FRAMES], (unsigned long long)st.c[WB_CTR_CAP_LOST]);
+    }
+#endif
+    return 0;
+}
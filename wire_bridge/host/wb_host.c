@@ -0,0 +1,422 @@
+// wb_host.c — the bridge core as a Linux process
+//
+// Same tunnel, protocol and frame path (bridge_core.c) as the firmware; the Ethernet
+// side is a TAP interface, or a built-in traffic generator / sink for
+// measurements without root:
+//   wb_host -l 127.0.0.1:3333 -p 127.0.0.1:3334 -i wb0        TAP bridge
+//   wb_host -l 127.0.0.1:3334 -p 127.0.0.1:3333 -s            sink
+//   wb_host -l 127.0.0.1:3333 -p 127.0.0.1:3334 -g imix       generator
+// Once a second a key=value stats line goes to stdout. -C records the
+// Ethernet side to build/cap/capNNNN.pcapng (capture.h). Control commands
+// (wb_ctl.h, "help") are read from stdin.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#include "udp_tunnel.h"
+#include "bridge_core.h"
+#include "pmtu.h"
+#include "link_probe.h"
+#include "crypt.h"
+#include "task_topo.h"
+#include "wb_stats.h"
+#include "capture.h"
+#include "wb_ctl.h"
+#include "tp_linux.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "wb_host";
+
+#define GEN_ETHERTYPE 0x88B5       // IEEE local experimental
+#define GEN_HDR       26           // dst, src, type, seq, t_us
+#define LAT_SAMPLES   65536
+
+typedef enum { MODE_TAP, MODE_GEN, MODE_SINK } mode_t_;
+
+static mode_t_ s_mode = MODE_SINK;
+static int s_tap = -1;
+
+// frames in and out, datagrams and drops: wb_stats.h
+static volatile uint32_t s_gen_busy;      // generator backed off (a refusal, resent)
+
+// sink state, tunnel RX task only
+static uint32_t s_sink_next;
+static uint32_t s_sink_lost, s_sink_reorder, s_sink_bad;
+static uint32_t s_lat[LAT_SAMPLES];
+static uint32_t s_lat_n;
+static portMUX_TYPE s_lat_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static void sink_frame(const uint8_t *frame, size_t len)
+{
+    if (len < GEN_HDR || ((frame[12] << 8) | frame[13]) != GEN_ETHERTYPE) return;
+
+    uint32_t seq, t_us;
+    memcpy(&seq, frame + 14, 4);
+    memcpy(&t_us, frame + 18, 4);
+    for (size_t i = GEN_HDR; i < len; i++) {
+        if (frame[i] != (uint8_t)(seq + i)) {
+            s_sink_bad++;
+            return;
+        }
+    }
+
+    if (seq >= s_sink_next) {
+        s_sink_lost += seq - s_sink_next;
+        s_sink_next = seq + 1;
+    } else {
+        // late: it was counted lost
+        s_sink_reorder++;
+        if (s_sink_lost) s_sink_lost--;
+    }
+
+    // one-way delay; both ends read the same CLOCK_MONOTONIC on one host
+    uint32_t d = (uint32_t)esp_timer_get_time() - t_us;
+    portENTER_CRITICAL(&s_lat_mux);
+    if (s_lat_n < LAT_SAMPLES) s_lat[s_lat_n++] = d;
+    portEXIT_CRITICAL(&s_lat_mux);
+}
+
+// Ethernet transmit for bridge_core.c: the TAP, or the sink's checks
+static bool eth_tx(const uint8_t *frame, size_t len)
+{
+    if (s_mode == MODE_TAP) {
+        if (write(s_tap, frame, len) < 0 && errno != EAGAIN) {
+            ESP_LOGW(TAG, "tap write: %s", strerror(errno));
+            return false;
+        }
+    } else {
+        sink_frame(frame, len);
+    }
+    return true;
+}
+
+static int tap_open(const char *name)
+{
+    int fd = open("/dev/net/tun", O_RDWR);
+    if (fd < 0) {
+        ESP_LOGE(TAG, "/dev/net/tun: %s", strerror(errno));
+        return -1;
+    }
+    struct ifreq ifr = {0};
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", name);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        ESP_LOGE(TAG, "TUNSETIFF %s: %s", name, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void tap_task(void *arg)
+{
+    (void)arg;
+    uint8_t buf[2048];
+
+    while (1) {
+        ssize_t n = read(s_tap, buf, sizeof(buf));
+        if (n > 0) (void)wb_bridge_eth_in(buf, (size_t)n, 0);
+    }
+}
+
+// 64 / 576 / 1514 in 7:4:1, the simple IMIX
+static uint16_t gen_len(const char *mix, uint32_t seq)
+{
+    if (strcmp(mix, "imix") == 0) {
+        uint32_t k = seq % 12;
+        return k < 7 ? 64 : k < 11 ? 576 : 1514;
+    }
+    int n = atoi(mix);
+    if (n < GEN_HDR) n = GEN_HDR;
+    if (n > 1514) n = 1514;
+    return (uint16_t)n;
+}
+
+typedef struct {
+    const char *mix;
+    uint32_t    pps;      // 0 = as fast as the tunnel takes them
+} gen_cfg_t;
+
+static void gen_task(void *arg)
+{
+    const gen_cfg_t *cfg = (const gen_cfg_t *)arg;
+    static const uint8_t dst[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x02 };
+    static const uint8_t src[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x01 };
+    uint8_t f[1514];
+    int64_t t_next = esp_timer_get_time();
+
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[12] = GEN_ETHERTYPE >> 8;
+    f[13] = GEN_ETHERTYPE & 0xFF;
+
+    for (uint32_t seq = 0;; seq++) {
+        uint16_t len = gen_len(cfg->mix, seq);
+        memcpy(f + 14, &seq, 4);
+        for (uint16_t i = GEN_HDR; i < len; i++) f[i] = (uint8_t)(seq + i);
+
+        if (cfg->pps) {
+            t_next += 1000000 / cfg->pps;
+            int64_t wait = t_next - esp_timer_get_time();
+            if (wait > 0) usleep((useconds_t)wait);
+        }
+
+        uint32_t t_us = (uint32_t)esp_timer_get_time();
+        memcpy(f + 18, &t_us, 4);
+        // backpressure instead of drops: the point is the tunnel's own cost
+        if (wb_bridge_eth_in(f, len, t_us) || cfg->pps) continue;
+        do {
+            s_gen_busy++;
+            usleep(50);
+        } while (!wb_udp_send_frame_at(f, len, t_us));
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double cpu_s(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+static void print_stats(double t, double dt, double cpu)
+{
+    static uint32_t in_prev, out_prev, tx_prev, rx_prev;
+    uint32_t busy = s_gen_busy;     // before the snapshot: each of these is in it
+    wb_stats_t st;
+    wb_stats_snapshot(&st);
+    uint32_t in = (uint32_t)st.c[WB_CTR_ETH_RX_FRAMES], out = (uint32_t)st.c[WB_CTR_ETH_TX_FRAMES];
+    uint32_t tx = (uint32_t)st.c[WB_CTR_WIFI_TX_DGRAMS], rx = (uint32_t)st.c[WB_CTR_WIFI_RX_DGRAMS];
+    // the tunnel counts every refusal; the generator resent the busy ones
+    uint32_t drop = (uint32_t)st.c[WB_CTR_TUN_TX_DROP] - busy;
+    uint32_t frames = (in - in_prev) + (out - out_prev);
+
+    printf("t=%.1f eth_in=%u eth_out=%u in_fps=%.0f out_fps=%.0f udp_tx=%u udp_rx=%u "
+           "dgram_tx_ps=%.0f dgram_rx_ps=%.0f udp_drop=%u gen_busy=%u cpu_us_per_frame=%.2f",
+           t, in, out, (in - in_prev) / dt, (out - out_prev) / dt, tx, rx,
+           (tx - tx_prev) / dt, (rx - rx_prev) / dt, drop, busy,
+           frames ? cpu * 1e6 / frames : 0.0);
+    in_prev = in;
+    out_prev = out;
+    tx_prev = tx;
+    rx_prev = rx;
+
+#if CONFIG_WB_PMTU
+    printf(" pmtu=%u", wb_pmtu_get());
+#endif
+#if CONFIG_WB_LP
+    wb_lp_stats_t lp;
+    wb_lp_get_stats(&lp);
+    printf(" rtt_p50_us=%u rtt_p99_us=%u jitter_us=%u", lp.rtt_p50_us, lp.rtt_p99_us, lp.jitter_us);
+#endif
+#if CONFIG_WB_CRYPT
+    wb_crypt_stats_t cs;
+    wb_crypt_get_stats(&cs);
+    printf(" sealed=%u opened=%u rx_plain=%u rx_bad=%u rx_replay=%u seal_ns_per_kb=%.0f open_ns_per_kb=%.0f",
+           (unsigned)cs.sealed, (unsigned)cs.opened, (unsigned)cs.rx_plain, (unsigned)cs.rx_bad,
+           (unsigned)cs.rx_replay,
+           cs.seal_bytes ? cs.seal_cycles * 1024.0 / cs.seal_bytes : 0.0,
+           cs.open_bytes ? cs.open_cycles * 1024.0 / cs.open_bytes : 0.0);
+#endif
+
+#if CONFIG_WB_LAT
+    // this interval's frames, by stage
+    static wb_lat_hist_t lat_prev[WB_LAT_N];
+    for (int i = 0; i < WB_LAT_N; i++) {
+        wb_lat_hist_t h;
+        wb_lat_pct_t p;
+        wb_stats_lat_snapshot((wb_lat_t)i, &h);
+        wb_lat_hist_t cur = h;
+        wb_stats_lat_sub(&h, &lat_prev[i]);
+        lat_prev[i] = cur;
+        wb_stats_lat_pct(&h, &p);
+        const char *name = wb_stats_lat_name((wb_lat_t)i);
+        printf(" %s_p50_us=%u %s_p99_us=%u %s_p999_us=%u %s_max_us=%u",
+               name, p.p50_us, name, p.p99_us, name, p.p999_us, name, p.max_us);
+    }
+#endif
+
+    static uint64_t stage_prev[WB_STAGE_N];
+    for (int i = 0; i < WB_STAGE_N; i++) {
+        wb_stage_stats_t ss;
+        if (!wb_topo_get_stats((wb_stage_t)i, &ss) || !ss.running) continue;
+        printf(" cpu_%s_pct=%.1f", ss.name, (ss.cpu_us - stage_prev[i]) / (dt * 1e4));
+        stage_prev[i] = ss.cpu_us;
+    }
+
+    if (s_mode == MODE_SINK) {
+        static uint32_t lat[LAT_SAMPLES];
+        portENTER_CRITICAL(&s_lat_mux);
+        uint32_t n = s_lat_n;
+        memcpy(lat, s_lat, n * sizeof(lat[0]));
+        s_lat_n = 0;
+        portEXIT_CRITICAL(&s_lat_mux);
+
+        qsort(lat, n, sizeof(lat[0]), cmp_u32);
+        printf(" lost=%u reordered=%u bad=%u lat_p50_us=%u lat_p99_us=%u lat_max_us=%u",
+               s_sink_lost, s_sink_reorder, s_sink_bad,
+               n ? lat[n / 2] : 0, n ? lat[(uint64_t)n * 99 / 100] : 0, n ? lat[n - 1] : 0);
+    }
+#if CONFIG_WB_CAP
+    wb_cap_stats_t cap;
+    wb_cap_get_stats(&cap);
+    if (cap.state != WB_CAP_OFF || cap.files) {
+        uint64_t seen = st.c[WB_CTR_CAP_FRAMES] + st.c[WB_CTR_CAP_FILTERED] + st.c[WB_CTR_CAP_LOST];
+        printf(" cap_state=%d cap_kept=%llu cap_lost=%llu cap_written=%u cap_files=%u cap_ns_per_frame=%.1f",
+               (int)cap.state, (unsigned long long)st.c[WB_CTR_CAP_FRAMES],
+               (unsigned long long)st.c[WB_CTR_CAP_LOST], (unsigned)cap.written, (unsigned)cap.files,
+               seen ? (double)st.c[WB_CTR_CAP_CYCLES] / seen : 0.0);
+    }
+#endif
+    printf("\n");
+    fflush(stdout);
+}
+
+static bool parse_addr(const char *s, struct sockaddr_in *out)
+{
+    char host[64];
+    const char *colon = strrchr(s, ':');
+    if (!colon || (size_t)(colon - s) >= sizeof(host)) return false;
+    memcpy(host, s, colon - s);
+    host[colon - s] = 0;
+
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_port = htons((uint16_t)atoi(colon + 1));
+    return inet_pton(AF_INET, host, &out->sin_addr) == 1;
+}
+
+// The serial console's stand-in; ends at EOF
+static void ctl_task(void *arg)
+{
+    (void)arg;
+    char line[512];
+    while (fgets(line, sizeof(line), stdin)) {
+        wb_ctl_line(line);
+        fflush(stdout);
+    }
+    vTaskDelete(NULL);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s -l ip:port -p ip:port (-i tap | -g mix [-r pps] | -s) [-t secs] [-T topo] [-C]\n"
+            "  -l  local tunnel address      -p  peer tunnel address\n"
+            "  -i  bridge this TAP interface (needs CAP_NET_ADMIN)\n"
+            "  -g  generate frames: imix or a fixed length (64..1514)\n"
+            "  -r  generator rate, frames/s (default: as fast as accepted)\n"
+            "  -s  sink: check generated frames, report loss and latency\n"
+            "  -t  exit after secs (default: run forever)\n"
+            "  -T  task topology, e.g. \"udp_rx:0:18:0 udp_tx:1:18:0 eth_rx:1:15:0\"\n"
+            "      (main/task_topo.h; cores map onto this host's CPUs)\n"
+            "  -C  capture Ethernet in and out to build/cap (WB_CAP_* in sdkconfig.h;\n"
+            "      a manual trigger fires at once)\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in local, peer;
+    bool have_local = false, have_peer = false;
+    const char *tap = NULL;
+    gen_cfg_t gen = { .mix = NULL, .pps = 0 };
+    int secs = 0;
+    bool cap = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "l:p:i:g:r:st:T:Ch")) != -1) {
+        switch (c) {
+        case 'l': have_local = parse_addr(optarg, &local); break;
+        case 'p': have_peer = parse_addr(optarg, &peer); break;
+        case 'i': tap = optarg; s_mode = MODE_TAP; break;
+        case 'g': gen.mix = optarg; s_mode = MODE_GEN; break;
+        case 'r': gen.pps = (uint32_t)atoi(optarg); break;
+        case 's': s_mode = MODE_SINK; break;
+        case 't': secs = atoi(optarg); break;
+        case 'T':
+            if (wb_topo_set(optarg, false) != ESP_OK) return 2;
+            break;
+        case 'C': cap = true; break;
+        default: usage(argv[0]); return 2;
+        }
+    }
+    if (!have_local || !have_peer) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (s_mode == MODE_TAP && (s_tap = tap_open(tap)) < 0) return 1;
+
+    wb_bridge_init(eth_tx);
+    wb_tp_linux_config(&local, &peer);
+    wb_udp_start(wb_bridge_udp_in, NULL);
+#if CONFIG_WB_CAP
+    if (cap) {
+        wb_cap_init();
+        esp_err_t err;
+        while ((err = wb_cap_arm(NULL)) == ESP_ERR_INVALID_STATE) usleep(1000);    // storage mounting
+        if (err != ESP_OK) return 1;
+        if (wb_cap_default_cfg()->trigger == WB_CAP_TRIG_MANUAL) wb_cap_trigger();
+    }
+#else
+    if (cap) {
+        ESP_LOGE(TAG, "-C: built without CONFIG_WB_CAP");
+        return 2;
+    }
+#endif
+
+    // the TAP reader or generator stands in for the EMAC RX task
+    if (s_mode == MODE_TAP) wb_task_create(WB_STAGE_ETH_RX, tap_task, NULL, NULL);
+    if (s_mode == MODE_GEN) wb_task_create(WB_STAGE_ETH_RX, gen_task, &gen, NULL);
+    xTaskCreate(ctl_task, "ctl", 4096, NULL, 5, NULL);
+
+    ESP_LOGI(TAG, "%s: %s:%u -> %s:%u", s_mode == MODE_TAP ? tap : s_mode == MODE_GEN ? "generator" : "sink",
+             inet_ntoa(local.sin_addr), ntohs(local.sin_port), inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+
+    int64_t t0 = esp_timer_get_time(), t_prev = t0;
+    double cpu_prev = cpu_s();
+    for (int i = 1; secs == 0 || i <= secs; i++) {
+        int64_t wait = t0 + (int64_t)i * 1000000 - esp_timer_get_time();
+        if (wait > 0) usleep((useconds_t)wait);
+
+        int64_t now = esp_timer_get_time();
+        double cpu = cpu_s();
+        print_stats((now - t0) / 1e6, (now - t_prev) / 1e6, cpu - cpu_prev);
+        t_prev = now;
+        cpu_prev = cpu;
+    }
+
+#if CONFIG_WB_CAP
+    // write out what the ring still holds
+    wb_cap_stop();
+    wb_cap_stats_t cs;
+    for (int i = 0; i < 200; i++) {
+        wb_cap_get_stats(&cs);
+        if (cs.state == WB_CAP_OFF) break;
+        usleep(10000);
+    }
+    if (cap) ESP_LOGI(TAG, "capture: %u packets, %llu bytes, last file %s", (unsigned)cs.written,
+                      (unsigned long long)cs.bytes, cs.file);
+#endif
+    return 0;
+}
@@ -0,0 +1,93 @@
+// espnow_loop.c — loopback stand-in for the ESP-NOW driver
+//
+// Frames to a registered peer (or broadcast) come straight back into the
+// receive callback from our own MAC, then the send callback reports
+// success, the order the Wi-Fi task uses. Payload limit is the v2 one;
+// the backend under test enforces its own (v1 or v2) limit first.
+
+#include <string.h>
+
+#include "esp_now.h"
+
+#define LOOP_PEERS 8
+
+static const uint8_t s_own_mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+static bool s_init;
+static esp_now_recv_cb_t s_recv_cb;
+static esp_now_send_cb_t s_send_cb;
+static uint8_t s_peers[LOOP_PEERS][6];
+static int s_npeers;
+
+esp_err_t esp_now_init(void)
+{
+    s_init = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb)
+{
+    s_recv_cb = cb;
+    return ESP_OK;
+}
+
+esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb)
+{
+    s_send_cb = cb;
+    return ESP_OK;
+}
+
+static int peer_index(const uint8_t *mac)
+{
+    for (int i = 0; i < s_npeers; i++) {
+        if (memcmp(s_peers[i], mac, 6) == 0) return i;
+    }
+    return -1;
+}
+
+bool esp_now_is_peer_exist(const uint8_t *peer_addr)
+{
+    return peer_index(peer_addr) >= 0;
+}
+
+esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer)
+{
+    if (!s_init) return ESP_ERR_ESPNOW_NOT_INIT;
+    if (peer_index(peer->peer_addr) >= 0) return ESP_ERR_ESPNOW_ARG;
+    if (s_npeers >= LOOP_PEERS) return ESP_ERR_ESPNOW_FULL;
+    memcpy(s_peers[s_npeers++], peer->peer_addr, 6);
+    return ESP_OK;
+}
+
+esp_err_t esp_now_mod_peer(const esp_now_peer_info_t *peer)
+{
+    return peer_index(peer->peer_addr) >= 0 ? ESP_OK : ESP_ERR_ESPNOW_NOT_FOUND;
+}
+
+esp_err_t esp_now_set_peer_rate_config(const uint8_t *peer_addr, esp_now_rate_config_t *config)
+{
+    (void)config;
+    return peer_index(peer_addr) >= 0 ? ESP_OK : ESP_ERR_ESPNOW_NOT_FOUND;
+}
+
+esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len)
+{
+    if (!s_init) return ESP_ERR_ESPNOW_NOT_INIT;
+    if (!peer_addr || !data || len == 0 || len > ESP_NOW_MAX_DATA_LEN_V2) return ESP_ERR_ESPNOW_ARG;
+    if (peer_index(peer_addr) < 0) return ESP_ERR_ESPNOW_NOT_FOUND;
+
+    // the driver owns a copy once esp_now_send() returns
+    uint8_t frame[ESP_NOW_MAX_DATA_LEN_V2];
+    memcpy(frame, data, len);
+
+    uint8_t src[6], dst[6];
+    memcpy(src, s_own_mac, 6);
+    memcpy(dst, peer_addr, 6);
+    wifi_pkt_rx_ctrl_t rx_ctrl = { .rssi = -42 };
+    esp_now_recv_info_t ri = { .src_addr = src, .des_addr = dst, .rx_ctrl = &rx_ctrl };
+    if (s_recv_cb) s_recv_cb(&ri, frame, (int)len);
+
+    esp_now_send_info_t si = { .des_addr = dst, .src_addr = src, .ifidx = WIFI_IF_STA };
+    if (s_send_cb) s_send_cb(&si, ESP_NOW_SEND_SUCCESS);
+    return ESP_OK;
+}
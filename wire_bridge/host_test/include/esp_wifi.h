@@ -0,0 +1,30 @@
+#pragma once
+// Host stand-in: the Wi-Fi types the ESP-NOW backend touches
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef enum { WIFI_IF_STA = 0, WIFI_IF_AP } wifi_interface_t;
+
+typedef enum {
+    WIFI_PHY_MODE_LR, WIFI_PHY_MODE_11B, WIFI_PHY_MODE_11G,
+    WIFI_PHY_MODE_HT20, WIFI_PHY_MODE_HT40, WIFI_PHY_MODE_HE20,
+} wifi_phy_mode_t;
+
+typedef enum {
+    WIFI_PHY_RATE_1M_L = 0x00,
+    WIFI_PHY_RATE_MCS3_LGI = 0x13,
+    WIFI_PHY_RATE_MCS7_SGI = 0x1F,
+} wifi_phy_rate_t;
+
+typedef struct {
+    signed rssi : 8;
+    unsigned rate : 5;
+    unsigned channel : 4;
+} wifi_pkt_rx_ctrl_t;
+
+typedef struct {
+    const uint8_t *des_addr;
+    const uint8_t *src_addr;
+    wifi_interface_t ifidx;
+} wifi_tx_info_t;
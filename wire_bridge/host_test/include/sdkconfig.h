@@ -0,0 +1,2 @@
+#pragma once
+// Host builds: the options a test needs come in as -D flags (see Makefile)
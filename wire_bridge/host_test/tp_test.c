@@ -0,0 +1,317 @@
+// tp_test.c — transport conformance and throughput test (host)
+//
+// Built once per backend (see Makefile); TP names the descriptor under
+// test. Datagrams always start with a wb_hdr_t like the tunnel's do, since
+// a backend may drop anything else (ESP-NOW does).
+//
+//  1. open() succeeds
+//  2. single and gathered (hdr / ext / payload) datagrams arrive byte
+//     exact, reported from the node they were sent to
+//  3. every size from a bare header up to mtu goes through; mtu + 1 is
+//     refused, not truncated
+//  4. a 1514-byte frame fragmented at wb_frag_cap() (with and without FEC,
+//     largest parity datagram included) reassembles exactly
+//  5. throughput: mtu-sized datagrams, windowed, none lost, reordered or
+//     corrupted
+//
+// Output: one "ok"/"FAIL" line per check, then
+//   tp=<name> mtu=<n> dgrams=<n> secs=<f> dgram_per_s=<n> mbit_per_s=<f> lost=<n>
+// Exit status 0 = all passed. TP_TEST_N overrides the datagram count.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "transport.h"
+#include "wb_proto.h"
+#include "esp_timer.h"
+
+extern const wb_transport_t TP;
+
+#define TEST_NODE   1             // loopback: sent to node 1, back from node 1
+#define RX_SLOTS    64
+#define RX_WAIT_US  1000000
+#define TP_WINDOW   32            // datagrams in flight during the throughput run
+#define TP_N        20000
+
+static pthread_mutex_t s_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  s_cv = PTHREAD_COND_INITIALIZER;
+
+// store mode: keep copies for byte-exact checks
+static struct {
+    uint8_t from;
+    int     n;
+    uint8_t p[2048];
+} s_slot[RX_SLOTS];
+static int s_nrx;
+
+// count mode: sequence and pattern checked on the fly
+static volatile bool s_count_mode;
+static uint32_t s_cnt_rx, s_cnt_bad, s_cnt_order;
+static uint16_t s_cnt_next;
+
+static int s_fail;
+
+#define CHECK(cond, ...) do {                                       \
+    if (cond) { printf("ok   "); printf(__VA_ARGS__); printf("\n"); } \
+    else { printf("FAIL "); printf(__VA_ARGS__); printf("\n"); s_fail++; } \
+} while (0)
+
+static uint8_t pattern(uint16_t seq, size_t i)
+{
+    return (uint8_t)(seq * 31u + i * 7u);
+}
+
+static void rx_cb(uint8_t from, const uint8_t *p, int n)
+{
+    pthread_mutex_lock(&s_mu);
+    if (s_count_mode) {
+        wb_hdr_t h;
+        memcpy(&h, p, sizeof(h));
+        bool good = from == TEST_NODE && n >= (int)sizeof(h) && h.frag_len == n - (int)sizeof(h);
+        for (int i = sizeof(h); good && i < n; i++) good = p[i] == pattern(h.seq, (size_t)i);
+        if (!good) s_cnt_bad++;
+        if (h.seq != s_cnt_next) s_cnt_order++;
+        s_cnt_next = (uint16_t)(h.seq + 1);
+        s_cnt_rx++;
+    } else if (s_nrx < RX_SLOTS && n <= (int)sizeof(s_slot[0].p)) {
+        s_slot[s_nrx].from = from;
+        s_slot[s_nrx].n = n;
+        memcpy(s_slot[s_nrx].p, p, (size_t)n);
+        s_nrx++;
+    }
+    pthread_cond_broadcast(&s_cv);
+    pthread_mutex_unlock(&s_mu);
+}
+
+// Wait until *ctr >= want (or timeout); returns the final value
+static int wait_count(volatile int *ctr_i, volatile uint32_t *ctr_u, long want)
+{
+    int64_t deadline = esp_timer_get_time() + RX_WAIT_US;
+    long v;
+
+    pthread_mutex_lock(&s_mu);
+    for (;;) {
+        v = ctr_i ? *ctr_i : (long)*ctr_u;
+        if (v >= want || esp_timer_get_time() >= deadline) break;
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+        pthread_cond_timedwait(&s_cv, &s_mu, &ts);
+    }
+    pthread_mutex_unlock(&s_mu);
+    return (int)v;
+}
+
+static void rx_reset(void)
+{
+    pthread_mutex_lock(&s_mu);
+    s_nrx = 0;
+    pthread_mutex_unlock(&s_mu);
+}
+
+static wb_hdr_t mk_hdr(uint16_t seq, uint16_t frame_len, uint16_t off, uint16_t len, uint8_t flags)
+{
+    return (wb_hdr_t){
+        .magic = WB_MAGIC,
+        .ver = WB_VER,
+        .flags = flags,
+        .seq = seq,
+        .frame_len = frame_len,
+        .frag_off = off,
+        .frag_len = len,
+    };
+}
+
+// 2. byte-exact single and gathered datagrams
+static void test_exact(void)
+{
+    // fits every backend, ESP-NOW v1 included
+    uint8_t pl[200];
+    for (size_t i = 0; i < sizeof(pl); i++) pl[i] = pattern(7, i);
+
+    rx_reset();
+    wb_hdr_t h = mk_hdr(7, sizeof(pl), 0, sizeof(pl), WB_F_DATA);
+    uint8_t one[sizeof(h) + sizeof(pl)];
+    memcpy(one, &h, sizeof(h));
+    memcpy(one + sizeof(h), pl, sizeof(pl));
+    wb_seg_t s1[1] = { { one, sizeof(one) } };
+    int r = TP.send(TEST_NODE, s1, 1);
+    int got = wait_count(&s_nrx, NULL, 1);
+    CHECK(r == (int)sizeof(one) && got == 1 && s_slot[0].n == (int)sizeof(one) &&
+          memcmp(s_slot[0].p, one, sizeof(one)) == 0, "single segment arrives byte exact");
+    CHECK(got == 1 && s_slot[0].from == TEST_NODE, "source node reported (%d)", got ? s_slot[0].from : -1);
+
+    rx_reset();
+    h.flags |= WB_F_FEC;
+    wb_fec_ext_t ext = { .group = 0x1234, .idx = 3, .count = 0 };
+    wb_seg_t s3[3] = { { &h, sizeof(h) }, { &ext, sizeof(ext) }, { pl, sizeof(pl) } };
+    r = TP.send(TEST_NODE, s3, 3);
+    got = wait_count(&s_nrx, NULL, 1);
+    bool same = got == 1 && s_slot[0].n == (int)(sizeof(h) + sizeof(ext) + sizeof(pl)) &&
+                memcmp(s_slot[0].p, &h, sizeof(h)) == 0 &&
+                memcmp(s_slot[0].p + sizeof(h), &ext, sizeof(ext)) == 0 &&
+                memcmp(s_slot[0].p + sizeof(h) + sizeof(ext), pl, sizeof(pl)) == 0;
+    CHECK(r == (int)(sizeof(h) + sizeof(ext) + sizeof(pl)) && same, "3 segments gathered into one datagram");
+}
+
+// 3. size sweep and the mtu limit
+static void test_sizes(void)
+{
+    static uint8_t buf[2048];
+    int bad = 0, sent = 0;
+
+    for (int n = sizeof(wb_hdr_t); n <= TP.mtu; n += (n < 64 ? 1 : 61)) {
+        uint16_t pl = (uint16_t)(n - sizeof(wb_hdr_t));
+        wb_hdr_t h = mk_hdr((uint16_t)n, pl, 0, pl, WB_F_DATA);
+        memcpy(buf, &h, sizeof(h));
+        for (int i = sizeof(h); i < n; i++) buf[i] = pattern((uint16_t)n, (size_t)i);
+
+        rx_reset();
+        wb_seg_t s[1] = { { buf, (size_t)n } };
+        sent++;
+        if (TP.send(TEST_NODE, s, 1) != n || wait_count(&s_nrx, NULL, 1) != 1 ||
+            s_slot[0].n != n || memcmp(s_slot[0].p, buf, (size_t)n) != 0) {
+            bad++;
+        }
+    }
+    // the last step may stop short of mtu: send exactly mtu too
+    {
+        uint16_t pl = (uint16_t)(TP.mtu - sizeof(wb_hdr_t));
+        wb_hdr_t h = mk_hdr(1, pl, 0, pl, WB_F_DATA);
+        memcpy(buf, &h, sizeof(h));
+        rx_reset();
+        wb_seg_t s[1] = { { buf, TP.mtu } };
+        sent++;
+        if (TP.send(TEST_NODE, s, 1) != TP.mtu || wait_count(&s_nrx, NULL, 1) != 1 || s_slot[0].n != TP.mtu) bad++;
+    }
+    CHECK(bad == 0, "sizes %d..%d: %d of %d wrong", (int)sizeof(wb_hdr_t), TP.mtu, bad, sent);
+
+    rx_reset();
+    uint16_t pl = (uint16_t)(TP.mtu + 1 - sizeof(wb_hdr_t));
+    wb_hdr_t h = mk_hdr(2, pl, 0, pl, WB_F_DATA);
+    memcpy(buf, &h, sizeof(h));
+    wb_seg_t s[2] = { { buf, sizeof(h) }, { buf + sizeof(h), pl } };
+    int r = TP.send(TEST_NODE, s, 2);
+    int64_t t0 = esp_timer_get_time();
+    while (esp_timer_get_time() - t0 < 50000) { }   // anything that slipped through has landed
+    CHECK(r < 0 && s_nrx == 0, "mtu + 1 refused (send=%d, delivered=%d)", r, s_nrx);
+}
+
+// 4. tunnel framing at the fragment size the tunnel would pick
+static void test_framing(bool fec)
+{
+    const uint16_t frame_len = 1514;
+    static uint8_t frame[1514], out[1514];
+    for (int i = 0; i < frame_len; i++) frame[i] = (uint8_t)rand();
+
+    uint16_t cap = wb_frag_cap(TP.mtu, fec);
+    int nfrag = (frame_len + cap - 1) / cap;
+    CHECK(cap > 0 && nfrag <= RX_SLOTS, "%s fragment payload %u (%d fragments per 1514-byte frame)",
+          fec ? "FEC" : "plain", cap, nfrag);
+    if (cap == 0 || nfrag > RX_SLOTS) return;
+
+    rx_reset();
+    int sent_ok = 0;
+    for (uint16_t off = 0; off < frame_len; off = (uint16_t)(off + cap)) {
+        uint16_t len = (uint16_t)(frame_len - off < cap ? frame_len - off : cap);
+        wb_hdr_t h = mk_hdr(42, frame_len, off, len, (uint8_t)(WB_F_DATA | (fec ? WB_F_FEC : 0)));
+        wb_fec_ext_t ext = { .group = 1, .idx = (uint8_t)(off / cap), .count = 0 };
+        wb_seg_t s[3] = { { &h, sizeof(h) }, { &ext, sizeof(ext) }, { frame + off, len } };
+        wb_seg_t p[2] = { { &h, sizeof(h) }, { frame + off, len } };
+        if ((fec ? TP.send(TEST_NODE, s, 3) : TP.send(TEST_NODE, p, 2)) > 0) sent_ok++;
+    }
+    int got = wait_count(&s_nrx, NULL, nfrag);
+
+    memset(out, 0, sizeof(out));
+    size_t hl = sizeof(wb_hdr_t) + (fec ? sizeof(wb_fec_ext_t) : 0);
+    int covered = 0;
+    for (int i = 0; i < got; i++) {
+        wb_hdr_t h;
+        memcpy(&h, s_slot[i].p, sizeof(h));
+        if (h.magic != WB_MAGIC || h.frag_off + h.frag_len > frame_len ||
+            s_slot[i].n != (int)(hl + h.frag_len)) continue;
+        memcpy(out + h.frag_off, s_slot[i].p + hl, h.frag_len);
+        covered += h.frag_len;
+    }
+    CHECK(sent_ok == nfrag && got == nfrag && covered == frame_len && memcmp(out, frame, frame_len) == 0,
+          "%s frame reassembles (%d/%d fragments)", fec ? "FEC" : "plain", got, nfrag);
+
+    if (!fec) return;
+
+    // parity: [hdr][ext][unit hdr 16][longest payload]
+    static uint8_t unit[16 + WB_MTU_MAX];
+    wb_hdr_t h = mk_hdr(0, (uint16_t)(16 + cap), 0, (uint16_t)(16 + cap), WB_F_FEC);
+    wb_fec_ext_t ext = { .group = 1, .idx = WB_FEC_PARITY_IDX, .count = (uint8_t)nfrag };
+    wb_seg_t s[3] = { { &h, sizeof(h) }, { &ext, sizeof(ext) }, { unit, 16u + cap } };
+    rx_reset();
+    int r = TP.send(TEST_NODE, s, 3);
+    CHECK(r > 0 && wait_count(&s_nrx, NULL, 1) == 1, "largest FEC parity datagram fits (%d bytes)", r);
+}
+
+// 5. windowed throughput with mtu-sized datagrams
+static void test_throughput(void)
+{
+    static uint8_t buf[2048];
+    const char *env = getenv("TP_TEST_N");
+    uint32_t n = env ? (uint32_t)strtoul(env, NULL, 10) : TP_N;
+
+    pthread_mutex_lock(&s_mu);
+    s_count_mode = true;
+    s_cnt_rx = s_cnt_bad = s_cnt_order = 0;
+    s_cnt_next = 0;
+    pthread_mutex_unlock(&s_mu);
+
+    uint16_t pl = (uint16_t)(TP.mtu - sizeof(wb_hdr_t));
+    uint32_t sent = 0, stalls = 0;
+    int64_t t0 = esp_timer_get_time();
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint16_t seq = (uint16_t)i;
+        wb_hdr_t h = mk_hdr(seq, pl, 0, pl, WB_F_DATA);
+        memcpy(buf, &h, sizeof(h));
+        for (size_t k = sizeof(h); k < TP.mtu; k++) buf[k] = pattern(seq, k);
+
+        if (sent >= TP_WINDOW && wait_count(NULL, &s_cnt_rx, (long)(sent - TP_WINDOW + 1)) < (long)(sent - TP_WINDOW + 1)) {
+            stalls++;
+            if (stalls > 3) break;
+        }
+        wb_seg_t s[1] = { { buf, TP.mtu } };
+        if (TP.send(TEST_NODE, s, 1) == TP.mtu) sent++;
+    }
+    wait_count(NULL, &s_cnt_rx, sent);
+    double secs = (double)(esp_timer_get_time() - t0) / 1e6;
+
+    pthread_mutex_lock(&s_mu);
+    uint32_t rx = s_cnt_rx, bad = s_cnt_bad, order = s_cnt_order;
+    s_count_mode = false;
+    pthread_mutex_unlock(&s_mu);
+
+    CHECK(sent == n, "throughput: %u of %u sent", sent, n);
+    CHECK(rx == sent && bad == 0 && order == 0, "throughput: %u received, %u corrupt, %u out of order",
+          rx, bad, order);
+
+    printf("tp=%s mtu=%u dgrams=%u secs=%.3f dgram_per_s=%.0f mbit_per_s=%.1f lost=%u\n",
+           TP.name, TP.mtu, rx, secs, rx / secs, rx * (double)TP.mtu * 8 / secs / 1e6, sent - rx);
+}
+
+int main(void)
+{
+    srand(1);
+    printf("transport %s, mtu %u\n", TP.name, TP.mtu);
+
+    CHECK(TP.open(rx_cb), "open");
+    if (s_fail) return 1;
+
+    test_exact();
+    test_sizes();
+    test_framing(false);
+    test_framing(true);
+    test_throughput();
+
+    printf("%s: %d failed\n", TP.name, s_fail);
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+// tunnel_test.c — tunnel behaviour over a capture transport (host)
+//
+// libwbcore.a from ../host (its own build, see Makefile) runs against a
+// transport that keeps every datagram udp_tx_task sends; the test replays
+// the data datagrams into the tunnel's RX entry point and checks the
+// frames that come out. wb_pmtu_get() is wrapped (ld --wrap) so the test
+// sets the path MTU.
+//
+//  1. frames aggregated under one path MTU and flushed after it shrank go
+//     out in datagrams within the new size, each one whole, and all
+//     arrive byte exact and in order
+//  2. a header compression context reassigned four times while every
+//     datagram was lost (its 2-bit generation back where it was) is not
+//     applied to the next compressed frame: that frame is dropped
+//
+// Output: one "ok"/"FAIL" line per check. Exit status 0 = all passed.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "udp_tunnel.h"
+#include "transport.h"
+#include "wb_proto.h"
+#include "bridge_cfg.h"
+#include "hdr_comp.h"
+
+#define MAX_DGRAMS   256
+#define MAX_FRAMES   128
+#define ETH_TYPE     0x88B5          // local experimental
+
+static pthread_mutex_t s_mu = PTHREAD_MUTEX_INITIALIZER;
+static int s_fail;
+
+#define CHECK(cond, ...) do {                                       \
+    if (cond) { printf("ok   "); printf(__VA_ARGS__); printf("\n"); } \
+    else { printf("FAIL "); printf(__VA_ARGS__); printf("\n"); s_fail++; } \
+} while (0)
+
+// ---- path MTU, set by the test ----
+
+static volatile uint16_t s_mtu = 1200;
+
+uint16_t __wrap_wb_pmtu_get(void)
+{
+    return s_mtu;
+}
+
+// ---- capture transport: stands in for tp_linux.c ----
+
+static struct {
+    int     n;
+    uint8_t p[1536];
+} s_dg[MAX_DGRAMS];
+static int s_ndg;
+static wb_tp_rx_cb_t s_tunnel_rx;
+
+static bool cap_open(wb_tp_rx_cb_t rx)
+{
+    s_tunnel_rx = rx;
+    return true;
+}
+
+// udp_tx_task: data datagrams are kept, control ones (PMTU probes) dropped
+static int cap_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    (void)to;
+    uint8_t buf[1536];
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) {
+        if (n + seg[i].len > sizeof(buf)) return -1;
+        memcpy(buf + n, seg[i].p, seg[i].len);
+        n += seg[i].len;
+    }
+
+    wb_hdr_t h;
+    memcpy(&h, buf, sizeof(h));
+    pthread_mutex_lock(&s_mu);
+    if (!(h.flags & WB_F_CTRL) && s_ndg < MAX_DGRAMS) {
+        s_dg[s_ndg].n = (int)n;
+        memcpy(s_dg[s_ndg].p, buf, n);
+        s_ndg++;
+    }
+    pthread_mutex_unlock(&s_mu);
+    return (int)n;
+}
+
+const wb_transport_t wb_tp_linux = {
+    .name = "capture",
+    .mtu  = 1472,
+    .open = cap_open,
+    .send = cap_send,
+};
+
+// ---- frames ----
+
+static struct {
+    size_t  len;
+    uint8_t p[WB_MAX_FRAME];
+} s_rx[MAX_FRAMES];
+static int s_nrx;
+
+static void on_frame(const uint8_t *frame, size_t len, void *user)
+{
+    (void)user;
+    pthread_mutex_lock(&s_mu);
+    if (s_nrx < MAX_FRAMES && len <= sizeof(s_rx[0].p)) {
+        s_rx[s_nrx].len = len;
+        memcpy(s_rx[s_nrx].p, frame, len);
+        s_nrx++;
+    }
+    pthread_mutex_unlock(&s_mu);
+}
+
+// Unicast to a made-up station from station 1 + flow, index in the first
+// payload byte
+static size_t mk_flow(uint8_t *f, uint8_t flow, uint8_t idx, size_t len)
+{
+    static const uint8_t dst[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x02 };
+    static const uint8_t src[6] = { 0x02, 0x57, 0x42, 0x00, 0x00, 0x01 };
+    memcpy(f, dst, 6);
+    memcpy(f + 6, src, 6);
+    f[10] = flow;
+    f[12] = ETH_TYPE >> 8;
+    f[13] = ETH_TYPE & 0xFF;
+    for (size_t i = 14; i < len; i++) f[i] = (uint8_t)(idx * 31u + i);
+    f[14] = idx;
+    return len;
+}
+
+static size_t mk_frame(uint8_t *f, uint8_t idx, size_t len)
+{
+    return mk_flow(f, 0, idx, len);
+}
+
+static int dgrams(void)
+{
+    pthread_mutex_lock(&s_mu);
+    int n = s_ndg;
+    pthread_mutex_unlock(&s_mu);
+    return n;
+}
+
+// Data datagrams [from, to) into the tunnel's RX path as from the peer
+static void replay_range(int from, int to)
+{
+    for (int i = from; i < to; i++) s_tunnel_rx(WB_IP_STA_LAST, s_dg[i].p, s_dg[i].n);
+}
+
+static void replay(void)
+{
+    replay_range(0, dgrams());
+}
+
+// One frame, then wait until udp_tx_task has sent it: keeps the TX queue
+// from overflowing and the datagrams in send order
+static bool send_one(uint8_t flow, uint8_t idx, size_t len)
+{
+    uint8_t f[WB_MAX_FRAME];
+    int n = dgrams();
+    wb_udp_send_frame(f, mk_flow(f, flow, idx, len));
+    for (int t = 0; t < 1000 && dgrams() == n; t++) usleep(1000);
+    return dgrams() == n + 1;
+}
+
+// 1. aggregate pending while the path MTU shrinks
+static void test_agg_pmtu_shrink(void)
+{
+    enum { N = 5, LEN = 200, MTU_AFTER = 450 };
+    uint8_t f[N][LEN];
+
+    s_mtu = 1200;
+    for (int i = 0; i < N; i++) wb_udp_send_frame(f[i], mk_frame(f[i], (uint8_t)i, LEN));
+
+    // all in one aggregate (N * LEN < 1200), held until CONFIG_WB_AGG_FLUSH_US
+    usleep(50 * 1000);
+    CHECK(dgrams() == 0, "agg: %d frames pending, nothing sent yet (%d datagrams)", N, dgrams());
+    s_mtu = MTU_AFTER;
+
+    usleep(CONFIG_WB_AGG_FLUSH_US + 100 * 1000);
+
+    bool fit = true;
+    int nd = dgrams();
+    for (int i = 0; i < nd; i++) {
+        wb_hdr_t h;
+        memcpy(&h, s_dg[i].p, sizeof(h));
+        if (h.frag_len > MTU_AFTER || h.frag_off != 0 || h.frag_len != h.frame_len) fit = false;
+    }
+    CHECK(nd >= 2 && fit, "agg: flushed after the MTU shrank to %d: %d datagrams, each whole and within it",
+          MTU_AFTER, nd);
+
+    replay();
+    bool exact = s_nrx == N;
+    for (int i = 0; exact && i < N; i++) {
+        uint8_t want[LEN];
+        mk_frame(want, (uint8_t)i, LEN);
+        exact = s_rx[i].len == LEN && memcmp(s_rx[i].p, want, LEN) == 0;
+    }
+    CHECK(exact, "agg: %d of %d frames delivered, byte exact and in order", s_nrx, N);
+}
+
+// 2. context generation wrap across a loss burst
+static void test_hc_gen_wrap(void)
+{
+    // above CONFIG_WB_AGG_MAX_FRAME: one frame per datagram, one seq each
+    enum { LEN = 300, FLOWS = WB_HC_CTX, ROUNDS = 3 };
+    bool sent = true;
+
+    pthread_mutex_lock(&s_mu);
+    s_ndg = 0;
+    s_nrx = 0;
+    pthread_mutex_unlock(&s_mu);
+    s_mtu = 1200;
+
+    // every context in use; the last round goes compressed, flow 0 is the
+    // least recently used
+    for (int r = 0; r < ROUNDS; r++)
+        for (int i = 0; i < FLOWS; i++) sent &= send_one((uint8_t)i, (uint8_t)r, LEN);
+    int nd = dgrams();
+    replay_range(0, nd);
+    CHECK(sent && s_nrx == FLOWS * ROUNDS, "hc: %d flows set up, %d frames delivered", FLOWS, s_nrx);
+
+    // lost: four new flows take flow 0's context in turn, every other
+    // context touched in between so the same one stays least recently used
+    for (int k = 1; k <= 4; k++) {
+        sent &= send_one((uint8_t)(FLOWS + k), 0, LEN);
+        if (k == 4) break;
+        for (int i = 1; i < FLOWS; i++) sent &= send_one((uint8_t)i, 9, LEN);
+    }
+    // the last new flow: second install lost too, then compressed
+    sent &= send_one(FLOWS + 4, 1, LEN);
+    sent &= send_one(FLOWS + 4, 2, LEN);
+
+    wb_hc_stats_t st0, st1;
+    wb_hc_get_stats(&st0);
+    int n0 = s_nrx;
+    replay_range(dgrams() - 1, dgrams());
+    wb_hc_get_stats(&st1);
+
+    uint8_t stale = n0 < s_nrx ? s_rx[n0].p[10] : 0;
+    CHECK(sent && s_nrx == n0 && st1.misses == st0.misses + 1,
+          "hc: compressed frame after the generation wrapped: dropped (%d delivered, from flow %u)",
+          s_nrx - n0, stale);
+}
+
+int main(void)
+{
+    wb_udp_start(on_frame, NULL);
+    usleep(20 * 1000);
+
+    test_agg_pmtu_shrink();
+    test_hc_gen_wrap();
+
+    printf("tunnel: %d failed\n", s_fail);
+    return s_fail ? 1 : 0;
+}
@@ -0,0 +1,266 @@
+// arq.c — selective NACK retransmission for bulk tunnel traffic
+//
+// Only frames sent with WB_F_REL take part. Sender window holds the pool
+// buffers of the last WB_ARQ_WIN frames; receiver tracks the last 32
+// reliable seqs and asks for the missing ones every WB_ARQ_NACK_MS until
+// WB_ARQ_BUDGET_MS after the gap was noticed.
+
+#include "arq.h"
+#include "frame_pool.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+// TCP is bulk; everything else (sACN/Art-Net, ARP, ...) counts as real-time
+bool wb_arq_is_bulk(const uint8_t *f, uint16_t len)
+{
+    if (len < 14 + 20) return false;
+
+    uint16_t et = (uint16_t)((f[12] << 8) | f[13]);
+    const uint8_t *l3 = f + 14;
+    if (et == 0x8100) {                  // single VLAN tag
+        et = (uint16_t)((f[16] << 8) | f[17]);
+        l3 += 4;
+        if (len < 18 + 20) return false;
+    }
+
+    if (et == 0x0800) return l3[9] == 6;                              // IPv4 TCP
+    if (et == 0x86DD) return (len >= (l3 - f) + 40) && l3[6] == 6;    // IPv6 TCP
+    return false;
+}
+
+#if CONFIG_WB_ARQ
+#define WB_ARQ_WIN        CONFIG_WB_ARQ_WINDOW
+#define WB_ARQ_BUDGET_US  ((int64_t)CONFIG_WB_ARQ_BUDGET_MS * 1000)
+#define WB_ARQ_NACK_US    ((int64_t)CONFIG_WB_ARQ_NACK_MS * 1000)
+#define WB_ARQ_RX_WIN     32
+
+typedef struct {
+    bool     in_use;
+    bool     resend;
+    uint16_t seq;
+    uint16_t len;
+    uint8_t  flags;          // per-frame codec flags (WB_F_HC ...)
+    int64_t  t_sent_us;
+    uint8_t *buf;            // pool buffer
+    const uint8_t *data;     // frame bytes inside buf
+} arq_tx_t;
+
+typedef enum { RX_NONE = 0, RX_MISSING, RX_DONE } rx_state_t;
+
+typedef struct {
+    uint16_t seq;
+    uint8_t  st;
+    int64_t  t_first_us;     // gap noticed
+    int64_t  t_nack_us;      // last NACK (0 = never)
+} arq_rx_t;
+
+static arq_tx_t s_tx[WB_ARQ_WIN];
+static uint16_t s_tx_seq = 1;
+static bool s_tx_req = false;           // a NACK flagged resends; s_lock
+
+static arq_rx_t s_rx[WB_ARQ_RX_WIN];
+static bool     s_rx_valid = false;
+static uint16_t s_rx_hi = 0;             // next expected reliable seq
+static uint32_t s_rx_missing = 0;        // entries in RX_MISSING
+
+static wb_arq_stats_t s_st;
+
+// rx state is touched from the RX path and from udp_tx_task
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ---- sender
+
+uint16_t wb_arq_next_seq(void)
+{
+    return s_tx_seq++;
+}
+
+void wb_arq_tx_store(uint16_t seq, uint8_t *buf, const uint8_t *data, uint16_t len, uint8_t flags)
+{
+    arq_tx_t *e = &s_tx[seq % WB_ARQ_WIN];
+
+    taskENTER_CRITICAL(&s_lock);
+    uint8_t *old = e->in_use ? e->buf : NULL;
+    e->in_use = true;
+    e->resend = false;
+    e->seq = seq;
+    e->len = len;
+    e->flags = flags;
+    e->buf = buf;
+    e->data = data;
+    e->t_sent_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&s_lock);
+
+    wb_pool_free(old);
+}
+
+void wb_arq_on_nack(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_nack_t)) return;
+
+    wb_nack_t nk;
+    memcpy(&nk, p, sizeof(nk));
+
+    taskENTER_CRITICAL(&s_lock);
+    s_st.nacks_rx++;
+    for (int i = 0; i < 32; i++) {
+        if (!(nk.mask & (1u << i))) continue;
+        uint16_t seq = (uint16_t)(nk.base + i);
+        arq_tx_t *e = &s_tx[seq % WB_ARQ_WIN];
+        if (e->in_use && e->seq == seq) {
+            e->resend = true;
+            s_tx_req = true;
+        } else {
+            s_st.giveups++;              // already out of the window
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void wb_arq_tx_service(wb_arq_resend_t resend)
+{
+    int64_t now = esp_timer_get_time();
+    // a NACK that lands after this sets it again: the next pass resends
+    taskENTER_CRITICAL(&s_lock);
+    s_tx_req = false;
+    taskEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < WB_ARQ_WIN; i++) {
+        arq_tx_t *e = &s_tx[i];
+        if (!e->in_use) continue;
+
+        bool expired = (now - e->t_sent_us) > WB_ARQ_BUDGET_US;
+
+        taskENTER_CRITICAL(&s_lock);
+        bool again = e->resend;
+        e->resend = false;
+        uint8_t *drop = expired ? e->buf : NULL;
+        if (expired) {
+            e->in_use = false;
+            e->buf = NULL;
+        }
+        taskEXIT_CRITICAL(&s_lock);
+
+        if (drop) {
+            if (again) s_st.giveups++;
+            wb_pool_free(drop);
+            continue;
+        }
+        if (again) {
+            s_st.retransmits++;
+            resend(e->seq, e->flags, e->data, e->len);
+        }
+    }
+}
+
+// ---- receiver
+
+bool wb_arq_rx_seen(uint16_t seq)
+{
+    int64_t now = esp_timer_get_time();
+    bool ok = true;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (!s_rx_valid) {
+        s_rx_valid = true;
+        s_rx_hi = seq;
+    }
+
+    int16_t d = (int16_t)(seq - s_rx_hi);
+    if (d >= 0) {
+        if (d >= WB_ARQ_RX_WIN) {
+            // long outage: nothing in the old window can be repaired any more
+            memset(s_rx, 0, sizeof(s_rx));
+            s_rx_missing = 0;
+            s_rx_hi = seq;
+        }
+        // everything between the old head and seq is now a gap
+        for (uint16_t s = s_rx_hi; s != (uint16_t)(seq + 1); s++) {
+            arq_rx_t *e = &s_rx[s % WB_ARQ_RX_WIN];
+            if (e->st == RX_MISSING) s_rx_missing--;
+            e->seq = s;
+            e->st = RX_MISSING;
+            e->t_first_us = now;
+            e->t_nack_us = 0;
+            s_rx_missing++;
+        }
+        s_rx_hi = (uint16_t)(seq + 1);
+    } else {
+        arq_rx_t *e = &s_rx[seq % WB_ARQ_RX_WIN];
+        if (-d > WB_ARQ_RX_WIN || e->seq != seq || e->st == RX_DONE) ok = false;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return ok;
+}
+
+void wb_arq_rx_done(uint16_t seq)
+{
+    taskENTER_CRITICAL(&s_lock);
+    arq_rx_t *e = &s_rx[seq % WB_ARQ_RX_WIN];
+    if (e->seq == seq && e->st != RX_DONE) {
+        if (e->st == RX_MISSING) s_rx_missing--;
+        if (e->t_nack_us != 0) s_st.late_recoveries++;
+        e->st = RX_DONE;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool wb_arq_rx_build_nack(wb_nack_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    bool any = false;
+
+    memset(out, 0, sizeof(*out));
+    out->type = WB_CTRL_NACK;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_rx_missing) {
+        // oldest first, so bit i maps to base + i
+        uint16_t start = (uint16_t)(s_rx_hi - WB_ARQ_RX_WIN);
+        for (int i = 0; i < WB_ARQ_RX_WIN; i++) {
+            uint16_t seq = (uint16_t)(start + i);
+            arq_rx_t *e = &s_rx[seq % WB_ARQ_RX_WIN];
+            if (e->seq != seq || e->st != RX_MISSING) continue;
+
+            int64_t age = now - e->t_first_us;
+            if (age > WB_ARQ_BUDGET_US) {
+                e->st = RX_NONE;
+                s_rx_missing--;
+                s_st.giveups++;
+                continue;
+            }
+            // give in-flight fragments one NACK interval before asking
+            if (age < WB_ARQ_NACK_US) continue;
+            if (e->t_nack_us && (now - e->t_nack_us) < WB_ARQ_NACK_US) continue;
+
+            if (!any) {
+                out->base = seq;
+                any = true;
+            }
+            out->mask |= 1u << (uint16_t)(seq - out->base);
+            e->t_nack_us = now;
+        }
+    }
+    if (any) s_st.nacks_tx++;
+    taskEXIT_CRITICAL(&s_lock);
+
+    return any;
+}
+
+bool wb_arq_pending(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool any = s_rx_missing != 0 || s_tx_req;
+    taskEXIT_CRITICAL(&s_lock);
+    return any;
+}
+
+void wb_arq_get_stats(wb_arq_stats_t *out)
+{
+    if (out) *out = s_st;
+}
+#endif
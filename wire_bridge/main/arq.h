@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// Selective NACK retransmission for bulk (TCP) frames.
+// Sender keeps sent frames in a small window keyed by reliable seq; the
+// receiver NACKs gaps as a base+bitmap and gives up after the latency budget.
+
+typedef struct {
+    uint32_t nacks_tx;         // NACK datagrams sent
+    uint32_t nacks_rx;         // NACK datagrams received
+    uint32_t retransmits;      // frames resent on request
+    uint32_t late_recoveries;  // NACKed frames that still arrived in time
+    uint32_t giveups;          // missing frames abandoned (budget expired / not in window)
+} wb_arq_stats_t;
+
+// Frames that take the reliable path (real-time traffic bypasses it)
+bool wb_arq_is_bulk(const uint8_t *frame, uint16_t len);
+
+// Sender (udp_tx_task)
+uint16_t wb_arq_next_seq(void);
+// takes the pool buffer; data/len is the encoded frame inside it
+void     wb_arq_tx_store(uint16_t seq, uint8_t *buf, const uint8_t *data, uint16_t len, uint8_t flags);
+
+typedef void (*wb_arq_resend_t)(uint16_t seq, uint8_t flags, const uint8_t *data, uint16_t len);
+void wb_arq_tx_service(wb_arq_resend_t resend);
+
+// Sender, RX context: peer asks for missing seqs
+void wb_arq_on_nack(const uint8_t *p, int n);
+
+// Receiver: seen() on every reliable fragment (false = duplicate/stale, drop it),
+// done() when the frame was delivered
+bool wb_arq_rx_seen(uint16_t seq);
+void wb_arq_rx_done(uint16_t seq);
+bool wb_arq_rx_build_nack(wb_nack_t *out);   // udp_tx_task
+
+bool wb_arq_pending(void);                   // anything to NACK or resend
+void wb_arq_get_stats(wb_arq_stats_t *out);
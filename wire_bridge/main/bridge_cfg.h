@@ -1,14 +1,23 @@
 #pragma once
 #include <stdint.h>
+#include "sdkconfig.h"
 
+// Tunnel subnet; host builds may bring their own (e.g. 127.0.0.x)
+#ifndef WB_NET_BASE_IP0
 #define WB_NET_BASE_IP0 192
 #define WB_NET_BASE_IP1 168
 #define WB_NET_BASE_IP2 50
+#endif
 
 // AP side:
 #define WB_IP_AP_LAST   1
-// STA side:
-#define WB_IP_STA_LAST  2
+// STA side: spoke n (CONFIG_WB_STA_INDEX) is .2 + n; hub peer i is .2 + i
+#define WB_IP_STA_BASE  2
+#ifdef CONFIG_WB_STA_INDEX
+#define WB_IP_STA_LAST  (WB_IP_STA_BASE + CONFIG_WB_STA_INDEX)
+#else
+#define WB_IP_STA_LAST  WB_IP_STA_BASE
+#endif
 
 // Netmask /24
 #define WB_NETMASK0 255
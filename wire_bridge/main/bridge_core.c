@@ -0,0 +1,51 @@
+// bridge_core.c — ETH <-> UDP frame path, the same on the device and the host
+#include "bridge_core.h"
+#include "udp_tunnel.h"
+#include "fdb.h"
+#include "pkt_filter.h"
+#include "capture.h"
+#include "wb_stats.h"
+
+static wb_bridge_eth_tx_t s_eth_tx;
+
+void wb_bridge_init(wb_bridge_eth_tx_t eth_tx)
+{
+    s_eth_tx = eth_tx;
+#if CONFIG_WB_PF
+    wb_pf_init();
+#endif
+}
+
+bool wb_bridge_eth_in(const uint8_t *frame, size_t len, uint32_t t_in_us)
+{
+    wb_stats_frame(WB_CTR_ETH_RX_FRAMES, WB_CTR_ETH_RX_BYTES, (uint32_t)len);
+    wb_cap_frame(WB_CAP_ETH_IN, frame, len);
+#if CONFIG_WB_PF
+    // site noise (mDNS, SSDP, RA ...) never reaches the tunnel
+    if (wb_pf_drop(frame, (uint16_t)len)) {
+        wb_stats_inc(WB_CTR_ETH_RX_FILTERED);
+        return true;
+    }
+#endif
+#if CONFIG_WB_FDB
+    // unicast between two hosts on our segment never crosses the tunnel
+    if (wb_fdb_eth_in(frame, (uint16_t)len)) {
+        wb_stats_inc(WB_CTR_ETH_RX_LOCAL);
+        return true;
+    }
+#endif
+    // a refused frame is counted by the tunnel (tun_tx_drop)
+    return wb_udp_send_frame_at(frame, len, t_in_us);
+}
+
+void wb_bridge_udp_in(const uint8_t *frame, size_t len, void *user)
+{
+    (void)user;
+    // source MAC already learned (with its peer) by the tunnel
+    if (!s_eth_tx || !s_eth_tx(frame, len)) {
+        wb_stats_inc(WB_CTR_ETH_TX_FAIL);
+        return;
+    }
+    wb_stats_frame(WB_CTR_ETH_TX_FRAMES, WB_CTR_ETH_TX_BYTES, (uint32_t)len);
+    wb_cap_frame(WB_CAP_ETH_OUT, frame, len);
+}
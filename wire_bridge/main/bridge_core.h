@@ -0,0 +1,23 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// The frame path between the Ethernet side and the tunnel, shared by the
+// firmware (EMAC, eth_tap.c) and wb_host (TAP, generator, sink): counters,
+// capture points, ingress filter and FDB. The Ethernet side only moves
+// frames.
+
+// Ethernet transmit of the side in use: true = sent
+typedef bool (*wb_bridge_eth_tx_t)(const uint8_t *frame, size_t len);
+
+// Before the tunnel starts
+void wb_bridge_init(wb_bridge_eth_tx_t eth_tx);
+
+// ETH -> UDP, from the Ethernet RX task. t_in_us = arrival (esp_timer,
+// truncated), 0 = now. false = the tunnel refused it (counted as
+// tun_tx_drop); filtered and local frames are consumed, true.
+bool wb_bridge_eth_in(const uint8_t *frame, size_t len, uint32_t t_in_us);
+
+// UDP -> ETH: the wb_udp_start() callback, user unused
+void wb_bridge_udp_in(const uint8_t *frame, size_t len, void *user);
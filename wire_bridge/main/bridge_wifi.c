@@ -3,6 +3,8 @@
 // Static IPs:
 //   AP  : 192.168.50.1/24 (runs DHCP server for STA)
 //   STA : 192.168.50.2/24 (static, no DHCP client)
+// ESP-NOW transport: no AP, no association, no IP; the radio just sits on
+// CONFIG_WB_WIFI_CHANNEL and "ok" means the peer was heard lately.
 
 #include "bridge_wifi.h"
 #include "bridge_cfg.h"
@@ -16,8 +18,16 @@
 
 #include "lwip/ip4_addr.h"   // IP4_ADDR
 
+#if CONFIG_WB_TRANSPORT_ESPNOW
+#include "esp_timer.h"
+#include "transport.h"
+
+#define WB_ESPNOW_LINK_US (3 * 1000000LL)   // peer silent this long = link down
+#endif
+
 static const char *TAG = "wb_wifi";
 
+#if !CONFIG_WB_TRANSPORT_ESPNOW
 static esp_netif_t *s_netif = NULL;
 static wb_wifi_state_t s_state = {.ok = false, .rssi = 0};
 
@@ -90,6 +100,8 @@ static void ip_event_handler(void *arg, esp_event_base_t base, int32_t id, void
 #endif
 }
 
+#endif
+
 void wb_wifi_start(void)
 {
     // IMPORTANT:
@@ -101,6 +113,16 @@ void wb_wifi_start(void)
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     ESP_ERROR_CHECK(esp_wifi_set_ps(WIFI_PS_NONE));
+
+#if CONFIG_WB_TRANSPORT_ESPNOW
+    // STA interface up but never connecting: ESP-NOW only needs the channel
+    ESP_ERROR_CHECK(esp_wifi_set_storage(WIFI_STORAGE_RAM));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_start());
+    ESP_ERROR_CHECK(esp_wifi_set_channel(CONFIG_WB_WIFI_CHANNEL, WIFI_SECOND_CHAN_NONE));
+
+    ESP_LOGI(TAG, "ESP-NOW radio ready: ch=%d", CONFIG_WB_WIFI_CHANNEL);
+#else
     ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
     ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, ESP_EVENT_ANY_ID, &ip_event_handler, NULL));
 
@@ -112,7 +134,11 @@ void wb_wifi_start(void)
     strncpy((char *)w.ap.password, CONFIG_WB_WIFI_PASS, sizeof(w.ap.password));
     w.ap.ssid_len = (uint8_t)strlen(CONFIG_WB_WIFI_SSID);
     w.ap.channel = CONFIG_WB_WIFI_CHANNEL;
+#if CONFIG_WB_HUB
+    w.ap.max_connection = CONFIG_WB_HUB_PEERS;   // one station per spoke
+#else
     w.ap.max_connection = 1;
+#endif
     w.ap.authmode = (strlen(CONFIG_WB_WIFI_PASS) == 0) ? WIFI_AUTH_OPEN : WIFI_AUTH_WPA2_PSK;
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_AP));
@@ -140,12 +166,20 @@ void wb_wifi_start(void)
     ESP_ERROR_CHECK(esp_wifi_start());
 
     set_static_ip_sta();
-    ESP_LOGI(TAG, "STA ready: ssid=%s ip=192.168.50.2 gw=192.168.50.1",
-             CONFIG_WB_WIFI_SSID);
+    ESP_LOGI(TAG, "STA ready: ssid=%s ip=192.168.50.%d gw=192.168.50.1",
+             CONFIG_WB_WIFI_SSID, WB_IP_STA_LAST);
+#endif
 #endif
 }
 
 wb_wifi_state_t wb_wifi_get_state(void)
 {
+#if CONFIG_WB_TRANSPORT_ESPNOW
+    wb_espnow_stats_t es;
+    wb_espnow_get_stats(&es);
+    bool up = es.t_rx_us && esp_timer_get_time() - es.t_rx_us < WB_ESPNOW_LINK_US;
+    return (wb_wifi_state_t){ .ok = up, .rssi = up ? es.rssi : 0 };
+#else
     return s_state;
+#endif
 }
@@ -1,4 +1,5 @@
 #include "buttons.h"
+#include "task_topo.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -80,5 +81,5 @@ void buttons_init(wb_btn_cb_t cb, void *user)
     ESP_LOGI(TAG, "Buttons: UP=%d DOWN=%d ENTER=%d (active-low, needs external pull-up)",
              PIN_UP, PIN_DOWN, PIN_ENTER);
 
-    xTaskCreate(buttons_task, "buttons", 2048, NULL, 12, NULL);
+    wb_task_create(WB_STAGE_BUTTONS, buttons_task, NULL, NULL);
 }
@@ -0,0 +1,653 @@
+// capture.c — packet capture ring and its pcapng writer
+//
+// The ring is an array of fixed-size slots, one frame each (the header
+// and snaplen bytes). A producer (the Ethernet RX, tunnel RX or udp_tx
+// task) takes the next frame number i with one atomic add and owns slot
+// i % n by moving its sequence word to 2i+1 (odd: being copied in) and on
+// to 2i+2 once the copy is whole. Nothing waits: while armed, new frames
+// overwrite the oldest, so the ring is the latest history. Once
+// triggered, the cap task copies slots out in frame order and checks the
+// sequence word again after the copy: a slot overwritten before it got
+// there is counted lost, not written torn.
+//
+// Producers in wb_cap_record() are counted in s_busy. The cap task only
+// turns the state to off once the mask is clear and s_busy is 0, so
+// wb_cap_arm() never resizes or clears the ring under a producer.
+//
+// The ring and the writer's buffers are one heap block, taken by
+// wb_cap_arm() and given back when the cap task goes off: capture is
+// built in but idle almost all the time, and DRAM is short.
+
+#include "capture.h"
+
+#if CONFIG_WB_CAP
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_spiffs.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "pkt_filter.h"
+#include "task_topo.h"
+#include "wb_stats.h"
+
+static const char *TAG = "wb_cap";
+
+#ifndef WB_CAP_BASE
+#define WB_CAP_BASE      "/storage"     // host port: a directory of its own
+#endif
+#define WB_CAP_PARTITION "storage"
+#define WB_CAP_RING      (CONFIG_WB_CAP_RING_KB * 1024)
+#define WB_CAP_FILE_MAX  (CONFIG_WB_CAP_FILE_KB * 1024)
+#define WB_CAP_POLL_MS   50
+#define WB_CAP_BUF       4096          // file write staging
+#define WB_CAP_SNAP_MAX  1518
+#define WB_CAP_REC       (sizeof(slot_t) + WB_CAP_SNAP_MAX)      // one slot copied out
+
+typedef struct {
+    uint32_t seq;           // 2i+1 while frame i is copied in, 2i+2 once whole
+    uint32_t t_lo, t_hi;    // esp_timer: history may wait in its slot for hours
+    uint16_t orig_len;
+    uint16_t cap_len;
+    uint8_t  point;
+    uint8_t  rsvd[3];
+} slot_t;
+
+_Static_assert(sizeof(slot_t) == 20, "slot_t");
+
+// WB_CAP_RING, then the writer's WB_CAP_BUF and WB_CAP_REC; NULL while off
+static uint8_t *s_ring;
+static uint32_t s_slot_size, s_nslots;  // from the snap length, at arm
+static uint32_t s_head;                 // next frame number
+static uint32_t s_busy;                 // producers inside wb_cap_record()
+
+uint8_t wb_cap_mask;
+static volatile uint8_t s_state = WB_CAP_OFF;
+static volatile uint8_t s_stop;         // recording ended, write out the ring
+static uint16_t s_snaplen;
+static uint32_t s_post_max;
+static uint32_t s_post;                 // kept since the trigger
+static uint32_t s_trig_head;            // s_head when the trigger fired
+static wb_cap_trig_t s_trigger;
+
+// Rules in use: replaced only while off, with no producer running them
+static wb_pf_prog_t *s_filter, *s_match;
+
+static TaskHandle_t s_task;
+static bool s_mounted;
+static uint64_t s_drop_base;            // WB_CAP_TRIG_DROP
+
+// writer (cap task)
+static uint32_t s_next;                 // next frame to write out
+static bool s_started;                  // s_next placed since the trigger
+static bool s_waiting;                  // s_next was still being copied in last pass
+static FILE *s_file;
+static uint32_t s_file_bytes;
+static uint64_t s_bytes;                // all files
+static int64_t s_wall_us;               // wall clock - esp_timer, fixed per file
+static unsigned s_first_idx, s_next_idx;    // capNNNN.pcapng on storage
+static uint8_t *s_buf;                  // file write staging, in the ring's block
+static size_t s_buf_n;
+
+static wb_cap_stats_t s_st;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const wb_cap_cfg_t k_default = {
+    .points = CONFIG_WB_CAP_POINTS,
+    .snaplen = CONFIG_WB_CAP_SNAPLEN,
+#if CONFIG_WB_CAP_TRIG_MATCH
+    .trigger = WB_CAP_TRIG_MATCH,
+    .match = CONFIG_WB_CAP_MATCH,
+#elif CONFIG_WB_CAP_TRIG_DROP
+    .trigger = WB_CAP_TRIG_DROP,
+#else
+    .trigger = WB_CAP_TRIG_MANUAL,
+#endif
+    .filter = CONFIG_WB_CAP_FILTER,
+    .post_frames = CONFIG_WB_CAP_POST_FRAMES,
+};
+
+static inline slot_t *slot_at(uint32_t i)
+{
+    return (slot_t *)&s_ring[(i % s_nslots) * s_slot_size];
+}
+
+// ---- producers
+
+static void trigger_fired(void)
+{
+    uint8_t armed = WB_CAP_ARMED;
+    uint32_t h = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    if (__atomic_compare_exchange_n(&s_state, &armed, WB_CAP_TRIGGERED, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        s_trig_head = h;
+        xTaskNotifyGive(s_task);
+    }
+}
+
+static void record(wb_cap_point_t pt, const uint8_t *frame, uint16_t len, uint32_t c0)
+{
+    const wb_pf_prog_t *f = __atomic_load_n(&s_filter, __ATOMIC_ACQUIRE);
+    if (f && wb_pf_prog_match(f, frame, len) != 1) {
+        wb_stats_frame(WB_CTR_CAP_FILTERED, WB_CTR_CAP_CYCLES, esp_cpu_get_cycle_count() - c0);
+        return;
+    }
+
+    uint8_t st = __atomic_load_n(&s_state, __ATOMIC_ACQUIRE);
+    if (st == WB_CAP_ARMED && s_trigger == WB_CAP_TRIG_MATCH) {
+        const wb_pf_prog_t *m = __atomic_load_n(&s_match, __ATOMIC_ACQUIRE);
+        if (m && wb_pf_prog_match(m, frame, len) == 1) {
+            trigger_fired();
+            st = WB_CAP_TRIGGERED;
+        }
+    }
+    if (st == WB_CAP_TRIGGERED && s_post_max &&
+        __atomic_fetch_add(&s_post, 1, __ATOMIC_RELAXED) >= s_post_max) {
+        // enough after the trigger: the cap task writes out the rest
+        __atomic_store_n(&wb_cap_mask, 0, __ATOMIC_SEQ_CST);
+        if (!s_stop) {
+            s_stop = 1;
+            xTaskNotifyGive(s_task);
+        }
+        return;
+    }
+
+    uint64_t now = (uint64_t)esp_timer_get_time();
+    uint32_t i = __atomic_fetch_add(&s_head, 1, __ATOMIC_RELAXED);
+    slot_t *sl = slot_at(i);
+
+    // a frame a ring earlier still being copied in, or a later one already
+    // there (this task was preempted for a whole ring): leave it
+    uint32_t s = __atomic_load_n(&sl->seq, __ATOMIC_RELAXED);
+    if ((s & 1) || (int32_t)(s - 2 * i) > 0 ||
+        !__atomic_compare_exchange_n(&sl->seq, &s, 2 * i + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        wb_stats_frame(WB_CTR_CAP_LOST, WB_CTR_CAP_CYCLES, esp_cpu_get_cycle_count() - c0);
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);   // odd seq before the data
+
+    uint16_t cap = len < s_snaplen ? len : s_snaplen;
+    sl->t_lo = (uint32_t)now;
+    sl->t_hi = (uint32_t)(now >> 32);
+    sl->orig_len = len;
+    sl->cap_len = cap;
+    sl->point = (uint8_t)pt;
+    memcpy(sl + 1, frame, cap);
+    __atomic_store_n(&sl->seq, 2 * i + 2, __ATOMIC_RELEASE);
+
+    // wake the writer when it is half a ring behind, not per frame
+    if (st == WB_CAP_TRIGGERED && i - __atomic_load_n(&s_next, __ATOMIC_RELAXED) == s_nslots / 2) {
+        xTaskNotifyGive(s_task);
+    }
+
+    wb_stats_frame(WB_CTR_CAP_FRAMES, WB_CTR_CAP_CYCLES, esp_cpu_get_cycle_count() - c0);
+}
+
+void wb_cap_record(wb_cap_point_t pt, const uint8_t *frame, uint16_t len)
+{
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    // counted in before the mask is read again: a producer that still sees
+    // it set keeps the cap task from going off, and with it any re-arm
+    __atomic_fetch_add(&s_busy, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&wb_cap_mask, __ATOMIC_SEQ_CST) & (1u << pt)) record(pt, frame, len, c0);
+    __atomic_fetch_sub(&s_busy, 1, __ATOMIC_RELEASE);
+}
+
+// Mask clear and no producer left in the ring (cap task)
+static bool producers_out(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    return __atomic_load_n(&s_busy, __ATOMIC_ACQUIRE) == 0;
+}
+
+// ---- pcapng
+
+#define PCAPNG_SHB     0x0A0D0D0Au
+#define PCAPNG_IDB     0x00000001u
+#define PCAPNG_EPB     0x00000006u
+#define PCAPNG_MAGIC   0x1A2B3C4Du
+#define LINKTYPE_ETHERNET 1
+
+#define PAD4(n) (((n) + 3) & ~3u)
+
+enum { IF_ETH, IF_TUNNEL };
+
+static void put(const void *p, size_t n);
+
+static void put32(uint32_t v)
+{
+    put(&v, 4);
+}
+
+// Option: code, length, value padded to 4
+static void put_opt(uint16_t code, const void *v, uint16_t n)
+{
+    static const uint8_t zero[3];
+    uint16_t hdr[2] = { code, n };
+    put(hdr, 4);
+    put(v, n);
+    put(zero, PAD4(n) - n);
+}
+
+static void put_shb(void)
+{
+    static const char appl[] = "wire_bridge";
+    uint32_t len = 28 + 4 + PAD4(sizeof(appl) - 1) + 4;
+    put32(PCAPNG_SHB);
+    put32(len);
+    put32(PCAPNG_MAGIC);
+    put32(1);                 // version 1.0
+    put32(0xFFFFFFFFu);       // section length unknown
+    put32(0xFFFFFFFFu);
+    put_opt(4, appl, sizeof(appl) - 1);    // shb_userappl
+    put32(0);                 // opt_endofopt
+    put32(len);
+}
+
+static void put_idb(const char *name)
+{
+    uint16_t n = (uint16_t)strlen(name);
+    uint32_t len = 20 + 4 + PAD4(n) + 4;
+    uint16_t lt[2] = { LINKTYPE_ETHERNET, 0 };
+    put32(PCAPNG_IDB);
+    put32(len);
+    put(lt, 4);
+    put32(s_snaplen);
+    put_opt(2, name, n);      // if_name; timestamps in us, the default
+    put32(0);
+    put32(len);
+}
+
+static void put_epb(const slot_t *r, uint64_t ts_us)
+{
+    static const uint8_t zero[3];
+    // into the tunnel is outbound on "tunnel", out of it inbound
+    uint32_t iface = r->point == WB_CAP_ETH_IN || r->point == WB_CAP_ETH_OUT ? IF_ETH : IF_TUNNEL;
+    uint32_t flags = r->point == WB_CAP_ETH_IN || r->point == WB_CAP_TUN_IN ? 1 : 2;   // epb_flags direction
+    uint32_t len = 28 + PAD4(r->cap_len) + 8 + 4 + 4;
+
+    put32(PCAPNG_EPB);
+    put32(len);
+    put32(iface);
+    put32((uint32_t)(ts_us >> 32));
+    put32((uint32_t)ts_us);
+    put32(r->cap_len);
+    put32(r->orig_len);
+    put(r + 1, r->cap_len);
+    put(zero, PAD4(r->cap_len) - r->cap_len);
+    put_opt(2, &flags, 4);
+    put32(0);
+    put32(len);
+}
+
+// ---- files
+
+static void file_name(unsigned idx, char *out, size_t n)
+{
+    snprintf(out, n, "cap%04u.pcapng", idx % 10000);
+}
+
+static void file_path(unsigned idx, char *out, size_t n)
+{
+    char name[24];
+    file_name(idx, name, sizeof(name));
+    snprintf(out, n, "%s/%s", WB_CAP_BASE, name);
+}
+
+static void write_error(void)
+{
+    ESP_LOGW(TAG, "write to %s failed, file closed", s_st.file);
+    fclose(s_file);
+    s_file = NULL;
+    taskENTER_CRITICAL(&s_lock);
+    s_st.write_errors++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void flush_buf(void)
+{
+    if (s_file && s_buf_n && fwrite(s_buf, 1, s_buf_n, s_file) != s_buf_n) write_error();
+    if (s_file) fflush(s_file);
+    s_buf_n = 0;
+}
+
+static void put(const void *p, size_t n)
+{
+    size_t n0 = n;
+    const uint8_t *b = (const uint8_t *)p;
+    while (n) {
+        size_t k = WB_CAP_BUF - s_buf_n;
+        if (k > n) k = n;
+        memcpy(&s_buf[s_buf_n], b, k);
+        s_buf_n += k;
+        b += k;
+        n -= k;
+        if (s_buf_n == WB_CAP_BUF) flush_buf();
+    }
+    s_file_bytes += (uint32_t)n0;
+    s_bytes += n0;
+}
+
+static void file_close(void)
+{
+    if (!s_file) return;
+    flush_buf();
+    if (s_file) fclose(s_file);
+    s_file = NULL;
+}
+
+// Delete the oldest captures until a new file leaves a quarter free
+static void make_room(void)
+{
+    char path[48];
+    size_t total = 0, used = 0;
+    while (s_first_idx < s_next_idx &&
+           esp_spiffs_info(WB_CAP_PARTITION, &total, &used) == ESP_OK &&
+           used + WB_CAP_FILE_MAX > total / 4 * 3) {
+        file_path(s_first_idx++, path, sizeof(path));
+        if (unlink(path) == 0) ESP_LOGI(TAG, "deleted %s", path);
+    }
+}
+
+static bool file_open(void)
+{
+    char path[48];
+    make_room();
+    file_path(s_next_idx, path, sizeof(path));
+    s_file = fopen(path, "wb");
+    if (!s_file) {
+        ESP_LOGW(TAG, "%s: cannot create", path);
+        taskENTER_CRITICAL(&s_lock);
+        s_st.write_errors++;
+        taskEXIT_CRITICAL(&s_lock);
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    file_name(s_next_idx, s_st.file, sizeof(s_st.file));
+    s_st.files++;
+    taskEXIT_CRITICAL(&s_lock);
+    s_next_idx++;
+    ESP_LOGI(TAG, "writing %s", path);
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    s_wall_us = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+
+    s_buf_n = 0;
+    s_file_bytes = 0;
+    put_shb();
+    put_idb("eth");
+    put_idb("tunnel");
+    return true;
+}
+
+// Existing captures: oldest and next free index
+static void scan_dir(void)
+{
+    DIR *d = opendir(WB_CAP_BASE);
+    if (!d) return;
+    unsigned lo = ~0u, hi = 0;
+    bool any = false;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned idx;
+        char ext[8];
+        if (sscanf(e->d_name, "cap%4u.%7s", &idx, ext) == 2 && strcmp(ext, "pcapng") == 0) {
+            if (idx < lo) lo = idx;
+            if (idx > hi) hi = idx;
+            any = true;
+        }
+    }
+    closedir(d);
+    if (any) {
+        s_first_idx = lo;
+        s_next_idx = hi + 1;
+    }
+}
+
+// ---- cap task
+
+// Off: no producer can reach the ring any more
+static void ring_release(void)
+{
+    heap_caps_free(s_ring);
+    s_ring = NULL;
+    s_buf = NULL;
+}
+
+static uint64_t drop_count(void)
+{
+    wb_stats_t st;
+    wb_stats_snapshot(&st);
+    return st.c[WB_CTR_TUN_TX_DROP] + st.c[WB_CTR_TUN_RX_DROP] + st.c[WB_CTR_ETH_TX_FAIL];
+}
+
+// Copy frame i out of its slot: 1 = whole, 0 = not there yet, -1 = lost
+static int slot_take(uint32_t i, slot_t *out)
+{
+    const slot_t *sl = slot_at(i);
+    uint32_t want = 2 * i + 2;
+    uint32_t s = __atomic_load_n(&sl->seq, __ATOMIC_ACQUIRE);
+    if (s != want) return (int32_t)(s - want) > 0 ? -1 : 0;
+
+    memcpy(out, sl, sizeof(*sl));
+    if (out->cap_len > s_snaplen) out->cap_len = s_snaplen;     // torn: fails the check below
+    memcpy(out + 1, sl + 1, out->cap_len);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&sl->seq, __ATOMIC_RELAXED) == want ? 1 : -1;
+}
+
+// Write out frames up to the head
+static void ring_write(void)
+{
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    uint32_t written = 0, lost = 0;
+
+    if (!s_started) {
+        // history: the half ring before the trigger
+        uint32_t h = s_trig_head < s_nslots / 2 ? s_trig_head : s_nslots / 2;
+        __atomic_store_n(&s_next, s_trig_head - h, __ATOMIC_RELAXED);
+        s_started = true;
+        s_waiting = false;
+    }
+    if (head - s_next > s_nslots) {
+        // a whole ring behind: those frames are gone
+        lost += head - s_nslots - s_next;
+        __atomic_store_n(&s_next, head - s_nslots, __ATOMIC_RELAXED);
+    }
+
+    slot_t *rec = (slot_t *)(s_ring + WB_CAP_RING + WB_CAP_BUF);
+    while (s_next != head) {
+        int got = slot_take(s_next, rec);
+        if (got == 0) {
+            // still being copied in, or its producer found the slot busy and
+            // left it: wait one pass, then count it lost
+            if (!s_waiting) {
+                s_waiting = true;
+                break;
+            }
+            got = -1;
+        }
+        s_waiting = false;
+        if (got > 0) {
+            if (s_file && s_file_bytes + 44 + PAD4(rec->cap_len) > WB_CAP_FILE_MAX) file_close();
+            if (!s_file && !file_open()) break;     // the ring waits for the next pass
+            put_epb(rec, ((uint64_t)rec->t_hi << 32 | rec->t_lo) + s_wall_us);
+            written++;
+        } else {
+            lost++;
+        }
+        __atomic_store_n(&s_next, s_next + 1, __ATOMIC_RELAXED);
+    }
+    flush_buf();
+
+    if (lost) wb_stats_add(WB_CTR_CAP_LOST, lost);
+    taskENTER_CRITICAL(&s_lock);
+    s_st.written += written;
+    s_st.bytes = s_bytes;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+static void cap_task(void *arg)
+{
+    esp_vfs_spiffs_conf_t conf = {
+        .base_path = WB_CAP_BASE,
+        .partition_label = WB_CAP_PARTITION,
+        .max_files = 2,
+        .format_if_mount_failed = true,     // first boot: can take a while
+    };
+    esp_err_t err = esp_vfs_spiffs_register(&conf);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "storage partition not mounted: %s", esp_err_to_name(err));
+        s_task = NULL;
+        vTaskDelete(NULL);
+        return;
+    }
+    size_t total = 0, used = 0;
+    esp_spiffs_info(WB_CAP_PARTITION, &total, &used);
+    scan_dir();
+    ESP_LOGI(TAG, "storage: %u of %u KB used, next capture cap%04u", (unsigned)(used / 1024),
+             (unsigned)(total / 1024), s_next_idx % 10000);
+    s_mounted = true;
+
+#if CONFIG_WB_CAP_AUTO_ARM
+    wb_cap_arm(NULL);
+#endif
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WB_CAP_POLL_MS));
+
+        uint8_t st = __atomic_load_n(&s_state, __ATOMIC_ACQUIRE);
+        if (st == WB_CAP_ARMED && s_trigger == WB_CAP_TRIG_DROP && !s_stop &&
+            drop_count() != s_drop_base) {
+            trigger_fired();
+            st = __atomic_load_n(&s_state, __ATOMIC_ACQUIRE);
+        }
+
+        if (st == WB_CAP_ARMED && s_stop && producers_out()) {
+            // the ring is only history: nothing to write
+            ring_release();
+            __atomic_store_n(&s_state, WB_CAP_OFF, __ATOMIC_RELEASE);
+            s_stop = 0;
+            ESP_LOGI(TAG, "disarmed");
+        } else if (st == WB_CAP_TRIGGERED) {
+            ring_write();
+            if (s_stop && producers_out() && s_next == __atomic_load_n(&s_head, __ATOMIC_ACQUIRE)) {
+                bool wrote = s_file != NULL;
+                file_close();
+                ring_release();
+                __atomic_store_n(&s_state, WB_CAP_OFF, __ATOMIC_RELEASE);
+                s_stop = 0;
+                ESP_LOGI(TAG, "capture done%s%s", wrote ? ": " : ", nothing written", wrote ? s_st.file : "");
+            }
+        }
+    }
+}
+
+// ---- control
+
+esp_err_t wb_cap_init(void)
+{
+    if (s_task) return ESP_OK;
+    return wb_task_create(WB_STAGE_CAP, cap_task, NULL, &s_task) == pdPASS ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+const wb_cap_cfg_t *wb_cap_default_cfg(void)
+{
+    return &k_default;
+}
+
+esp_err_t wb_cap_arm(const wb_cap_cfg_t *cfg)
+{
+    if (!cfg) cfg = &k_default;
+    if (!s_mounted) return ESP_ERR_INVALID_STATE;
+    if (__atomic_load_n(&s_state, __ATOMIC_ACQUIRE) != WB_CAP_OFF || s_stop) return ESP_ERR_INVALID_STATE;
+    if (!(cfg->points & ((1u << WB_CAP_POINTS) - 1)) || cfg->snaplen < 14) return ESP_ERR_INVALID_ARG;
+
+    wb_pf_prog_t *f = NULL, *m = NULL;
+    if (cfg->filter && *cfg->filter && !(f = wb_pf_prog_new(cfg->filter))) return ESP_ERR_INVALID_ARG;
+    if (cfg->trigger == WB_CAP_TRIG_MATCH &&
+        (!cfg->match || !*cfg->match || !(m = wb_pf_prog_new(cfg->match)))) {
+        wb_pf_prog_free(f);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // off: no producer inside (cap_task), the ring and rules are ours
+    _Static_assert(WB_CAP_RING % 4 == 0 && WB_CAP_BUF % 4 == 0, "slot_t alignment");
+    s_ring = heap_caps_malloc(WB_CAP_RING + WB_CAP_BUF + WB_CAP_REC, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (!s_ring) {
+        ESP_LOGW(TAG, "no RAM for the %u KB ring", (unsigned)(WB_CAP_RING / 1024));
+        wb_pf_prog_free(f);
+        wb_pf_prog_free(m);
+        return ESP_ERR_NO_MEM;
+    }
+    s_buf = s_ring + WB_CAP_RING;
+
+    wb_pf_prog_free(s_filter);
+    wb_pf_prog_free(s_match);
+    s_filter = f;
+    s_match = m;
+
+    // at least 16 slots
+    uint32_t snap = cfg->snaplen;
+    if (snap > WB_CAP_SNAP_MAX) snap = WB_CAP_SNAP_MAX;
+    if (snap > WB_CAP_RING / 16 - sizeof(slot_t)) snap = WB_CAP_RING / 16 - sizeof(slot_t);
+    s_snaplen = (uint16_t)snap;
+    s_slot_size = PAD4(sizeof(slot_t) + snap);
+    s_nslots = WB_CAP_RING / s_slot_size;
+    memset(s_ring, 0, WB_CAP_RING);
+    s_head = 0;
+    s_next = 0;
+    s_started = false;
+    s_trigger = cfg->trigger;
+    s_post_max = cfg->post_frames;
+    s_post = 0;
+    if (s_trigger == WB_CAP_TRIG_DROP) s_drop_base = drop_count();
+
+    __atomic_store_n(&s_state, WB_CAP_ARMED, __ATOMIC_RELEASE);
+    __atomic_store_n(&wb_cap_mask, cfg->points & ((1u << WB_CAP_POINTS) - 1), __ATOMIC_SEQ_CST);
+    ESP_LOGI(TAG, "armed: points 0x%x, snaplen %u, trigger %d%s", wb_cap_mask, s_snaplen,
+             (int)s_trigger, f ? ", filtered" : "");
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void wb_cap_trigger(void)
+{
+    if (s_task) trigger_fired();
+}
+
+void wb_cap_stop(void)
+{
+    if (!s_task || __atomic_load_n(&s_state, __ATOMIC_ACQUIRE) == WB_CAP_OFF) return;
+    __atomic_store_n(&wb_cap_mask, 0, __ATOMIC_SEQ_CST);
+    s_stop = 1;
+    xTaskNotifyGive(s_task);
+}
+
+void wb_cap_get_stats(wb_cap_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    taskEXIT_CRITICAL(&s_lock);
+    out->state = (wb_cap_state_t)__atomic_load_n(&s_state, __ATOMIC_ACQUIRE);
+    out->stopping = s_stop;
+    uint32_t head = __atomic_load_n(&s_head, __ATOMIC_RELAXED);
+    out->ring_size = s_nslots;
+    if (out->state == WB_CAP_TRIGGERED && s_started) out->ring_used = head - __atomic_load_n(&s_next, __ATOMIC_RELAXED);
+    else if (out->state == WB_CAP_ARMED) out->ring_used = head < s_nslots ? head : s_nslots;
+    else out->ring_used = 0;
+}
+
+#endif // CONFIG_WB_CAP
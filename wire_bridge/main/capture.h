@@ -0,0 +1,106 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+
+// Packet capture (CONFIG_WB_CAP). Frames seen at up to four points go
+// into a lock-free ring in RAM, cut to the snap length, with a microsecond
+// timestamp and the point; the "cap" task (task_topo.h, low priority)
+// writes the ring out as pcapng files on the "storage" SPIFFS partition.
+// In a file, Ethernet and tunnel are two interfaces and every packet
+// carries the inbound/outbound flag. Files rotate at WB_CAP_FILE_KB; the
+// oldest are deleted to make room.
+//
+//   off -> armed: frames recorded, each overwriting the oldest; nothing
+//                 is written
+//       -> triggered: the latest half ring is kept as history and goes
+//                 to the file first, then every frame until post_frames
+//                 more are kept or wb_cap_stop() -> off
+//
+// Off costs one load and branch per frame and point.
+
+typedef enum {
+    WB_CAP_ETH_IN,     // from the wire, ahead of the ingress filter
+    WB_CAP_ETH_OUT,    // to the wire
+    WB_CAP_TUN_OUT,    // into the tunnel: udp_tx_task, before the codecs
+    WB_CAP_TUN_IN,     // out of the tunnel, decoded
+    WB_CAP_POINTS,
+} wb_cap_point_t;
+
+typedef enum {
+    WB_CAP_TRIG_MANUAL,   // wb_cap_trigger()
+    WB_CAP_TRIG_MATCH,    // first frame the trigger rules pass
+    WB_CAP_TRIG_DROP,     // a tunnel drop or an Ethernet TX failure
+} wb_cap_trig_t;
+
+typedef enum {
+    WB_CAP_OFF,
+    WB_CAP_ARMED,
+    WB_CAP_TRIGGERED,
+} wb_cap_state_t;
+
+typedef struct {
+    uint8_t       points;       // bit per wb_cap_point_t
+    uint16_t      snaplen;      // bytes kept per frame
+    wb_cap_trig_t trigger;
+    const char   *filter;       // pkt_filter.h rules, a "pass" keeps the frame; "" = all
+    const char   *match;        // WB_CAP_TRIG_MATCH: rules, a "pass" fires
+    uint32_t      post_frames;  // kept after the trigger; 0 = until stopped
+} wb_cap_cfg_t;
+
+// Frames kept, filtered out, lost (the writer fell a ring behind) and the
+// CPU cycles spent recording: wb_stats.h (cap_*)
+typedef struct {
+    wb_cap_state_t state;
+    bool     stopping;       // ring still being written out
+    uint32_t written;        // packets in files
+    uint32_t files;          // opened since start
+    uint32_t write_errors;
+    uint64_t bytes;          // file bytes
+    uint32_t ring_used;      // frames: history while armed, not yet written once triggered
+    uint32_t ring_size;      // slots
+    char     file[24];       // file being written, or the last one
+} wb_cap_stats_t;
+
+#if CONFIG_WB_CAP
+
+// Mount the storage partition and start the task; arms with the Kconfig
+// configuration when WB_CAP_AUTO_ARM
+esp_err_t wb_cap_init(void);
+
+// Kconfig configuration; the rule strings are static
+const wb_cap_cfg_t *wb_cap_default_cfg(void);
+
+// Off -> armed with cfg (copied, rules compiled); cfg NULL = Kconfig.
+// The ring is taken from the heap here (ESP_ERR_NO_MEM) and given back
+// when capture goes off again.
+esp_err_t wb_cap_arm(const wb_cap_cfg_t *cfg);
+void wb_cap_trigger(void);   // armed -> triggered
+void wb_cap_stop(void);      // recording ends; a triggered ring is still written out
+
+void wb_cap_get_stats(wb_cap_stats_t *out);
+
+// ---- hot path
+
+extern uint8_t wb_cap_mask;  // points recording now
+void wb_cap_record(wb_cap_point_t pt, const uint8_t *frame, uint16_t len);
+
+static inline void wb_cap_frame(wb_cap_point_t pt, const uint8_t *frame, size_t len)
+{
+    if (__builtin_expect(!(__atomic_load_n(&wb_cap_mask, __ATOMIC_RELAXED) & (1u << pt)), 1)) return;
+    wb_cap_record(pt, frame, (uint16_t)len);
+}
+
+#else
+
+static inline void wb_cap_frame(wb_cap_point_t pt, const uint8_t *frame, size_t len)
+{
+    (void)pt;
+    (void)frame;
+    (void)len;
+}
+
+#endif
@@ -0,0 +1,237 @@
+// comp.c — adaptive per-frame LZ4 block compression
+//
+// Compressor is a greedy single-probe LZ4 (hash of 4 bytes -> last
+// position, no chain); positions from earlier frames are simply rejected,
+// so the table is never cleared. The output must save at least 1/16 of
+// the frame or the frame goes out plain.
+
+#include "comp.h"
+
+#include <string.h>
+
+#include "esp_cpu.h"
+
+#define LZ_HASH_LOG     10
+#define LZ_MINMATCH     4
+#define LZ_MFLIMIT      12        // last match starts this far before the end
+#define LZ_LASTLITERALS 5         // block ends with at least this many literals
+
+#define WB_COMP_FLOWS        16
+#define WB_COMP_BACKOFF_MAX  64   // frames
+
+static wb_comp_stats_t s_st;
+
+// -1 = corrupt
+static int lz_decompress(const uint8_t *src, uint16_t n, uint8_t *dst, uint16_t cap)
+{
+    const uint8_t *ip = src, *iend = src + n;
+    uint8_t *op = dst, *oend = dst + cap;
+
+    while (ip < iend) {
+        uint8_t t = *ip++;
+
+        uint32_t lit = t >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > (uint32_t)(iend - ip) || lit > (uint32_t)(oend - op)) return -1;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+
+        if (ip == iend) break;    // last sequence has no match
+
+        if (iend - ip < 2) return -1;
+        uint16_t off = (uint16_t)(ip[0] | (ip[1] << 8));
+        ip += 2;
+        if (off == 0 || off > op - dst) return -1;
+
+        uint32_t ml = t & 15;
+        if (ml == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                ml += b;
+            } while (b == 255);
+        }
+        ml += LZ_MINMATCH;
+        if (ml > (uint32_t)(oend - op)) return -1;
+
+        // byte copy: matches may overlap their own output (runs)
+        const uint8_t *r = op - off;
+        while (ml--) *op++ = *r++;
+    }
+
+    return (int)(op - dst);
+}
+
+#if CONFIG_WB_COMP
+
+typedef struct {
+    uint8_t skip;             // frames left to bypass
+    uint8_t backoff;          // next back-off length (0 = flow compresses)
+} comp_flow_t;
+
+static uint16_t    s_htab[1 << LZ_HASH_LOG];
+static uint8_t     s_out[WB_MAX_FRAME];
+static comp_flow_t s_flow[WB_COMP_FLOWS];
+
+static inline uint32_t rd32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_LOG);
+}
+
+static uint8_t *put_len(uint8_t *op, uint32_t n)
+{
+    while (n >= 255) {
+        *op++ = 255;
+        n -= 255;
+    }
+    *op++ = (uint8_t)n;
+    return op;
+}
+
+// 0 = does not fit in cap
+static uint16_t lz_compress(const uint8_t *src, uint16_t n, uint8_t *dst, uint16_t cap)
+{
+    const uint8_t *ip = src, *anchor = src, *end = src + n;
+    uint8_t *op = dst, *oend = dst + cap;
+
+    if (n > LZ_MFLIMIT) {
+        const uint8_t *mlimit = end - LZ_MFLIMIT;
+        const uint8_t *mend = end - LZ_LASTLITERALS;
+
+        while (ip < mlimit) {
+            uint32_t v = rd32(ip);
+            uint32_t h = lz_hash(v);
+            const uint8_t *ref = src + s_htab[h];
+            s_htab[h] = (uint16_t)(ip - src);
+
+            if (ref >= ip || rd32(ref) != v) {
+                // skip faster through data that does not match
+                ip += 1 + ((ip - anchor) >> 5);
+                continue;
+            }
+
+            const uint8_t *m = ip + LZ_MINMATCH, *r = ref + LZ_MINMATCH;
+            while (m < mend && *m == *r) {
+                m++;
+                r++;
+            }
+
+            uint32_t lit = (uint32_t)(ip - anchor);
+            uint32_t ml = (uint32_t)(m - ip) - LZ_MINMATCH;
+            if (op + 1 + lit + lit / 255 + 1 + 2 + ml / 255 + 1 > oend) return 0;
+
+            uint8_t *tok = op++;
+            *tok = (uint8_t)(((lit >= 15) ? 15 : lit) << 4 | ((ml >= 15) ? 15 : ml));
+            if (lit >= 15) op = put_len(op, lit - 15);
+            memcpy(op, anchor, lit);
+            op += lit;
+
+            uint16_t off = (uint16_t)(ip - ref);
+            *op++ = (uint8_t)off;
+            *op++ = (uint8_t)(off >> 8);
+            if (ml >= 15) op = put_len(op, ml - 15);
+
+            ip = anchor = m;
+        }
+    }
+
+    uint32_t lit = (uint32_t)(end - anchor);
+    if (op + 1 + lit + lit / 255 + 1 > oend) return 0;
+    *op++ = (uint8_t)(((lit >= 15) ? 15 : lit) << 4);
+    if (lit >= 15) op = put_len(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+
+    return (uint16_t)(op - dst);
+}
+
+// Flow = ethertype, and for IPv4 the protocol and destination port
+uint8_t wb_comp_flow(const uint8_t *f, uint16_t len)
+{
+    if (len < 14) return 0;
+
+    uint32_t k = (uint32_t)(f[12] << 8 | f[13]);
+    if (k == 0x0800 && len >= 14 + 20) {
+        const uint8_t *ip = f + 14;
+        uint16_t ihl = (uint16_t)((ip[0] & 0x0F) * 4);
+        k = k * 31 + ip[9];
+        if ((ip[9] == 6 || ip[9] == 17) && len >= 14 + ihl + 4) {
+            k = k * 31 + (uint32_t)(ip[ihl + 2] << 8 | ip[ihl + 3]);
+        }
+    }
+    return (uint8_t)((k * 2654435761u) >> 28);
+}
+
+bool wb_comp_encode(uint8_t flow, uint8_t *f, uint16_t *len)
+{
+    comp_flow_t *fl = &s_flow[flow % WB_COMP_FLOWS];
+    uint16_t n = *len;
+
+    s_st.frames++;
+    if (n < CONFIG_WB_COMP_MIN) {
+        s_st.bypass_small++;
+        return false;
+    }
+    if (fl->skip) {
+        fl->skip--;
+        s_st.bypass_flow++;
+        return false;
+    }
+
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    uint16_t out = lz_compress(f, n, s_out, (uint16_t)(n - n / 16 - 1));
+    s_st.cycles += esp_cpu_get_cycle_count() - c0;
+    s_st.tried_bytes += n;
+
+    if (!out) {
+        fl->backoff = fl->backoff ? (uint8_t)(fl->backoff * 2) : 1;
+        if (fl->backoff > WB_COMP_BACKOFF_MAX) fl->backoff = WB_COMP_BACKOFF_MAX;
+        fl->skip = fl->backoff;
+        s_st.bypass_fail++;
+        return false;
+    }
+
+    fl->backoff = 0;
+    memcpy(f, s_out, out);
+    *len = out;
+
+    s_st.compressed++;
+    s_st.bytes_in += n;
+    s_st.bytes_out += out;
+    return true;
+}
+
+#endif // CONFIG_WB_COMP
+
+const uint8_t *wb_comp_decode(const uint8_t *in, uint16_t *len, uint8_t *out)
+{
+    int n = lz_decompress(in, *len, out, WB_MAX_FRAME);
+    if (n <= 0) {
+        s_st.rx_errors++;
+        return NULL;
+    }
+    s_st.rx_frames++;
+    *len = (uint16_t)n;
+    return out;
+}
+
+void wb_comp_get_stats(wb_comp_stats_t *out)
+{
+    if (out) *out = s_st;
+}
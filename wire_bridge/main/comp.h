@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// Per-frame payload compression (LZ4 block format, static 2 KB hash table).
+// Frames that do not shrink enough are sent as-is; a flow that keeps
+// failing is skipped for an exponentially growing number of frames.
+
+typedef struct {
+    uint32_t frames;          // frames offered to the compressor
+    uint32_t compressed;      // sent with WB_F_COMP
+    uint32_t bypass_small;    // below CONFIG_WB_COMP_MIN
+    uint32_t bypass_flow;     // flow in back-off after failed tries
+    uint32_t bypass_fail;     // tried, saved too little
+    uint32_t bytes_in;        // compressed frames: bytes before
+    uint32_t bytes_out;       //                    bytes after
+    uint32_t tried_bytes;     // bytes run through the compressor (incl. failed)
+    uint32_t cycles;          // CPU cycles spent compressing (incl. failed)
+    uint32_t rx_frames;       // frames decompressed
+    uint32_t rx_errors;       // corrupt compressed frames (dropped)
+} wb_comp_stats_t;
+
+// TX (udp_tx_task). flow() classifies the plain frame before other codecs
+// run; encode() compresses f in place, true = set WB_F_COMP.
+uint8_t wb_comp_flow(const uint8_t *frame, uint16_t len);
+bool    wb_comp_encode(uint8_t flow, uint8_t *f, uint16_t *len);
+
+// RX: decompress into out (WB_MAX_FRAME bytes), NULL = corrupt
+const uint8_t *wb_comp_decode(const uint8_t *in, uint16_t *len, uint8_t *out);
+
+// ratio = bytes_out / bytes_in, CPU per byte = cycles / tried_bytes,
+// bypass rate = (frames - compressed) / frames
+void wb_comp_get_stats(wb_comp_stats_t *out);
@@ -0,0 +1,311 @@
+// crypt.c — AEAD sealing of tunnel datagrams, per-peer anti-replay windows
+#include "crypt.h"
+#include "bridge_cfg.h"
+
+#if CONFIG_WB_CRYPT
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_random.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#if CONFIG_WB_CRYPT_CHACHAPOLY
+#include "mbedtls/chachapoly.h"
+#else
+#include "mbedtls/gcm.h"
+#endif
+
+static const char *TAG = "wb_crypt";
+
+#define WB_CRYPT_NVS_NS    "wb_crypt"
+#define WB_CRYPT_NVS_KEY   "key"
+#define WB_CRYPT_NVS_BOOT  "boot"
+#define WB_CRYPT_SEQ_BITS  40           // datagrams per boot; the rest is the boot count
+#define WB_CRYPT_NONCE_OFF 4            // salt + seq in wb_sec_hdr_t
+
+// Our tunnel address byte, the top of the salt: both ends seal under the
+// same key, so their nonces must differ by more than chance, and a
+// datagram of ours sent back to us is told from the peer's
+#if CONFIG_WB_ROLE_AP
+#define WB_CRYPT_NODE WB_IP_AP_LAST
+#else
+#define WB_CRYPT_NODE WB_IP_STA_LAST
+#endif
+
+_Static_assert(sizeof(wb_sec_hdr_t) - WB_CRYPT_NONCE_OFF == 12, "96-bit nonce");
+
+#if CONFIG_WB_CRYPT_CHACHAPOLY
+#define WB_SEC_ALG WB_SEC_CHACHAPOLY
+#define WB_ALG_NAME "ChaCha20-Poly1305"
+typedef mbedtls_chachapoly_context aead_t;
+#else
+#define WB_SEC_ALG WB_SEC_AES_GCM
+#define WB_ALG_NAME "AES-256-GCM"
+typedef mbedtls_gcm_context aead_t;
+#endif
+
+// One context per direction: udp_tx_task and the RX context run concurrently
+static aead_t s_tx_ctx, s_rx_ctx;
+static bool s_ready = false;
+static uint32_t s_salt;
+static uint64_t s_seq;                  // udp_tx_task
+
+static wb_crypt_stats_t s_st;
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int aead_setkey(aead_t *c, const uint8_t *key)
+{
+#if CONFIG_WB_CRYPT_CHACHAPOLY
+    mbedtls_chachapoly_init(c);
+    return mbedtls_chachapoly_setkey(c, key);
+#else
+    mbedtls_gcm_init(c);
+    return mbedtls_gcm_setkey(c, MBEDTLS_CIPHER_ID_AES, key, WB_CRYPT_KEY_LEN * 8);
+#endif
+}
+
+// In place; tag written after the ciphertext
+static int aead_seal(aead_t *c, const uint8_t *hdr, uint8_t *buf, size_t len)
+{
+    const uint8_t *nonce = hdr + WB_CRYPT_NONCE_OFF;
+#if CONFIG_WB_CRYPT_CHACHAPOLY
+    return mbedtls_chachapoly_encrypt_and_tag(c, len, nonce, hdr, sizeof(wb_sec_hdr_t),
+                                              buf, buf, buf + len);
+#else
+    return mbedtls_gcm_crypt_and_tag(c, MBEDTLS_GCM_ENCRYPT, len, nonce, 12, hdr, sizeof(wb_sec_hdr_t),
+                                     buf, buf, WB_SEC_TAG_LEN, buf + len);
+#endif
+}
+
+static int aead_open(aead_t *c, const uint8_t *hdr, const uint8_t *in, size_t len, uint8_t *out)
+{
+    const uint8_t *nonce = hdr + WB_CRYPT_NONCE_OFF;
+#if CONFIG_WB_CRYPT_CHACHAPOLY
+    return mbedtls_chachapoly_auth_decrypt(c, len, nonce, hdr, sizeof(wb_sec_hdr_t),
+                                           in + len, in, out);
+#else
+    return mbedtls_gcm_auth_decrypt(c, len, nonce, 12, hdr, sizeof(wb_sec_hdr_t),
+                                    in + len, WB_SEC_TAG_LEN, in, out);
+#endif
+}
+
+// ---- anti-replay window ----
+
+static bool win_check(const wb_crypt_win_t *w, uint64_t seq)
+{
+    if (seq == 0) return false;
+    if (seq > w->top) return true;
+
+    uint64_t d = w->top - seq;
+    if (d >= WB_CRYPT_WINDOW) return false;
+    return !(w->bits[d / 32] & (1u << (d % 32)));
+}
+
+// bit i -> bit i + s, 0 < s < WB_CRYPT_WINDOW
+static void win_shift(wb_crypt_win_t *w, unsigned s)
+{
+    const int nw = WB_CRYPT_WINDOW / 32;
+    unsigned ws = s / 32, bs = s % 32;
+
+    for (int i = nw - 1; i >= 0; i--) {
+        int j = i - (int)ws;
+        uint32_t v = 0;
+        if (j >= 0) {
+            v = w->bits[j] << bs;
+            if (bs && j > 0) v |= w->bits[j - 1] >> (32 - bs);
+        }
+        w->bits[i] = v;
+    }
+}
+
+static void win_update(wb_crypt_win_t *w, uint64_t seq)
+{
+    if (seq > w->top) {
+        uint64_t s = seq - w->top;
+        if (w->top == 0 || s >= WB_CRYPT_WINDOW) memset(w->bits, 0, sizeof(w->bits));
+        else win_shift(w, (unsigned)s);
+        w->top = seq;
+        w->bits[0] |= 1;
+    } else {
+        uint64_t d = w->top - seq;
+        w->bits[d / 32] |= 1u << (d % 32);
+    }
+}
+
+// ---- datagrams ----
+
+int wb_crypt_seal(const wb_seg_t *seg, int nseg, uint8_t *out, int cap)
+{
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) n += seg[i].len;
+    if (!s_ready || (int)(n + WB_SEC_OVERHEAD) > cap) return 0;
+
+    wb_sec_hdr_t h = {
+        .magic = WB_MAGIC_SEC,
+        .ver = WB_VER,
+        .alg = WB_SEC_ALG,
+        .salt = s_salt,
+        .seq = ++s_seq,
+    };
+    memcpy(out, &h, sizeof(h));
+
+    uint8_t *body = out + sizeof(h), *o = body;
+    for (int i = 0; i < nseg; i++) {
+        memcpy(o, seg[i].p, seg[i].len);
+        o += seg[i].len;
+    }
+
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    int rc = aead_seal(&s_tx_ctx, out, body, n);
+    uint32_t dc = esp_cpu_get_cycle_count() - c0;
+    if (rc != 0) return 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    s_st.sealed++;
+    s_st.seal_cycles += dc;
+    s_st.seal_bytes += n;
+    taskEXIT_CRITICAL(&s_lock);
+    return (int)(n + WB_SEC_OVERHEAD);
+}
+
+// The sender named in the salt: the expected peer, never us. wb_bench
+// replays its own datagrams (WB_CRYPT_LOOPBACK).
+static bool node_ok(uint32_t salt, uint8_t peer)
+{
+    uint8_t node = (uint8_t)(salt >> 24);
+#if WB_CRYPT_LOOPBACK
+    (void)peer;
+    return node == WB_CRYPT_NODE;
+#else
+    return node == peer && node != WB_CRYPT_NODE;
+#endif
+}
+
+int wb_crypt_open(wb_crypt_win_t *win, uint8_t peer, const uint8_t *in, int n, uint8_t *out, int cap)
+{
+    uint16_t magic = 0;
+    if (n >= (int)sizeof(magic)) memcpy(&magic, in, sizeof(magic));
+
+    wb_sec_hdr_t h;
+    uint32_t *err = NULL;
+    if (magic != WB_MAGIC_SEC) {
+        err = &s_st.rx_plain;
+    } else if (n < (int)WB_SEC_OVERHEAD || n - (int)WB_SEC_OVERHEAD > cap) {
+        err = &s_st.rx_bad;
+    } else {
+        memcpy(&h, in, sizeof(h));
+        if (h.ver != WB_VER || h.alg != WB_SEC_ALG || !node_ok(h.salt, peer)) err = &s_st.rx_bad;
+        else if (!win_check(win, h.seq)) err = &s_st.rx_replay;
+    }
+    if (err) {
+        taskENTER_CRITICAL(&s_lock);
+        (*err)++;
+        taskEXIT_CRITICAL(&s_lock);
+        return -1;
+    }
+
+    // window moves only for datagrams that authenticate
+    int len = n - (int)WB_SEC_OVERHEAD;
+    uint32_t c0 = esp_cpu_get_cycle_count();
+    int rc = aead_open(&s_rx_ctx, in, in + sizeof(h), (size_t)len, out);
+    uint32_t dc = esp_cpu_get_cycle_count() - c0;
+    if (rc == 0) win_update(win, h.seq);
+
+    taskENTER_CRITICAL(&s_lock);
+    if (rc == 0) s_st.opened++;
+    else s_st.rx_bad++;
+    s_st.open_cycles += dc;
+    s_st.open_bytes += (uint32_t)len;
+    taskEXIT_CRITICAL(&s_lock);
+    return rc == 0 ? len : -1;
+}
+
+// ---- key and boot counter ----
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+bool wb_crypt_parse_key(const char *s, uint8_t key[WB_CRYPT_KEY_LEN])
+{
+    if (strlen(s) != WB_CRYPT_KEY_LEN * 2) return false;
+    for (int i = 0; i < WB_CRYPT_KEY_LEN; i++) {
+        int hi = hex_val(s[2 * i]), lo = hex_val(s[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        key[i] = (uint8_t)(hi << 4 | lo);
+    }
+    return true;
+}
+
+// The contexts are keyed once, at start
+esp_err_t wb_crypt_save_key(const uint8_t key[WB_CRYPT_KEY_LEN])
+{
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WB_CRYPT_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, WB_CRYPT_NVS_KEY, key, WB_CRYPT_KEY_LEN);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+bool wb_crypt_init(void)
+{
+    uint8_t key[WB_CRYPT_KEY_LEN];
+    bool have = false;
+    uint32_t boot = 0;
+
+    nvs_handle_t h;
+    if (nvs_open(WB_CRYPT_NVS_NS, NVS_READWRITE, &h) == ESP_OK) {
+        size_t n = sizeof(key);
+        have = nvs_get_blob(h, WB_CRYPT_NVS_KEY, key, &n) == ESP_OK && n == sizeof(key);
+        (void)nvs_get_u32(h, WB_CRYPT_NVS_BOOT, &boot);
+        boot++;
+        if (nvs_set_u32(h, WB_CRYPT_NVS_BOOT, boot) != ESP_OK || nvs_commit(h) != ESP_OK) {
+            ESP_LOGW(TAG, "boot counter not saved: peer may drop our datagrams after a restart");
+        }
+        nvs_close(h);
+    } else {
+        ESP_LOGW(TAG, "NVS unavailable: no boot counter");
+    }
+
+    const char *src = "NVS";
+    if (!have) {
+        have = wb_crypt_parse_key(CONFIG_WB_CRYPT_KEY, key);
+        src = "Kconfig";
+    }
+    if (!have) {
+        ESP_LOGE(TAG, "no key: set WB_CRYPT_KEY (64 hex digits) or save one to NVS");
+        return false;
+    }
+
+    bool ok = aead_setkey(&s_tx_ctx, key) == 0 && aead_setkey(&s_rx_ctx, key) == 0;
+    memset(key, 0, sizeof(key));
+    if (!ok) {
+        ESP_LOGE(TAG, "%s key setup failed", WB_ALG_NAME);
+        return false;
+    }
+
+    s_salt = (uint32_t)WB_CRYPT_NODE << 24 | (esp_random() & 0xFFFFFF);
+    s_seq = (uint64_t)(boot & 0xFFFFFF) << WB_CRYPT_SEQ_BITS;
+    s_ready = true;
+
+    ESP_LOGI(TAG, "%s, key from %s, boot %lu", WB_ALG_NAME, src, (unsigned long)boot);
+    return true;
+}
+
+void wb_crypt_get_stats(wb_crypt_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+#endif // CONFIG_WB_CRYPT
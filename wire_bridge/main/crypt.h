@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "wb_proto.h"
+#include "transport.h"
+
+// Tunnel encryption (CONFIG_WB_CRYPT): every datagram is sealed with an
+// AEAD under a 256-bit pre-shared key, AES-256-GCM (ESP32 AES engine via
+// mbedTLS) or ChaCha20-Poly1305. Each peer has a sliding anti-replay
+// window over the sender's 64-bit datagram number; the high bits are a
+// boot counter kept in NVS ("wb_crypt"), so numbers keep rising across
+// restarts. The salt carries the sender's node: a datagram is opened only
+// against the window of the peer it names, so ours reflected back or a
+// spoke's replayed from another address never reach a window. Datagrams
+// that are not sealed, fail the tag or are replayed are dropped before
+// the tunnel looks at them.
+
+#define WB_CRYPT_KEY_LEN  32
+#define WB_CRYPT_WINDOW   128      // datagrams a late one may trail the newest
+
+// Per-peer receive state
+typedef struct {
+    uint64_t top;                              // newest accepted, 0 = none
+    uint32_t bits[WB_CRYPT_WINDOW / 32];       // bit i: top - i accepted
+} wb_crypt_win_t;
+
+typedef struct {
+    uint32_t sealed;
+    uint32_t opened;
+    uint32_t rx_plain;       // unsealed datagrams dropped
+    uint32_t rx_bad;         // wrong algorithm or sender, short, or tag mismatch
+    uint32_t rx_replay;      // already seen or older than the window
+    uint64_t seal_cycles;    // CPU cycles in seal / open, for cost per byte
+    uint64_t seal_bytes;
+    uint64_t open_cycles;
+    uint64_t open_bytes;
+} wb_crypt_stats_t;
+
+// Key from NVS, else CONFIG_WB_CRYPT_KEY (64 hex digits); false = no key
+bool wb_crypt_init(void);
+
+// Save a key to NVS; used from the next start (both ends must match)
+esp_err_t wb_crypt_save_key(const uint8_t key[WB_CRYPT_KEY_LEN]);
+
+// 64 hex digits -> key; false = malformed
+bool wb_crypt_parse_key(const char *hex, uint8_t key[WB_CRYPT_KEY_LEN]);
+
+// udp_tx_task: seg[] as one sealed datagram into out (WB_SEC_OVERHEAD +
+// payload bytes); returns its length, 0 = does not fit in cap
+int wb_crypt_seal(const wb_seg_t *seg, int nseg, uint8_t *out, int cap);
+
+// Transport RX context: plain datagram into out (n - WB_SEC_OVERHEAD
+// bytes, at most cap), -1 = drop. peer = node win belongs to; a salt
+// naming another node is dropped before the AEAD. Updates win only for
+// authentic datagrams.
+int wb_crypt_open(wb_crypt_win_t *win, uint8_t peer, const uint8_t *in, int n, uint8_t *out, int cap);
+
+void wb_crypt_get_stats(wb_crypt_stats_t *out);
@@ -1,4 +1,7 @@
 #include "display_status.h"
+#include "task_topo.h"
+#include "wb_stats.h"
+#include "capture.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -84,11 +87,11 @@ static lv_disp_t               * s_disp = NULL;
 static status_t s_last = {0};
 
 // Baseline counters
-static uint32_t s_base_tx = 0, s_base_rx = 0, s_base_drop = 0;
+static uint64_t s_base_tx = 0, s_base_rx = 0, s_base_drop = 0;
 
 // Rates
 static int64_t  s_prev_us = 0;
-static uint32_t s_prev_tx = 0, s_prev_rx = 0;
+static uint64_t s_prev_tx = 0, s_prev_rx = 0;
 static float    s_rate_tx_pps = 0.0f;
 static float    s_rate_rx_pps = 0.0f;
 
@@ -107,18 +110,28 @@ typedef enum {
     SCR_STATUS,
     SCR_TRAFFIC,
     SCR_NETWORK,
+    SCR_LATENCY,
+    SCR_CAPTURE,
     SCR_SYSTEM,
     SCR_ABOUT,
 } screen_t;
 
 static screen_t s_screen = SCR_MENU;
 static int s_traffic_view = 0;
+#if CONFIG_WB_LP
+#define TRAFFIC_VIEWS 3     // rates, totals, link probes
+#else
+#define TRAFFIC_VIEWS 2
+#endif
+static int s_lat_view = WB_LAT_TX_TOTAL;   // stage on the latency screen
 
 typedef struct { const char *name; screen_t screen; } menu_item_t;
 static const menu_item_t s_main_menu[] = {
     { "Status",  SCR_STATUS  },
     { "Traffic", SCR_TRAFFIC },
     { "Network", SCR_NETWORK },
+    { "Latency", SCR_LATENCY },
+    { "Capture", SCR_CAPTURE },
     { "System",  SCR_SYSTEM  },
     { "About",   SCR_ABOUT   },
 };
@@ -189,7 +202,10 @@ static lv_obj_t *g_menu_lbl[MENU_VISIBLE] = {0};
 typedef struct {
     lv_obj_t *st_role, *st_ip, *st_rssi, *st_udp, *st_rate;
     lv_obj_t *tr_mode, *tr_rx, *tr_tx, *tr_drop;
+    lv_obj_t *tr_k_rx, *tr_k_tx, *tr_k_drop;   // keys change with the view
     lv_obj_t *nw_role, *nw_ssid, *nw_ip, *nw_rssi, *nw_wmac, *nw_emac;
+    lv_obj_t *la_stage, *la_mid, *la_tail, *la_max;
+    lv_obj_t *cp_state, *cp_frames, *cp_file, *cp_ring;
     lv_obj_t *sy_uptime, *sy_heap, *sy_temp;
     lv_obj_t *ab_dev, *ab_bridge, *ab_build;
 } ui_widgets_t;
@@ -296,8 +312,8 @@ static void update_rates(void)
     if (dt_us < 300000) return;
 
     float dt_s = (float)dt_us / 1000000.0f;
-    uint32_t dtx = s_last.udp_tx - s_prev_tx;
-    uint32_t drx = s_last.udp_rx - s_prev_rx;
+    uint64_t dtx = s_last.udp_tx - s_prev_tx;
+    uint64_t drx = s_last.udp_rx - s_prev_rx;
 
     s_rate_tx_pps = (dt_s > 0) ? ((float)dtx / dt_s) : 0.0f;
     s_rate_rx_pps = (dt_s > 0) ? ((float)drx / dt_s) : 0.0f;
@@ -455,7 +471,7 @@ static void header_update(void)
     lv_label_set_text(g_hdr_W, "W");
     lv_obj_set_style_text_color(g_hdr_W, s_last.wifi_up ? C_GREEN() : C_RED(), 0);
 
-    uint32_t dr = s_last.udp_drop - s_base_drop;
+    uint64_t dr = s_last.udp_drop - s_base_drop;
     lv_label_set_text(g_hdr_U, "U");
     lv_obj_set_style_text_color(g_hdr_U, (dr > 0) ? C_YELLOW() : C_GREY(), 0);
 }
@@ -581,9 +597,9 @@ static void build_traffic(void)
     lv_obj_set_style_pad_row(g_body, 4, 0);
 
     kv_pill_create(g_body, "Mode", &W.tr_mode);
-    kv_pill_create(g_body, "RX",   &W.tr_rx);
-    kv_pill_create(g_body, "TX",   &W.tr_tx);
-    kv_pill_create(g_body, "Drop", &W.tr_drop);
+    W.tr_k_rx   = lv_obj_get_child(kv_pill_create(g_body, "RX",   &W.tr_rx), 0);
+    W.tr_k_tx   = lv_obj_get_child(kv_pill_create(g_body, "TX",   &W.tr_tx), 0);
+    W.tr_k_drop = lv_obj_get_child(kv_pill_create(g_body, "Drop", &W.tr_drop), 0);
 }
 
 static void build_network(void)
@@ -602,6 +618,34 @@ static void build_network(void)
     kv_pill_create(g_body, "ETH MAC",  &W.nw_emac);
 }
 
+static void build_latency(void)
+{
+    set_title("Latency");
+    set_footer("UP/DOWN stage    ENTER back");
+
+    lv_obj_set_flex_flow(g_body, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(g_body, 4, 0);
+
+    kv_pill_create(g_body, "Stage",   &W.la_stage);
+    kv_pill_create(g_body, "p50/p99", &W.la_mid);
+    kv_pill_create(g_body, "p99.9",   &W.la_tail);
+    kv_pill_create(g_body, "Max",     &W.la_max);
+}
+
+static void build_capture(void)
+{
+    set_title("Capture");
+    set_footer("UP arm/trigger  DOWN stop");
+
+    lv_obj_set_flex_flow(g_body, LV_FLEX_FLOW_COLUMN);
+    lv_obj_set_style_pad_row(g_body, 4, 0);
+
+    kv_pill_create(g_body, "State",  &W.cp_state);
+    kv_pill_create(g_body, "Kept",   &W.cp_frames);
+    kv_pill_create(g_body, "File",   &W.cp_file);
+    kv_pill_create(g_body, "Ring",   &W.cp_ring);
+}
+
 static void build_system(void)
 {
     set_title("System");
@@ -645,12 +689,13 @@ static void update_status_values(void)
     else snprintf(rssi_s, sizeof(rssi_s), "N/A");
     label_set_text_if_changed(W.st_rssi, rssi_s);
 
-    uint32_t tx = s_last.udp_tx - s_base_tx;
-    uint32_t rx = s_last.udp_rx - s_base_rx;
-    uint32_t dr = s_last.udp_drop - s_base_drop;
+    uint64_t tx = s_last.udp_tx - s_base_tx;
+    uint64_t rx = s_last.udp_rx - s_base_rx;
+    uint64_t dr = s_last.udp_drop - s_base_drop;
 
-    char udp[48];
-    snprintf(udp, sizeof(udp), "TX %u  RX %u  D %u", (unsigned)tx, (unsigned)rx, (unsigned)dr);
+    char udp[72];
+    snprintf(udp, sizeof(udp), "TX %llu  RX %llu  D %llu",
+             (unsigned long long)tx, (unsigned long long)rx, (unsigned long long)dr);
     label_set_text_if_changed(W.st_udp, udp);
 
     char rate[48];
@@ -662,9 +707,39 @@ static void update_traffic_values(void)
 {
     if (!W.tr_mode) return;
 
-    uint32_t tx = s_last.udp_tx - s_base_tx;
-    uint32_t rx = s_last.udp_rx - s_base_rx;
-    uint32_t dr = s_last.udp_drop - s_base_drop;
+    uint64_t tx = s_last.udp_tx - s_base_tx;
+    uint64_t rx = s_last.udp_rx - s_base_rx;
+    uint64_t dr = s_last.udp_drop - s_base_drop;
+
+#if CONFIG_WB_LP
+    if (s_traffic_view == 2) {
+        label_set_text_if_changed(W.tr_mode, "Link probes");
+        label_set_text_if_changed(W.tr_k_rx, "RTT");
+        label_set_text_if_changed(W.tr_k_tx, "Loss");
+        label_set_text_if_changed(W.tr_k_drop, "Jitter");
+
+        char a[32], b[32], c[32];
+        if (s_last.link_ok) {
+            snprintf(a, sizeof(a), "%.1f / %.1f ms",
+                     (double)s_last.rtt_p50_us / 1000.0, (double)s_last.rtt_p99_us / 1000.0);
+        } else {
+            snprintf(a, sizeof(a), "no echo");
+        }
+        snprintf(b, sizeof(b), "rx %.1f%%  tx %.1f%%",
+                 (double)s_last.loss_rx_pm / 10.0, (double)s_last.loss_tx_pm / 10.0);
+        snprintf(c, sizeof(c), "%.1f ms  R %u",
+                 (double)s_last.jitter_us / 1000.0, (unsigned)s_last.reordered);
+
+        label_set_text_if_changed(W.tr_rx, a);
+        label_set_text_if_changed(W.tr_tx, b);
+        label_set_text_if_changed(W.tr_drop, c);
+        return;
+    }
+#endif
+
+    label_set_text_if_changed(W.tr_k_rx, "RX");
+    label_set_text_if_changed(W.tr_k_tx, "TX");
+    label_set_text_if_changed(W.tr_k_drop, "Drop");
 
     if (s_traffic_view == 0) {
         label_set_text_if_changed(W.tr_mode, "Rates (pkt/s)");
@@ -672,7 +747,7 @@ static void update_traffic_values(void)
         char a[24], b[24], c[24];
         snprintf(a, sizeof(a), "%.1f", (double)s_rate_rx_pps);
         snprintf(b, sizeof(b), "%.1f", (double)s_rate_tx_pps);
-        snprintf(c, sizeof(c), "%u", (unsigned)dr);
+        snprintf(c, sizeof(c), "%llu", (unsigned long long)dr);
 
         label_set_text_if_changed(W.tr_rx, a);
         label_set_text_if_changed(W.tr_tx, b);
@@ -681,9 +756,9 @@ static void update_traffic_values(void)
         label_set_text_if_changed(W.tr_mode, "Totals (since reset)");
 
         char a[24], b[24], c[24];
-        snprintf(a, sizeof(a), "%u", (unsigned)rx);
-        snprintf(b, sizeof(b), "%u", (unsigned)tx);
-        snprintf(c, sizeof(c), "%u", (unsigned)dr);
+        snprintf(a, sizeof(a), "%llu", (unsigned long long)rx);
+        snprintf(b, sizeof(b), "%llu", (unsigned long long)tx);
+        snprintf(c, sizeof(c), "%llu", (unsigned long long)dr);
 
         label_set_text_if_changed(W.tr_rx, a);
         label_set_text_if_changed(W.tr_tx, b);
@@ -725,6 +800,77 @@ static void update_network_values(void)
     label_set_text_if_changed(W.nw_emac, emac_s);
 }
 
+// Whole microseconds up to 10 ms, then milliseconds
+static void fmt_us(char *out, size_t n, uint32_t us)
+{
+    if (us < 10000) snprintf(out, n, "%u us", (unsigned)us);
+    else snprintf(out, n, "%.1f ms", (double)us / 1000.0);
+}
+
+static void update_latency_values(void)
+{
+    if (!W.la_stage) return;
+
+#if CONFIG_WB_LAT
+    wb_lat_pct_t p;
+    wb_stats_lat_get((wb_lat_t)s_lat_view, &p);
+
+    char st[40], a[16], b[16], mid[40], tail[16], mx[16];
+    snprintf(st, sizeof(st), "%s  n %u", wb_stats_lat_name((wb_lat_t)s_lat_view), (unsigned)p.n);
+    fmt_us(a, sizeof(a), p.p50_us);
+    fmt_us(b, sizeof(b), p.p99_us);
+    snprintf(mid, sizeof(mid), "%s / %s", a, b);
+    fmt_us(tail, sizeof(tail), p.p999_us);
+    fmt_us(mx, sizeof(mx), p.max_us);
+
+    label_set_text_if_changed(W.la_stage, st);
+    label_set_text_if_changed(W.la_mid, mid);
+    label_set_text_if_changed(W.la_tail, tail);
+    label_set_text_if_changed(W.la_max, mx);
+#else
+    label_set_text_if_changed(W.la_stage, "off (WB_LAT)");
+    label_set_text_if_changed(W.la_mid, "N/A");
+    label_set_text_if_changed(W.la_tail, "N/A");
+    label_set_text_if_changed(W.la_max, "N/A");
+#endif
+}
+
+static void update_capture_values(void)
+{
+    if (!W.cp_state) return;
+
+#if CONFIG_WB_CAP
+    wb_cap_stats_t cs;
+    wb_cap_get_stats(&cs);
+    wb_stats_t st;
+    wb_stats_snapshot(&st);
+
+    static const char *const k_state[] = { "off", "armed", "triggered" };
+    char state[32], frames[40], file[40], ring[32];
+    snprintf(state, sizeof(state), "%s%s", k_state[cs.state], cs.stopping ? ", writing" : "");
+    snprintf(frames, sizeof(frames), "%llu  lost %llu",
+             (unsigned long long)st.c[WB_CTR_CAP_FRAMES], (unsigned long long)st.c[WB_CTR_CAP_LOST]);
+    snprintf(file, sizeof(file), "%s  %lu KB", cs.file[0] ? cs.file : "-", (unsigned long)(cs.bytes / 1024));
+    // no ring before the first arm
+    if (cs.ring_size) {
+        snprintf(ring, sizeof(ring), "%lu%%  err %lu", (unsigned long)(100ull * cs.ring_used / cs.ring_size),
+                 (unsigned long)cs.write_errors);
+    } else {
+        snprintf(ring, sizeof(ring), "-  err %lu", (unsigned long)cs.write_errors);
+    }
+
+    label_set_text_if_changed(W.cp_state, state);
+    label_set_text_if_changed(W.cp_frames, frames);
+    label_set_text_if_changed(W.cp_file, file);
+    label_set_text_if_changed(W.cp_ring, ring);
+#else
+    label_set_text_if_changed(W.cp_state, "off (WB_CAP)");
+    label_set_text_if_changed(W.cp_frames, "N/A");
+    label_set_text_if_changed(W.cp_file, "N/A");
+    label_set_text_if_changed(W.cp_ring, "N/A");
+#endif
+}
+
 static void update_system_values(void)
 {
     if (!W.sy_uptime) return;
@@ -769,6 +915,8 @@ static void update_active_screen_values(void)
         case SCR_STATUS:  update_status_values(); break;
         case SCR_TRAFFIC: update_traffic_values(); break;
         case SCR_NETWORK: update_network_values(); break;
+        case SCR_LATENCY: update_latency_values(); break;
+        case SCR_CAPTURE: update_capture_values(); break;
         case SCR_SYSTEM:  update_system_values(); break;
         case SCR_ABOUT:   update_about_values(); break;
         case SCR_MENU:    refresh_menu(); break;
@@ -789,6 +937,8 @@ static void build_for_screen(screen_t scr)
         case SCR_STATUS:  build_status(); break;
         case SCR_TRAFFIC: build_traffic(); break;
         case SCR_NETWORK: build_network(); break;
+        case SCR_LATENCY: build_latency(); break;
+        case SCR_CAPTURE: build_capture(); break;
         case SCR_SYSTEM:  build_system(); break;
         case SCR_ABOUT:   build_about(); break;
         default:          build_menu(); break;
@@ -921,8 +1071,19 @@ void ui_menu_up(void)
         s_menu_index = wrap_index(s_menu_index - 1, s_main_menu_count);
         refresh_menu();
     } else if (s_screen == SCR_TRAFFIC) {
-        s_traffic_view = (s_traffic_view + 1) % 2;
+        s_traffic_view = (s_traffic_view + TRAFFIC_VIEWS - 1) % TRAFFIC_VIEWS;
         update_traffic_values();
+    } else if (s_screen == SCR_LATENCY) {
+        s_lat_view = (s_lat_view + WB_LAT_N - 1) % WB_LAT_N;
+        update_latency_values();
+    } else if (s_screen == SCR_CAPTURE) {
+#if CONFIG_WB_CAP
+        wb_cap_stats_t cs;
+        wb_cap_get_stats(&cs);
+        if (cs.state == WB_CAP_ARMED) wb_cap_trigger();
+        else if (cs.state == WB_CAP_OFF && !cs.stopping) wb_cap_arm(NULL);
+#endif
+        update_capture_values();
     }
 
     lvgl_port_unlock();
@@ -937,8 +1098,16 @@ void ui_menu_down(void)
         s_menu_index = wrap_index(s_menu_index + 1, s_main_menu_count);
         refresh_menu();
     } else if (s_screen == SCR_TRAFFIC) {
-        s_traffic_view = (s_traffic_view + 1) % 2;
+        s_traffic_view = (s_traffic_view + 1) % TRAFFIC_VIEWS;
         update_traffic_values();
+    } else if (s_screen == SCR_LATENCY) {
+        s_lat_view = (s_lat_view + 1) % WB_LAT_N;
+        update_latency_values();
+    } else if (s_screen == SCR_CAPTURE) {
+#if CONFIG_WB_CAP
+        wb_cap_stop();
+#endif
+        update_capture_values();
     }
 
     lvgl_port_unlock();
@@ -999,8 +1168,13 @@ void display_init(void)
     ESP_ERROR_CHECK(esp_lcd_panel_set_gap(s_panel, WB_LCD_X_GAP, WB_LCD_Y_GAP));
     ESP_ERROR_CHECK(esp_lcd_panel_disp_on_off(s_panel, true));
 
-    const lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    const wb_stage_cfg_t *tc = wb_topo_get(WB_STAGE_UI);
+    lvgl_port_cfg_t lvgl_cfg = ESP_LVGL_PORT_INIT_CONFIG();
+    lvgl_cfg.task_priority = tc->prio;
+    lvgl_cfg.task_stack = tc->stack;
+    lvgl_cfg.task_affinity = tc->core;
     ESP_ERROR_CHECK(lvgl_port_init(&lvgl_cfg));
+    wb_topo_adopt(WB_STAGE_UI, NULL);
 
     const lvgl_port_display_cfg_t disp_cfg = {
         .io_handle = s_io,
@@ -1032,6 +1206,7 @@ void display_init(void)
     s_screen = SCR_MENU;
     s_menu_index = 0;
     s_traffic_view = 0;
+    s_lat_view = WB_LAT_TX_TOTAL;
     s_base_tx = s_base_rx = s_base_drop = 0;
     s_prev_us = 0;
     s_cpu_temp_valid = false;
@@ -6,9 +6,18 @@ typedef struct {
     bool eth_link;
     bool wifi_up;
     int  rssi;          // dBm; jei nėra - 0
-    uint32_t udp_tx;
-    uint32_t udp_rx;
-    uint32_t udp_drop;
+    uint64_t udp_tx;    // datagrams, wb_stats.h counters
+    uint64_t udp_rx;
+    uint64_t udp_drop;
+
+    // link probes; link_ok = an echo within the last WB_LP_DOWN_PINGS intervals
+    bool     link_ok;
+    uint32_t rtt_p50_us;
+    uint32_t rtt_p99_us;
+    uint32_t jitter_us;
+    uint16_t loss_rx_pm;   // peer -> us, per mille
+    uint16_t loss_tx_pm;   // us -> peer, per mille
+    uint32_t reordered;
 } status_t;
 
 void display_init(void);
@@ -0,0 +1,300 @@
+// dmx_delta.c — protocol-aware delta coding of DMX universes
+//
+// Stream = (protocol, universe, source IP). First byte of a coded frame:
+// [7] keyframe, [6:0] stream id; second byte: keyframe generation.
+//   keyframe: [id|K][gen][full Ethernet frame]
+//   delta:    [id][gen]{[u16 off][u8 n][n bytes]}...
+// Deltas are against the keyframe, not the previous frame. A keyframe is
+// sent for a new stream, after CONFIG_WB_DMX_KEY_MS, when the frame
+// length changes, when the delta grows past 1/4 of the frame, or when
+// the peer asks for one.
+
+#include "dmx_delta.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WB_DMX_DELTA
+
+#define WB_DMX_STREAMS   CONFIG_WB_DMX_STREAMS
+#define WB_DMX_KEY_US    ((int64_t)CONFIG_WB_DMX_KEY_MS * 1000)
+#define WB_DMX_REF_MAX   700       // sACN: 14 + 20 + 8 + 638
+#define WB_DMX_GAP       3         // equal bytes that end a run (= run header size)
+
+#define DMX_K            0x80
+
+_Static_assert(WB_DMX_STREAMS <= 32, "keyframe request mask is 32 bits");
+
+typedef struct {
+    bool     used;
+    uint8_t  gen;
+    uint16_t len;
+    uint32_t src_ip;
+    uint32_t last_use;
+    int64_t  t_key_us;
+    uint8_t  ref[WB_DMX_REF_MAX];
+    wb_dmx_stream_stats_t st;
+} dmx_tx_t;
+
+typedef struct {
+    bool     valid;
+    uint8_t  gen;
+    uint16_t len;
+    uint8_t  ref[WB_DMX_REF_MAX];
+} dmx_rx_t;
+
+static dmx_tx_t s_tx[WB_DMX_STREAMS];
+static dmx_rx_t s_rx[WB_DMX_STREAMS];
+static uint8_t  s_delta[WB_DMX_REF_MAX];
+static uint32_t s_use_clock = 0;
+
+static volatile uint32_t s_key_req = 0;   // peer asked for keyframes
+static volatile uint32_t s_want = 0;      // we need keyframes from the peer
+static wb_dmx_stats_t s_st;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint8_t s_acn_id[12] = { 'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0 };
+static const uint8_t s_artnet_id[8] = { 'A', 'r', 't', '-', 'N', 'e', 't', 0 };
+
+// IPv4/UDP sACN data packet or ArtDmx, optionally VLAN tagged
+static bool dmx_parse(const uint8_t *f, uint16_t len, uint8_t *proto, uint16_t *uni, uint32_t *src)
+{
+    if (len < 14 + 20 + 8 || len > WB_DMX_REF_MAX) return false;
+
+    uint16_t et = (uint16_t)(f[12] << 8 | f[13]);
+    uint16_t l3 = 14;
+    if (et == 0x8100) {
+        et = (uint16_t)(f[16] << 8 | f[17]);
+        l3 = 18;
+    }
+    if (et != 0x0800) return false;
+
+    const uint8_t *ip = f + l3;
+    if (ip[9] != 17 || ((ip[6] & 0x3F) | ip[7])) return false;   // UDP, not fragmented
+
+    uint16_t l4 = (uint16_t)(l3 + (ip[0] & 0x0F) * 4);
+    if (len < l4 + 8) return false;
+
+    const uint8_t *p = f + l4 + 8;
+    uint16_t plen = (uint16_t)(len - l4 - 8);
+    uint16_t dport = (uint16_t)(f[l4 + 2] << 8 | f[l4 + 3]);
+
+    if (dport == 5568 && plen >= 126 && memcmp(p + 4, s_acn_id, sizeof(s_acn_id)) == 0) {
+        *proto = WB_DMX_PROTO_SACN;
+        *uni = (uint16_t)(p[113] << 8 | p[114]);
+    } else if (dport == 6454 && plen >= 18 && memcmp(p, s_artnet_id, sizeof(s_artnet_id)) == 0 &&
+               p[8] == 0x00 && p[9] == 0x50) {
+        *proto = WB_DMX_PROTO_ARTNET;
+        *uni = (uint16_t)(p[14] | p[15] << 8);
+    } else {
+        return false;
+    }
+
+    memcpy(src, ip + 12, 4);
+    return true;
+}
+
+static int tx_lookup(uint8_t proto, uint16_t uni, uint32_t src)
+{
+    int free_i = -1, lru = 0;
+    for (int i = 0; i < WB_DMX_STREAMS; i++) {
+        dmx_tx_t *c = &s_tx[i];
+        if (!c->used) {
+            if (free_i < 0) free_i = i;
+            continue;
+        }
+        if (c->st.proto == proto && c->st.universe == uni && c->src_ip == src) return i;
+        if (c->last_use < s_tx[lru].last_use) lru = i;
+    }
+
+    int i = (free_i >= 0) ? free_i : lru;
+    dmx_tx_t *c = &s_tx[i];
+    uint8_t gen = (uint8_t)(c->gen + 1);
+    memset(c, 0, sizeof(*c));
+    c->used = true;
+    c->gen = gen;
+    c->src_ip = src;
+    c->st.proto = proto;
+    c->st.universe = uni;
+    return i;
+}
+
+// Runs of bytes that differ from ref; -1 = does not fit in cap
+static int build_delta(const uint8_t *ref, const uint8_t *f, uint16_t len, uint8_t *out, uint16_t cap)
+{
+    uint16_t o = 0, i = 0;
+
+    while (i < len) {
+        if (f[i] == ref[i]) {
+            i++;
+            continue;
+        }
+
+        // one run absorbs short equal gaps; n stays <= 255
+        uint16_t start = i, end = (uint16_t)(i + 1);
+        for (uint16_t j = end; j < len && j - start < 255; j++) {
+            if (f[j] != ref[j]) end = (uint16_t)(j + 1);
+            else if (j - end >= WB_DMX_GAP) break;
+        }
+
+        uint16_t n = (uint16_t)(end - start);
+        if (o + 3 + n > cap) return -1;
+        out[o++] = (uint8_t)(start >> 8);
+        out[o++] = (uint8_t)start;
+        out[o++] = (uint8_t)n;
+        memcpy(out + o, f + start, n);
+        o = (uint16_t)(o + n);
+        i = end;
+    }
+    return o;
+}
+
+bool wb_dmx_encode(uint8_t **f, uint16_t *len)
+{
+    uint8_t *p = *f;
+    uint16_t n = *len;
+    uint8_t proto;
+    uint16_t uni;
+    uint32_t src;
+
+    if (!dmx_parse(p, n, &proto, &uni, &src)) return false;
+
+    int id = tx_lookup(proto, uni, src);
+    dmx_tx_t *c = &s_tx[id];
+    int64_t now = esp_timer_get_time();
+    uint32_t bit = 1u << id;
+
+    c->last_use = ++s_use_clock;
+    c->st.frames++;
+    c->st.bytes_in += n;
+
+    int dlen = -1;
+    bool key = c->len != n || (now - c->t_key_us) > WB_DMX_KEY_US || (s_key_req & bit);
+    if (!key) dlen = build_delta(c->ref, p, n, s_delta, (uint16_t)(n / 4));
+    if (dlen < 0) key = true;   // new keyframe, or too many changes for a delta
+
+    if (key) {
+        taskENTER_CRITICAL(&s_lock);
+        s_key_req &= ~bit;
+        taskEXIT_CRITICAL(&s_lock);
+
+        c->gen++;
+        c->len = n;
+        c->t_key_us = now;
+        memcpy(c->ref, p, n);
+        c->st.keyframes++;
+
+        // [id|K][gen][frame]
+        p -= 2;
+        p[0] = (uint8_t)(DMX_K | id);
+        p[1] = c->gen;
+        *len = (uint16_t)(n + 2);
+    } else {
+        // [id][gen][runs]: shorter than the frame, copy back in place
+        p[0] = (uint8_t)id;
+        p[1] = c->gen;
+        memcpy(p + 2, s_delta, (size_t)dlen);
+        *len = (uint16_t)(dlen + 2);
+    }
+
+    c->st.bytes_out += *len;
+    *f = p;
+    return true;
+}
+
+const uint8_t *wb_dmx_decode(const uint8_t *in, uint16_t *len, uint8_t *out)
+{
+    uint16_t n = *len;
+    if (n < 2) return NULL;
+
+    uint8_t id = in[0] & (uint8_t)~DMX_K;
+    if (id >= WB_DMX_STREAMS) return NULL;
+    dmx_rx_t *c = &s_rx[id];
+
+    if (in[0] & DMX_K) {
+        uint16_t flen = (uint16_t)(n - 2);
+        if (flen > WB_DMX_REF_MAX) return NULL;
+        c->valid = true;
+        c->gen = in[1];
+        c->len = flen;
+        memcpy(c->ref, in + 2, flen);
+        s_st.rx_frames++;
+        *len = flen;
+        return in + 2;
+    }
+
+    if (!c->valid || c->gen != in[1]) {
+        taskENTER_CRITICAL(&s_lock);
+        s_want |= 1u << id;
+        s_st.rx_misses++;
+        taskEXIT_CRITICAL(&s_lock);
+        return NULL;
+    }
+
+    memcpy(out, c->ref, c->len);
+    const uint8_t *p = in + 2, *end = in + n;
+    while (p < end) {
+        if (end - p < 3) return NULL;
+        uint16_t off = (uint16_t)(p[0] << 8 | p[1]);
+        uint8_t rn = p[2];
+        p += 3;
+        if (rn > end - p || off + rn > c->len) return NULL;
+        memcpy(out + off, p, rn);
+        p += rn;
+    }
+
+    s_st.rx_frames++;
+    *len = c->len;
+    return out;
+}
+
+void wb_dmx_on_keyreq(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_dmx_keyreq_t)) return;
+
+    wb_dmx_keyreq_t r;
+    memcpy(&r, p, sizeof(r));
+
+    taskENTER_CRITICAL(&s_lock);
+    s_key_req |= r.mask;
+    s_st.keyreq_rx++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool wb_dmx_build_keyreq(wb_dmx_keyreq_t *out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t want = s_want;
+    s_want = 0;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (!want) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->type = WB_CTRL_DMX_KEYREQ;
+    out->mask = want;
+    s_st.keyreq_tx++;
+    return true;
+}
+
+int wb_dmx_get_streams(void)
+{
+    return WB_DMX_STREAMS;
+}
+
+bool wb_dmx_get_stream_stats(int id, wb_dmx_stream_stats_t *out)
+{
+    if (!out || id < 0 || id >= WB_DMX_STREAMS || !s_tx[id].used) return false;
+    *out = s_tx[id].st;
+    return true;
+}
+
+void wb_dmx_get_stats(wb_dmx_stats_t *out)
+{
+    if (out) *out = s_st;
+}
+
+#endif // CONFIG_WB_DMX_DELTA
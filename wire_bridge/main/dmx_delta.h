@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// sACN (E1.31) / Art-Net ArtDmx delta coding. Each universe stream keeps
+// its last keyframe on both ends; other frames travel as byte runs that
+// differ from it, so a lost delta never corrupts the next one.
+
+#define WB_DMX_PROTO_SACN    1
+#define WB_DMX_PROTO_ARTNET  2
+
+typedef struct {
+    uint8_t  proto;          // WB_DMX_PROTO_*, 0 = slot unused
+    uint16_t universe;
+    uint32_t frames;         // frames sent on this stream
+    uint32_t keyframes;      // of them full keyframes
+    uint32_t bytes_in;       // Ethernet bytes before coding
+    uint32_t bytes_out;      // bytes handed to the tunnel (airtime saved = in - out)
+} wb_dmx_stream_stats_t;
+
+typedef struct {
+    uint32_t rx_frames;      // frames rebuilt
+    uint32_t rx_misses;      // deltas without a matching keyframe (dropped)
+    uint32_t keyreq_tx;      // keyframe requests sent to peer
+    uint32_t keyreq_rx;      // keyframe requests from peer
+} wb_dmx_stats_t;
+
+// TX (udp_tx_task): *f needs 2 bytes headroom; true = WB_F_DELTA
+bool wb_dmx_encode(uint8_t **f, uint16_t *len);
+
+// RX: full frame (in or out), NULL = no keyframe yet, request queued
+const uint8_t *wb_dmx_decode(const uint8_t *in, uint16_t *len, uint8_t *out);
+
+void wb_dmx_on_keyreq(const uint8_t *p, int n);
+bool wb_dmx_build_keyreq(wb_dmx_keyreq_t *out);
+
+int  wb_dmx_get_streams(void);
+bool wb_dmx_get_stream_stats(int id, wb_dmx_stream_stats_t *out);
+void wb_dmx_get_stats(wb_dmx_stats_t *out);
@@ -1,10 +1,12 @@
 #include "eth_tap.h"
+#include "task_topo.h"
 
 #include <assert.h>
 #include <stdlib.h>
 
 #include "esp_log.h"
 #include "esp_event.h"
+#include "esp_timer.h"
 #include "esp_eth.h"
 
 #include "esp_eth_mac.h"
@@ -19,15 +21,19 @@ static bool s_link = false;
 
 static wb_eth_rx_cb_t s_rx_cb = NULL;
 static void *s_rx_user = NULL;
+#if CONFIG_WB_LAT
+static uint32_t s_rx_t_us;   // EMAC RX task: arrival of the frame in hand
+#endif
 
 // ---- RX hook: called for every received Ethernet frame
 static esp_err_t wb_input_path(esp_eth_handle_t h, uint8_t *buffer, uint32_t length, void *priv)
 {
     (void)h; (void)priv;
+#if CONFIG_WB_LAT
+    s_rx_t_us = (uint32_t)esp_timer_get_time();
+#endif
 
-    if (s_rx_cb && buffer && length) {
-        s_rx_cb(buffer, (size_t)length, s_rx_user);
-    }
+    if (s_rx_cb && buffer && length) s_rx_cb(buffer, (size_t)length, s_rx_user);
 
     free(buffer); // we consume it
     return ESP_OK;
@@ -50,6 +56,20 @@ static void eth_event_handler(void *arg, esp_event_base_t base, int32_t id, void
     }
 }
 
+typedef struct {
+    const eth_esp32_emac_config_t *emac;
+    const eth_mac_config_t        *mac;
+    esp_eth_mac_t                 *out;
+} mac_new_t;
+
+// Creates the EMAC RX task
+static esp_err_t mac_new(void *arg)
+{
+    mac_new_t *a = (mac_new_t *)arg;
+    a->out = esp_eth_mac_new_esp32(a->emac, a->mac);
+    return a->out ? ESP_OK : ESP_FAIL;
+}
+
 static esp_err_t eth_init_start(void)
 {
     esp_err_t err;
@@ -71,11 +91,20 @@ static esp_err_t eth_init_start(void)
     emac_config.clock_config.rmii.clock_mode = EMAC_CLK_EXT_IN;
     emac_config.clock_config.rmii.clock_gpio = 0;
 
-    esp_eth_mac_t *mac = esp_eth_mac_new_esp32(&emac_config, &mac_config);
+    // RX task placement; the driver pins it to the core it is created on
+    const wb_stage_cfg_t *tc = wb_topo_get(WB_STAGE_ETH_RX);
+    mac_config.rx_task_prio = tc->prio;
+    mac_config.rx_task_stack_size = tc->stack;
+    if (tc->core != WB_CORE_ANY) mac_config.flags |= ETH_MAC_FLAG_PIN_TO_CORE;
+
+    mac_new_t mn = { .emac = &emac_config, .mac = &mac_config };
+    (void)wb_topo_call_on(WB_STAGE_ETH_RX, mac_new, &mn);
+    esp_eth_mac_t *mac = mn.out;
     if (!mac) {
         ESP_LOGE(TAG, "esp_eth_mac_new_esp32 failed");
         return ESP_FAIL;
     }
+    wb_topo_adopt(WB_STAGE_ETH_RX, NULL);
 
     // PHY config (WT32-ETH02 typical)
     eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
@@ -139,8 +168,16 @@ void wb_eth_start(wb_eth_rx_cb_t cb, void *user)
 
 bool wb_eth_send(const uint8_t *frame, size_t len)
 {
-    if (!s_eth || !frame || len == 0) return false;
-    return (esp_eth_transmit(s_eth, (void *)frame, len) == ESP_OK);
+    return s_eth && frame && len && esp_eth_transmit(s_eth, (void *)frame, len) == ESP_OK;
+}
+
+uint32_t wb_eth_rx_time(void)
+{
+#if CONFIG_WB_LAT
+    return s_rx_t_us;
+#else
+    return 0;
+#endif
 }
 
 bool wb_eth_link_up(void)
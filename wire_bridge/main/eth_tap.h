@@ -8,3 +8,7 @@ typedef void (*wb_eth_rx_cb_t)(const uint8_t *frame, size_t len, void *user);
 void wb_eth_start(wb_eth_rx_cb_t cb, void *user);
 bool wb_eth_send(const uint8_t *frame, size_t len);
 bool wb_eth_link_up(void);
+
+// From the RX callback: when the frame in hand arrived (esp_timer, truncated);
+// 0 without CONFIG_WB_LAT
+uint32_t wb_eth_rx_time(void);
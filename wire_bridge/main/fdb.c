@@ -0,0 +1,151 @@
+// fdb.c — MAC learning for the bridge
+//
+// Linear probing over at most WB_FDB_PROBE slots from the hash. Entries
+// are never unlinked: an aged entry is only a reusable slot, so lookups
+// stay correct without tombstones. When the probe window is full of live
+// entries the least recently seen one is replaced.
+
+#include "fdb.h"
+
+#include <string.h>
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WB_FDB
+
+#define WB_FDB_SIZE   CONFIG_WB_FDB_SIZE
+#define WB_FDB_PROBE  8
+
+_Static_assert((WB_FDB_SIZE & (WB_FDB_SIZE - 1)) == 0, "CONFIG_WB_FDB_SIZE must be a power of two");
+
+typedef struct {
+    uint8_t  mac[6];
+    uint8_t  side;         // 0 = never used
+    uint8_t  peer;         // REMOTE: tunnel peer index
+    uint32_t seen_s;
+} fdb_ent_t;
+
+static fdb_ent_t s_tab[WB_FDB_SIZE];
+static uint32_t  s_filtered, s_moves, s_replaced;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t now_s(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+static inline bool live(const fdb_ent_t *e, uint32_t now)
+{
+    return e->side && (now - e->seen_s) < CONFIG_WB_FDB_AGE_S;
+}
+
+static inline uint32_t mac_hash(const uint8_t *mac)
+{
+    // vendor bytes carry little entropy: weight the NIC-specific part
+    uint32_t h = (uint32_t)(mac[3] << 16 | mac[4] << 8 | mac[5]);
+    h ^= (uint32_t)(mac[1] << 8 | mac[2]) * 31u;
+    return (h * 2654435761u) >> 8;
+}
+
+static void learn(const uint8_t *mac, uint8_t side, uint8_t peer)
+{
+    if (mac[0] & 0x01) return;   // group addresses are never sources
+
+    uint32_t now = now_s();
+    uint32_t i0 = mac_hash(mac);
+    int slot = -1, oldest = -1;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int k = 0; k < WB_FDB_PROBE; k++) {
+        int i = (int)((i0 + k) & (WB_FDB_SIZE - 1));
+        fdb_ent_t *e = &s_tab[i];
+        if (e->side && memcmp(e->mac, mac, 6) == 0) {
+            if (live(e, now) && (e->side != side || e->peer != peer)) s_moves++;
+            e->side = side;
+            e->peer = peer;
+            e->seen_s = now;
+            taskEXIT_CRITICAL(&s_lock);
+            return;
+        }
+        if (slot < 0 && !live(e, now)) slot = i;
+        if (oldest < 0 || (now - e->seen_s) > (now - s_tab[oldest].seen_s)) oldest = i;
+    }
+
+    if (slot < 0) {
+        slot = oldest;
+        s_replaced++;
+    }
+    fdb_ent_t *e = &s_tab[slot];
+    memcpy(e->mac, mac, 6);
+    e->side = side;
+    e->peer = peer;
+    e->seen_s = now;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint8_t wb_fdb_lookup(const uint8_t *mac, uint8_t *peer)
+{
+    uint32_t now = now_s();
+    uint32_t i0 = mac_hash(mac);
+    uint8_t side = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int k = 0; k < WB_FDB_PROBE; k++) {
+        const fdb_ent_t *e = &s_tab[(i0 + k) & (WB_FDB_SIZE - 1)];
+        if (e->side && memcmp(e->mac, mac, 6) == 0) {
+            if (live(e, now)) {
+                side = e->side;
+                if (peer) *peer = e->peer;
+            }
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return side;
+}
+
+bool wb_fdb_eth_in(const uint8_t *f, uint16_t len)
+{
+    if (len < 14) return false;
+
+    learn(f + 6, WB_FDB_LOCAL, 0);
+
+    if (f[0] & 0x01) return false;        // broadcast / multicast always crosses
+    if (wb_fdb_lookup(f, NULL) != WB_FDB_LOCAL) return false;
+
+    taskENTER_CRITICAL(&s_lock);
+    s_filtered++;
+    taskEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+void wb_fdb_tunnel_in(const uint8_t *f, uint16_t len, uint8_t peer)
+{
+    if (len < 14) return;
+    learn(f + 6, WB_FDB_REMOTE, peer);
+}
+
+void wb_fdb_get_stats(wb_fdb_stats_t *out)
+{
+    if (!out) return;
+
+    uint32_t now = now_s();
+    memset(out, 0, sizeof(*out));
+    out->size = WB_FDB_SIZE;
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WB_FDB_SIZE; i++) {
+        const fdb_ent_t *e = &s_tab[i];
+        if (!live(e, now)) continue;
+        if (e->side == WB_FDB_LOCAL) out->local++;
+        else out->remote++;
+    }
+    out->filtered = s_filtered;
+    out->moves = s_moves;
+    out->replaced = s_replaced;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+#endif // CONFIG_WB_FDB
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// Learning bridge table: which side of the tunnel a unicast MAC lives on,
+// and behind which peer for remote MACs (hub mode). Fixed-size open-addressed hash (CONFIG_WB_FDB_SIZE entries, bounded
+// probing), entries age out after CONFIG_WB_FDB_AGE_S.
+
+typedef enum {
+    WB_FDB_LOCAL = 1,      // seen on our Ethernet port
+    WB_FDB_REMOTE = 2,     // seen in frames from the tunnel
+} wb_fdb_side_t;
+
+typedef struct {
+    uint32_t size;         // table slots
+    uint32_t local;        // live entries per side
+    uint32_t remote;
+    uint32_t filtered;     // ETH frames kept local (dst known local)
+    uint32_t moves;        // MAC changed side or peer
+    uint32_t replaced;     // live entries pushed out by a full probe window
+} wb_fdb_stats_t;
+
+// ETH ingress: learns the source; true = destination is local, drop it
+bool wb_fdb_eth_in(const uint8_t *frame, uint16_t len);
+
+// Tunnel egress (frames from a peer): learns the source as remote
+void wb_fdb_tunnel_in(const uint8_t *frame, uint16_t len, uint8_t peer);
+
+// Side of a unicast MAC, 0 = unknown / aged out; *peer set for REMOTE
+uint8_t wb_fdb_lookup(const uint8_t *mac, uint8_t *peer);
+
+void wb_fdb_get_stats(wb_fdb_stats_t *out);
@@ -0,0 +1,267 @@
+// fec.c — XOR parity over groups of tunnel datagrams
+//
+// Each protected datagram is folded into a parity unit laid out as
+//   [wb_hdr_t 12][u16 payload_len][u16 0][payload ...]
+// so payload sits at offset 16 both in the unit and in the datagram
+// (hdr + ext), which keeps the XOR loop word aligned on the hot path.
+// The receiver XORs everything it gets; with the parity and all but one
+// data datagram of a group in hand, the accumulator *is* the lost one.
+
+#include "fec.h"
+
+#include <string.h>
+#include <stddef.h>
+
+#include "esp_timer.h"
+
+#define WB_FEC_RX_GRPS 4
+#define WB_FEC_UNIT_HDR 16
+#define WB_FEC_UNIT_MAX (WB_FEC_UNIT_HDR + WB_MTU_MAX)
+#define WB_FEC_RX_TO_MS 200
+#define WB_FEC_TX_AGE_MS (WB_FEC_RX_TO_MS / 2)   // a lone datagram's group is dropped unsent after this
+
+_Static_assert(sizeof(wb_hdr_t) + sizeof(wb_fec_ext_t) == WB_FEC_UNIT_HDR, "unit layout");
+
+typedef struct {
+    uint16_t group;
+    uint8_t  idx;
+    uint16_t unit_len;                       // longest unit folded in so far
+    uint16_t stale;                          // acc bytes still out as parity
+    int64_t  t_first_us;                     // first datagram of the open group
+    uint32_t acc[(WB_FEC_UNIT_MAX + 3) / 4];
+} fec_tx_t;
+
+typedef struct {
+    bool     in_use;
+    bool     have_parity;
+    bool     done;                           // complete or recovered
+    uint16_t group;
+    uint8_t  count;                          // data datagrams in group (from parity)
+    uint8_t  max_idx;                        // highest data idx seen + 1
+    uint32_t got;                            // bit i = data idx i received
+    int64_t  t_last_us;
+    uint32_t acc[(WB_FEC_UNIT_MAX + 3) / 4];
+} fec_rx_t;
+
+static wb_fec_stats_t s_st;
+
+#if CONFIG_WB_FEC
+#define WB_FEC_GROUP   CONFIG_WB_FEC_GROUP
+
+static fec_tx_t s_tx;
+static fec_rx_t s_rx[WB_FEC_RX_GRPS];
+
+static void xor_into(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    if ((((uintptr_t)dst | (uintptr_t)src) & 3) == 0) {
+        uint32_t *d = (uint32_t *)dst;
+        const uint32_t *s = (const uint32_t *)src;
+        for (; n >= 4; n -= 4) *d++ ^= *s++;
+        dst = (uint8_t *)d;
+        src = (const uint8_t *)s;
+    }
+    while (n--) *dst++ ^= *src++;
+}
+
+// Fold one datagram (header as on the wire, ext excluded) into acc
+static uint16_t fold_unit(uint32_t *acc, const wb_hdr_t *h, const uint8_t *payload, uint16_t len)
+{
+    uint8_t *a = (uint8_t *)acc;
+    uint16_t pl[2] = { len, 0 };
+
+    xor_into(a, (const uint8_t *)h, sizeof(*h));
+    xor_into(a + sizeof(*h), (const uint8_t *)pl, sizeof(pl));
+    xor_into(a + WB_FEC_UNIT_HDR, payload, len);
+    return (uint16_t)(WB_FEC_UNIT_HDR + len);
+}
+
+void wb_fec_tx_protect(wb_hdr_t *h, wb_fec_ext_t *ext, const uint8_t *payload)
+{
+    if (s_tx.stale) {
+        // the last parity has been sent by now
+        memset(s_tx.acc, 0, s_tx.stale);
+        s_tx.stale = 0;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (s_tx.idx && now - s_tx.t_first_us > (int64_t)WB_FEC_TX_AGE_MS * 1000) {
+        // a lone datagram nobody joined: the receiver has let go of its
+        // group, so it stays unprotected and a new group starts
+        memset(s_tx.acc, 0, s_tx.unit_len);
+        s_tx.unit_len = 0;
+        s_tx.idx = 0;
+        s_tx.group++;
+    }
+    if (s_tx.idx == 0) s_tx.t_first_us = now;
+
+    h->flags |= WB_F_FEC;
+    ext->group = s_tx.group;
+    ext->idx = s_tx.idx++;
+    ext->count = 0;
+
+    uint16_t ul = fold_unit(s_tx.acc, h, payload, h->frag_len);
+    if (ul > s_tx.unit_len) s_tx.unit_len = ul;
+}
+
+bool wb_fec_tx_group_full(void)
+{
+    return s_tx.idx >= WB_FEC_GROUP;
+}
+
+bool wb_fec_tx_partial_due(uint32_t *wait_us)
+{
+    *wait_us = 0;
+    if (s_tx.idx < 2) return false;
+
+    int64_t left = s_tx.t_first_us + (int64_t)CONFIG_WB_FEC_HOLD_MS * 1000 - esp_timer_get_time();
+    if (left <= 0) return true;
+    *wait_us = (uint32_t)left;
+    return false;
+}
+
+uint16_t wb_fec_tx_parity(wb_hdr_t *h, wb_fec_ext_t *ext, const uint8_t **payload)
+{
+    if (s_tx.idx == 0) return 0;
+
+    // caller sends before the next protect(), so acc is handed out as is
+    // and cleared there
+    uint16_t len = s_tx.unit_len;
+
+    *h = (wb_hdr_t){
+        .magic = WB_MAGIC,
+        .ver = WB_VER,
+        .flags = WB_F_FEC,
+        .seq = 0,
+        .frame_len = len,
+        .frag_off = 0,
+        .frag_len = len,
+    };
+    *ext = (wb_fec_ext_t){ .group = s_tx.group, .idx = WB_FEC_PARITY_IDX, .count = s_tx.idx };
+    *payload = (const uint8_t *)s_tx.acc;
+
+    s_tx.stale = len;
+    s_tx.unit_len = 0;
+    s_tx.idx = 0;
+    s_tx.group++;
+    s_st.tx_parity++;
+    return len;
+}
+
+static void rx_retire(fec_rx_t *g)
+{
+    if (!g->in_use) return;
+    if (!g->done) {
+        uint8_t expect = g->have_parity ? g->count : g->max_idx;
+        uint32_t mask = (expect >= 32) ? 0xFFFFFFFFu : ((1u << expect) - 1u);
+        if ((g->got & mask) != mask) s_st.unrecoverable++;
+    }
+    g->in_use = false;
+}
+
+static fec_rx_t *rx_group(uint16_t group, int64_t now)
+{
+    fec_rx_t *free_g = NULL, *lru = NULL;
+
+    for (int i = 0; i < WB_FEC_RX_GRPS; i++) {
+        fec_rx_t *g = &s_rx[i];
+        if (g->in_use && (now - g->t_last_us) > (int64_t)WB_FEC_RX_TO_MS * 1000) rx_retire(g);
+
+        if (!g->in_use) {
+            if (!free_g) free_g = g;
+            continue;
+        }
+        if (g->group == group) return g;
+        if (!lru || g->t_last_us < lru->t_last_us) lru = g;
+    }
+
+    fec_rx_t *g = free_g;
+    if (!g) {
+        g = lru;
+        rx_retire(g);
+    }
+    memset(g, 0, offsetof(fec_rx_t, acc));
+    memset(g->acc, 0, sizeof(g->acc));
+    g->in_use = true;
+    g->group = group;
+    return g;
+}
+
+static void rx_try_recover(fec_rx_t *g, wb_fec_deliver_t deliver)
+{
+    if (g->done || !g->have_parity || g->count == 0 || g->count > 32) return;
+
+    uint32_t mask = (g->count == 32) ? 0xFFFFFFFFu : ((1u << g->count) - 1u);
+    uint32_t missing = mask & ~g->got;
+
+    if (missing == 0) { g->done = true; return; }
+    if (missing & (missing - 1)) return;      // more than one lost (so far)
+
+    // acc now holds the missing unit
+    const uint8_t *a = (const uint8_t *)g->acc;
+    wb_hdr_t h;
+    uint16_t len;
+    memcpy(&h, a, sizeof(h));
+    memcpy(&len, a + sizeof(h), sizeof(len));
+
+    g->done = true;
+    g->got |= missing;
+    if (h.magic != WB_MAGIC || h.frag_len != len || len > WB_MTU_MAX) {
+        s_st.unrecoverable++;
+        return;
+    }
+    s_st.recovered++;
+    deliver(&h, a + WB_FEC_UNIT_HDR, len);
+}
+#endif
+
+void wb_fec_rx(const uint8_t *p, int n, wb_fec_deliver_t deliver)
+{
+    if (n < WB_FEC_UNIT_HDR) return;
+
+    wb_hdr_t h;
+    wb_fec_ext_t ext;
+    memcpy(&h, p, sizeof(h));
+    memcpy(&ext, p + sizeof(h), sizeof(ext));
+
+    const uint8_t *payload = p + WB_FEC_UNIT_HDR;
+    int len = n - WB_FEC_UNIT_HDR;
+
+#if CONFIG_WB_FEC
+    int64_t now = esp_timer_get_time();
+    fec_rx_t *g = rx_group(ext.group, now);
+    g->t_last_us = now;
+
+    if (ext.idx == WB_FEC_PARITY_IDX) {
+        s_st.rx_parity++;
+        if (g->have_parity || len > WB_FEC_UNIT_MAX || ext.count == 0) return;
+        g->have_parity = true;
+        g->count = ext.count;
+        xor_into((uint8_t *)g->acc, payload, (size_t)len);
+        rx_try_recover(g, deliver);
+        return;
+    }
+
+    // data: deliver right away, fold into the group for a later repair
+    if (ext.idx < 32 && len <= WB_MTU_MAX) {
+        uint32_t bit = 1u << ext.idx;
+        if (g->got & bit) return;             // duplicate, or already rebuilt from parity
+        g->got |= bit;
+        if (ext.idx + 1 > g->max_idx) g->max_idx = (uint8_t)(ext.idx + 1);
+        fold_unit(g->acc, &h, payload, (uint16_t)len);
+    }
+    deliver(&h, payload, len);
+    rx_try_recover(g, deliver);
+#else
+    // decoding disabled: still accept data from an FEC-enabled peer
+    if (ext.idx == WB_FEC_PARITY_IDX) {
+        s_st.rx_parity++;
+        return;
+    }
+    deliver(&h, payload, len);
+#endif
+}
+
+void wb_fec_get_stats(wb_fec_stats_t *out)
+{
+    if (out) *out = s_st;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// XOR parity FEC: one parity datagram per CONFIG_WB_FEC_GROUP data datagrams
+// recovers any single lost datagram of the group without a round trip.
+
+typedef struct {
+    uint32_t tx_parity;       // parity datagrams sent
+    uint32_t rx_parity;       // parity datagrams received
+    uint32_t recovered;       // datagrams rebuilt from parity
+    uint32_t unrecoverable;   // groups that lost more than parity can repair
+} wb_fec_stats_t;
+
+typedef void (*wb_fec_deliver_t)(const wb_hdr_t *h, const uint8_t *payload, int len);
+
+// TX side (single sender task). protect() sets WB_F_FEC, fills ext and
+// accumulates parity; parity() returns payload length (0 = nothing pending),
+// *payload stays valid until the next protect().
+void     wb_fec_tx_protect(wb_hdr_t *h, wb_fec_ext_t *ext, const uint8_t *payload);
+bool     wb_fec_tx_group_full(void);
+// A partly filled group: true = close it now (two or more datagrams, the
+// first WB_FEC_HOLD_MS old); else *wait_us until it will be, 0 = not
+// before more join. A lone datagram is never closed on its own.
+bool     wb_fec_tx_partial_due(uint32_t *wait_us);
+uint16_t wb_fec_tx_parity(wb_hdr_t *h, wb_fec_ext_t *ext, const uint8_t **payload);
+
+// RX side: p/n is a whole datagram with WB_F_FEC set
+void wb_fec_rx(const uint8_t *p, int n, wb_fec_deliver_t deliver);
+
+void wb_fec_get_stats(wb_fec_stats_t *out);
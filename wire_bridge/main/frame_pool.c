@@ -0,0 +1,102 @@
+// frame_pool.c — preallocated frame buffers for the tunnel hot path
+//
+// Replaces malloc/free per frame: buffers live in one block taken from
+// the heap once at start (kept out of .bss, so a pool too large for the
+// chip fails at init instead of overflowing DRAM at link time), free list
+// is an index stack guarded by a spinlock (safe from both cores, O(1)
+// alloc/free, no heap fragmentation).
+
+#include "frame_pool.h"
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "wb_pool";
+
+#define WB_POOL_FRAMES  CONFIG_WB_POOL_FRAMES
+#define WB_POOL_STRIDE  ((WB_POOL_BUF_SIZE + WB_POOL_ALIGN - 1) & ~(WB_POOL_ALIGN - 1))
+
+#define WB_POOL_BYTES   ((size_t)WB_POOL_FRAMES * WB_POOL_STRIDE)
+
+static uint8_t *s_mem;                    // WB_POOL_FRAMES buffers, WB_POOL_STRIDE apart
+
+static uint16_t s_free[WB_POOL_FRAMES];   // stack of free buffer indexes
+static int      s_top = 0;                // number of free entries
+static bool     s_ready = false;
+
+static uint32_t s_high = 0, s_exhausted = 0;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool wb_pool_init(void)
+{
+    if (s_ready) return true;
+
+    // internal RAM: the target has no PSRAM
+    s_mem = heap_caps_aligned_alloc(WB_POOL_ALIGN, WB_POOL_BYTES, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+    if (!s_mem) {
+        ESP_LOGE(TAG, "frame pool: no RAM for %d x %d B", WB_POOL_FRAMES, WB_POOL_STRIDE);
+        return false;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WB_POOL_FRAMES; i++) {
+        s_free[i] = (uint16_t)(WB_POOL_FRAMES - 1 - i);
+    }
+    s_top = WB_POOL_FRAMES;
+    s_ready = true;
+    taskEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "frame pool: %d x %d B", WB_POOL_FRAMES, WB_POOL_STRIDE);
+    return true;
+}
+
+uint8_t *wb_pool_alloc(void)
+{
+    return wb_pool_alloc_keep(0);
+}
+
+uint8_t *wb_pool_alloc_keep(uint32_t keep)
+{
+    uint8_t *buf = NULL;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_top > (int)keep) {
+        buf = s_mem + (size_t)s_free[--s_top] * WB_POOL_STRIDE;
+        uint32_t used = (uint32_t)(WB_POOL_FRAMES - s_top);
+        if (used > s_high) s_high = used;
+    } else if (s_top == 0) {
+        s_exhausted++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+
+    return buf;
+}
+
+void wb_pool_free(uint8_t *buf)
+{
+    if (!buf) return;
+
+    uintptr_t off = (uintptr_t)buf - (uintptr_t)s_mem;
+    if (!s_mem || (uintptr_t)buf < (uintptr_t)s_mem || off >= WB_POOL_BYTES || (off % WB_POOL_STRIDE) != 0) {
+        ESP_LOGE(TAG, "free of foreign buffer %p", buf);
+        return;
+    }
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_top < WB_POOL_FRAMES) s_free[s_top++] = (uint16_t)(off / WB_POOL_STRIDE);
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void wb_pool_get_stats(wb_pool_stats_t *out)
+{
+    if (!out) return;
+
+    taskENTER_CRITICAL(&s_lock);
+    out->total = WB_POOL_FRAMES;
+    out->in_use = (uint32_t)(WB_POOL_FRAMES - s_top);
+    out->high_water = s_high;
+    out->exhausted = s_exhausted;
+    taskEXIT_CRITICAL(&s_lock);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Fixed-size frame buffers (one Ethernet frame each), sized by CONFIG_WB_POOL_FRAMES,
+// allocated from internal RAM by wb_pool_init().
+#define WB_POOL_ALIGN     32
+#define WB_POOL_BUF_SIZE  1600
+
+typedef struct {
+    uint32_t total;        // buffers in the pool
+    uint32_t in_use;       // currently allocated
+    uint32_t high_water;   // max in_use seen
+    uint32_t exhausted;    // alloc calls that found the pool empty
+} wb_pool_stats_t;
+
+bool     wb_pool_init(void);           // false = no RAM; the pool stays empty
+uint8_t *wb_pool_alloc(void);          // NULL when exhausted
+uint8_t *wb_pool_alloc_keep(uint32_t keep);   // NULL unless more than keep are free
+void     wb_pool_free(uint8_t *buf);   // NULL is ignored
+
+void wb_pool_get_stats(wb_pool_stats_t *out);
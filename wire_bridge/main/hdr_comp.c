@@ -0,0 +1,220 @@
+// hdr_comp.c — per-flow Ethernet header compression
+//
+// Context byte: [7] install (full header follows), [6:5] generation, [4:0] id.
+// A new context is sent with the full header WB_HC_INSTALLS times and then
+// refreshed every WB_HC_REFRESH frames. The generation changes whenever an
+// id is reassigned, but two bits wrap after four reassignments: after a
+// loss the receiver trusts a context again only once a full header came
+// for it. An unknown/stale/unconfirmed id is dropped and the peer is asked
+// to reinstall it.
+
+#include "hdr_comp.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#define WB_HC_INSTALLS   2
+#define WB_HC_REFRESH    256
+#define WB_HC_HDR_MAX    18
+
+#define HC_E        0x80
+#define HC_GEN(b)   (((b) >> 5) & 3)
+#define HC_ID(b)    ((b) & 0x1F)
+
+typedef struct {
+    bool     used;
+    uint8_t  gen;
+    uint8_t  hlen;
+    uint8_t  installs_left;
+    uint16_t since_install;
+    uint32_t last_use;
+    uint8_t  hdr[WB_HC_HDR_MAX];
+    wb_hc_ctx_stats_t st;
+} hc_tx_t;
+
+typedef struct {
+    bool     valid;
+    bool     confirmed;     // full header seen since the last loss
+    uint8_t  gen;
+    uint8_t  hlen;
+    uint8_t  hdr[WB_HC_HDR_MAX];
+} hc_rx_t;
+
+static hc_tx_t  s_tx[WB_HC_CTX];
+static hc_rx_t  s_rx[WB_HC_CTX];
+static uint32_t s_use_clock = 0;
+static int      s_last = 0;              // last hit, cheap check for bursts of one flow
+
+static volatile uint32_t s_reinstall = 0;   // peer asked (RX ctx -> TX task)
+static volatile uint32_t s_want = 0;        // we need the peer to reinstall
+static wb_hc_stats_t s_st;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint8_t eth_hdr_len(const uint8_t *f, uint16_t len)
+{
+    if (len < 14) return 0;
+    if (f[12] == 0x81 && f[13] == 0x00) return (len >= 18) ? 18 : 0;
+    return 14;
+}
+
+static int tx_lookup(const uint8_t *f, uint8_t hlen)
+{
+    hc_tx_t *c = &s_tx[s_last];
+    if (c->used && c->hlen == hlen && memcmp(c->hdr, f, hlen) == 0) return s_last;
+
+    int free_i = -1, lru = 0;
+    for (int i = 0; i < WB_HC_CTX; i++) {
+        c = &s_tx[i];
+        if (!c->used) {
+            if (free_i < 0) free_i = i;
+            continue;
+        }
+        if (c->hlen == hlen && memcmp(c->hdr, f, hlen) == 0) return i;
+        if (c->last_use < s_tx[lru].last_use) lru = i;
+    }
+
+    int i = free_i;
+    if (i < 0) {
+        i = lru;
+        s_st.evictions++;
+    } else {
+        s_st.ctx_used++;
+    }
+
+    c = &s_tx[i];
+    uint8_t gen = (uint8_t)((c->gen + 1) & 3);
+    memset(c, 0, sizeof(*c));
+    c->used = true;
+    c->gen = gen;
+    c->hlen = hlen;
+    c->installs_left = WB_HC_INSTALLS;
+    memcpy(c->hdr, f, hlen);
+    return i;
+}
+
+bool wb_hc_encode(uint8_t **f, uint16_t *len)
+{
+    uint8_t *p = *f;
+    uint8_t hlen = eth_hdr_len(p, *len);
+    if (!hlen) return false;
+
+    int id = tx_lookup(p, hlen);
+    hc_tx_t *c = &s_tx[id];
+    s_last = id;
+    c->last_use = ++s_use_clock;
+    c->st.frames++;
+
+    uint32_t bit = 1u << id;
+    bool install = c->installs_left > 0 || c->since_install >= WB_HC_REFRESH || (s_reinstall & bit);
+
+    if (install) {
+        taskENTER_CRITICAL(&s_lock);
+        s_reinstall &= ~bit;
+        taskEXIT_CRITICAL(&s_lock);
+
+        if (c->installs_left) c->installs_left--;
+        c->since_install = 0;
+        c->st.installs++;
+
+        // [ctx][full header][payload]
+        p -= 1;
+        p[0] = (uint8_t)(HC_E | (c->gen << 5) | id);
+        *len = (uint16_t)(*len + 1);
+    } else {
+        c->since_install++;
+        c->st.bytes_saved += (uint32_t)(hlen - 1);
+
+        // [ctx][payload]: overwrite the last header byte
+        p += hlen - 1;
+        p[0] = (uint8_t)((c->gen << 5) | id);
+        *len = (uint16_t)(*len - hlen + 1);
+    }
+
+    *f = p;
+    return true;
+}
+
+const uint8_t *wb_hc_decode(const uint8_t *in, uint16_t *len, uint8_t *scratch)
+{
+    if (*len < 1) return NULL;
+
+    uint8_t b = in[0];
+    hc_rx_t *c = &s_rx[HC_ID(b)];
+
+    if (b & HC_E) {
+        uint8_t hlen = eth_hdr_len(in + 1, (uint16_t)(*len - 1));
+        if (!hlen) return NULL;
+
+        c->valid = true;
+        c->confirmed = true;
+        c->gen = HC_GEN(b);
+        c->hlen = hlen;
+        memcpy(c->hdr, in + 1, hlen);
+
+        *len = (uint16_t)(*len - 1);
+        return in + 1;
+    }
+
+    if (!c->valid || !c->confirmed || c->gen != HC_GEN(b)) {
+        s_st.misses++;
+        taskENTER_CRITICAL(&s_lock);
+        s_want |= 1u << HC_ID(b);
+        taskEXIT_CRITICAL(&s_lock);
+        return NULL;
+    }
+
+    uint16_t body = (uint16_t)(*len - 1);
+    if (c->hlen + body > WB_MAX_FRAME) return NULL;
+    memcpy(scratch, c->hdr, c->hlen);
+    memcpy(scratch + c->hlen, in + 1, body);
+    *len = (uint16_t)(c->hlen + body);
+    return scratch;
+}
+
+void wb_hc_rx_gap(void)
+{
+    for (int i = 0; i < WB_HC_CTX; i++) s_rx[i].confirmed = false;
+}
+
+void wb_hc_on_resync(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_hc_resync_t)) return;
+
+    wb_hc_resync_t r;
+    memcpy(&r, p, sizeof(r));
+
+    taskENTER_CRITICAL(&s_lock);
+    s_reinstall |= r.mask;
+    s_st.resyncs_rx++;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool wb_hc_build_resync(wb_hc_resync_t *out)
+{
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t want = s_want;
+    s_want = 0;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (!want) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->type = WB_CTRL_HC_RESYNC;
+    out->mask = want;
+    s_st.resyncs_tx++;
+    return true;
+}
+
+bool wb_hc_get_ctx_stats(int id, wb_hc_ctx_stats_t *out)
+{
+    if (!out || id < 0 || id >= WB_HC_CTX || !s_tx[id].used) return false;
+    *out = s_tx[id].st;
+    return true;
+}
+
+void wb_hc_get_stats(wb_hc_stats_t *out)
+{
+    if (out) *out = s_st;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// Ethernet header compression: (dst, src, ethertype[, VLAN]) tuples are
+// learned into WB_HC_CTX contexts; after install the header travels as a
+// single context byte.
+#define WB_HC_CTX 32
+
+typedef struct {
+    uint32_t frames;        // frames sent with this context
+    uint32_t installs;      // of them with the full header (install / refresh)
+    uint32_t bytes_saved;   // over-the-air bytes saved
+} wb_hc_ctx_stats_t;
+
+typedef struct {
+    uint32_t ctx_used;      // contexts in use (TX)
+    uint32_t evictions;     // contexts reassigned to a new tuple
+    uint32_t misses;        // RX frames with unknown/stale/unconfirmed context (dropped)
+    uint32_t resyncs_tx;    // resync requests sent to peer
+    uint32_t resyncs_rx;    // resync requests from peer
+} wb_hc_stats_t;
+
+// TX (udp_tx_task): *f needs 1 byte headroom; rewritten in place, true = WB_F_HC
+bool wb_hc_encode(uint8_t **f, uint16_t *len);
+
+// RX: returns full frame (in or scratch), NULL = unknown context, resync queued
+const uint8_t *wb_hc_decode(const uint8_t *in, uint16_t *len, uint8_t *scratch);
+
+// RX: frames were lost, any of them may have reassigned a context; each
+// one needs a full header again before compressed frames use it
+void wb_hc_rx_gap(void);
+
+// Resync: peer asked to reinstall contexts / we need the peer to reinstall
+void wb_hc_on_resync(const uint8_t *p, int n);
+bool wb_hc_build_resync(wb_hc_resync_t *out);
+
+bool wb_hc_get_ctx_stats(int id, wb_hc_ctx_stats_t *out);
+void wb_hc_get_stats(wb_hc_stats_t *out);
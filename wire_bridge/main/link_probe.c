@@ -0,0 +1,262 @@
+// link_probe.c — in-band RTT / loss / reordering / jitter probes
+//
+// Pings carry a 32-bit seq and the sender's send time; the echo returns
+// both plus how long the echoer held the ping, so RTT excludes the TX
+// task's scheduling delay on the far side. Loss is counted from seq gaps
+// (a late ping fills its gap again), reorder depth is how far behind the
+// highest seq a ping arrives, and jitter is the RFC 3550 estimator over
+// one-way transit times (clock offset cancels out). A bitmap of the last
+// WB_LP_SEEN seqs keeps duplicates out of the counts; a new boot tag, or
+// seq 1 past that window, starts the peer's counts over.
+
+#include "link_probe.h"
+
+#include <string.h>
+
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WB_LP
+
+#define WB_LP_INTERVAL_US  ((int64_t)CONFIG_WB_LP_INTERVAL_MS * 1000)
+#define WB_LP_RESTART      1024    // seq this far back = peer restarted
+#define WB_LP_SEEN         64      // seqs behind the highest told apart from duplicates
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// our pings
+static uint8_t  s_boot;
+static uint32_t s_seq;
+static int64_t  s_t_next;
+static uint32_t s_rtt[WB_LP_RTT_WINDOW];
+static uint32_t s_rtt_n, s_rtt_i;
+static int64_t  s_t_echo;               // last echo, 0 = none
+static bool     s_txw_have;
+static uint32_t s_txw_exp, s_txw_cnt;   // window start, from the peer's echoes
+
+// the peer's pings
+static bool     s_rx_started;
+static uint8_t  s_rx_boot;
+static uint32_t s_rx_first, s_rx_max;
+static uint64_t s_rx_seen;              // bit i = s_rx_max - i arrived
+static uint32_t s_rxw_exp, s_rxw_cnt;   // window start
+static uint32_t s_transit;              // previous one-way transit (offset included)
+static uint32_t s_jit16;                // jitter * 16
+
+// echo owed to the peer
+static bool     s_echo_req;
+static uint32_t s_echo_seq, s_echo_ttx, s_echo_trx;
+
+static wb_lp_stats_t s_st;
+
+static uint32_t now32(void)
+{
+    return (uint32_t)esp_timer_get_time();
+}
+
+static uint8_t reorder_bin(uint32_t depth)
+{
+    if (depth <= 2) return (uint8_t)(depth - 1);
+    if (depth <= 4) return 2;
+    if (depth <= 8) return 3;
+    return 4;
+}
+
+// Loss over the last window of expected pings, per mille
+static uint16_t loss_window(uint32_t exp, uint32_t cnt, uint32_t *w_exp, uint32_t *w_cnt, uint16_t prev)
+{
+    uint32_t d_exp = exp - *w_exp, d_cnt = cnt - *w_cnt;
+    if (d_exp < WB_LP_LOSS_WINDOW) return prev;
+
+    *w_exp = exp;
+    *w_cnt = cnt;
+    if (d_cnt >= d_exp) return 0;
+    return (uint16_t)((d_exp - d_cnt) * 1000u / d_exp);
+}
+
+void wb_lp_init(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    memset(&s_st, 0, sizeof(s_st));
+    s_rtt_n = s_rtt_i = 0;
+    s_t_echo = 0;
+    s_txw_have = false;
+    s_rx_started = false;
+    s_echo_req = false;
+    s_t_next = 0;
+    taskEXIT_CRITICAL(&s_lock);
+
+    // 0 is what a peer without tags sends
+    if (!s_boot) s_boot = (uint8_t)(esp_random() % 255 + 1);
+}
+
+void wb_lp_on_ping(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_lp_ping_t)) return;
+
+    wb_lp_ping_t pg;
+    memcpy(&pg, p, sizeof(pg));
+    uint32_t t_rx = now32();
+    uint32_t transit = t_rx - pg.t_tx_us;
+
+    taskENTER_CRITICAL(&s_lock);
+
+    int32_t ahead = (int32_t)(pg.seq - s_rx_max);
+    bool restart = pg.boot != s_rx_boot || ahead < -WB_LP_RESTART ||
+                   (pg.seq == 1 && ahead <= -WB_LP_SEEN);
+    if (!s_rx_started || restart) {
+        s_rx_started = true;
+        s_rx_boot = pg.boot;
+        s_rx_first = s_rx_max = pg.seq;
+        s_rx_seen = 1;
+        s_rxw_exp = 1;
+        s_rxw_cnt = 1;
+        s_st.rx_pings = 1;
+        s_transit = transit;
+        s_jit16 = 0;
+    } else if (ahead > 0) {
+        s_rx_max = pg.seq;
+        s_rx_seen = ahead < WB_LP_SEEN ? s_rx_seen << ahead | 1 : 1;
+        s_st.rx_pings++;
+    } else if (ahead < 0) {
+        uint32_t depth = (uint32_t)-ahead;
+        uint64_t bit = depth < WB_LP_SEEN ? 1ull << depth : 0;
+        if (bit && !(s_rx_seen & bit)) {
+            s_rx_seen |= bit;
+            s_st.reordered++;
+            s_st.reorder_hist[reorder_bin(depth)]++;
+            s_st.rx_pings++;
+        }
+    }
+    // duplicate or too old to tell: not counted, still echoed
+
+    // J += (|D| - J) / 16, kept scaled by 16
+    int32_t d = (int32_t)(transit - s_transit);
+    uint32_t ad = (uint32_t)(d < 0 ? -d : d);
+    s_transit = transit;
+    s_jit16 += ad - ((s_jit16 + 8) >> 4);
+
+    uint32_t exp = s_rx_max - s_rx_first + 1;
+    s_st.rx_lost = exp > s_st.rx_pings ? exp - s_st.rx_pings : 0;
+    s_st.rx_loss_pm = loss_window(exp, s_st.rx_pings, &s_rxw_exp, &s_rxw_cnt, s_st.rx_loss_pm);
+    s_st.jitter_us = s_jit16 >> 4;
+
+    s_echo_req = true;
+    s_echo_seq = pg.seq;
+    s_echo_ttx = pg.t_tx_us;
+    s_echo_trx = t_rx;
+
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void wb_lp_on_echo(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_lp_echo_t)) return;
+
+    wb_lp_echo_t e;
+    memcpy(&e, p, sizeof(e));
+    int64_t now = esp_timer_get_time();
+    uint32_t rtt = (uint32_t)now - e.t_tx_us;
+    rtt = rtt > e.hold_us ? rtt - e.hold_us : 0;
+
+    taskENTER_CRITICAL(&s_lock);
+
+    s_st.echoes_rx++;
+    s_t_echo = now;
+    s_rtt[s_rtt_i] = rtt;
+    s_rtt_i = (s_rtt_i + 1) % WB_LP_RTT_WINDOW;
+    if (s_rtt_n < WB_LP_RTT_WINDOW) s_rtt_n++;
+
+    if (!s_txw_have || e.rx_expected < s_txw_exp) {
+        // first report, or the peer restarted its count
+        s_txw_have = true;
+        s_txw_exp = e.rx_expected;
+        s_txw_cnt = e.rx_pings;
+    } else {
+        s_st.tx_loss_pm = loss_window(e.rx_expected, e.rx_pings, &s_txw_exp, &s_txw_cnt, s_st.tx_loss_pm);
+    }
+
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+bool wb_lp_build_ping(wb_lp_ping_t *out)
+{
+    int64_t now = esp_timer_get_time();
+    if (now < s_t_next) return false;
+
+    // keep the cadence, but do not burst to catch up after a stall
+    s_t_next += WB_LP_INTERVAL_US;
+    if (s_t_next <= now) s_t_next = now + WB_LP_INTERVAL_US;
+
+    memset(out, 0, sizeof(*out));
+    out->type = WB_CTRL_LP_PING;
+    out->boot = s_boot;
+    out->seq = ++s_seq;
+    out->t_tx_us = (uint32_t)now;
+
+    taskENTER_CRITICAL(&s_lock);
+    s_st.pings_tx++;
+    taskEXIT_CRITICAL(&s_lock);
+    return true;
+}
+
+bool wb_lp_build_echo(wb_lp_echo_t *out)
+{
+    memset(out, 0, sizeof(*out));
+
+    taskENTER_CRITICAL(&s_lock);
+    bool req = s_echo_req;
+    s_echo_req = false;
+    out->seq = s_echo_seq;
+    out->t_tx_us = s_echo_ttx;
+    out->hold_us = now32() - s_echo_trx;
+    out->rx_pings = s_st.rx_pings;
+    out->rx_expected = s_rx_max - s_rx_first + 1;
+    taskEXIT_CRITICAL(&s_lock);
+
+    out->type = WB_CTRL_LP_ECHO;
+    return req;
+}
+
+static uint32_t pct(const uint32_t *sorted, uint32_t n, uint32_t p)
+{
+    // nearest rank
+    uint32_t r = (n * p + 99) / 100;
+    return sorted[r ? r - 1 : 0];
+}
+
+void wb_lp_get_stats(wb_lp_stats_t *out)
+{
+    if (!out) return;
+
+    uint32_t v[WB_LP_RTT_WINDOW];
+
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    uint32_t n = s_rtt_n;
+    int64_t t_echo = s_t_echo;
+    memcpy(v, s_rtt, sizeof(v));
+    taskEXIT_CRITICAL(&s_lock);
+
+    int64_t age = esp_timer_get_time() - t_echo;
+    out->echo_age_ms = t_echo ? (uint32_t)(age / 1000) : UINT32_MAX;
+    out->up = t_echo && age < WB_LP_DOWN_PINGS * WB_LP_INTERVAL_US;
+    out->rtt_samples = n;
+    if (n == 0) return;
+
+    // insertion sort, the window is small
+    for (uint32_t i = 1; i < n; i++) {
+        uint32_t x = v[i], j = i;
+        for (; j > 0 && v[j - 1] > x; j--) v[j] = v[j - 1];
+        v[j] = x;
+    }
+
+    out->rtt_min_us = v[0];
+    out->rtt_p50_us = pct(v, n, 50);
+    out->rtt_p90_us = pct(v, n, 90);
+    out->rtt_p99_us = pct(v, n, 99);
+    out->rtt_max_us = v[n - 1];
+}
+
+#endif // CONFIG_WB_LP
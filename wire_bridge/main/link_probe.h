@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// In-band link probes. Every CONFIG_WB_LP_INTERVAL_MS a timestamped ping
+// goes to the peer, which echoes it. Echoes give the RTT; the pings the
+// peer sends us give loss (sequence gaps), reordering and jitter for the
+// peer -> us direction, and each echo reports the same loss the other way.
+
+#define WB_LP_RTT_WINDOW    64     // RTT percentiles over the last N echoes
+#define WB_LP_LOSS_WINDOW   64     // loss rate over the last N expected pings
+#define WB_LP_REORDER_BINS  5      // reorder depth 1, 2, 3-4, 5-8, >8
+#define WB_LP_DOWN_PINGS    10     // no echo for this many intervals: link down
+
+typedef struct {
+    uint32_t pings_tx;
+    uint32_t echoes_rx;
+    uint32_t echo_age_ms;          // since the last echo, UINT32_MAX = none yet
+    bool     up;                   // an echo within WB_LP_DOWN_PINGS intervals
+    uint32_t rtt_samples;          // in the window
+    uint32_t rtt_min_us;
+    uint32_t rtt_p50_us;
+    uint32_t rtt_p90_us;
+    uint32_t rtt_p99_us;
+    uint32_t rtt_max_us;
+    uint32_t jitter_us;            // RFC 3550 interarrival jitter, peer -> us
+    uint32_t rx_pings;             // peer -> us
+    uint32_t rx_lost;              // gaps not filled by late pings
+    uint16_t rx_loss_pm;           // per mille, last loss window
+    uint16_t tx_loss_pm;           // us -> peer, reported by the peer
+    uint32_t reordered;            // pings older than one already seen
+    uint32_t reorder_hist[WB_LP_REORDER_BINS];
+} wb_lp_stats_t;
+
+void wb_lp_init(void);
+
+// RX context
+void wb_lp_on_ping(const uint8_t *p, int n);
+void wb_lp_on_echo(const uint8_t *p, int n);
+
+// udp_tx_task: false = nothing due
+bool wb_lp_build_ping(wb_lp_ping_t *out);
+bool wb_lp_build_echo(wb_lp_echo_t *out);
+
+void wb_lp_get_stats(wb_lp_stats_t *out);
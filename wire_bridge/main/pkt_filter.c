@@ -0,0 +1,494 @@
+// pkt_filter.c — compiled packet filter for Ethernet ingress
+//
+// cBPF-style machine: accumulator A, index X, 8-byte instructions with
+// relative true/false jump offsets. Jumps only go forward, so a program
+// runs at most its own length; the compiler caps the total over all
+// rules at WB_PF_MAX_INSNS. A load past the end of the frame ends the
+// rule as "no match".
+//
+// The ingress program is published through one pointer and run without a
+// lock. Readers count themselves in one of two generations; a replaced
+// program is freed once the generation that could still see it drains.
+
+#include "pkt_filter.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// the machine and compiler also serve the packet capture filter / trigger
+#if CONFIG_WB_PF || CONFIG_WB_CAP
+
+static const char *TAG = "wb_pf";
+
+#define WB_PF_NVS_NS    "wb_pf"
+#define WB_PF_NVS_KEY   "rules"
+#define WB_PF_SRC_MAX   512
+#define WB_PF_LDMAX     1600      // highest load offset a rule may use
+
+enum {
+    PF_LDB,      // A = P[k]
+    PF_LDH,      // A = P[k..k+1] (big endian)
+    PF_LDW,      // A = P[k..k+3]
+    PF_LDBX,     // A = P[X+k]
+    PF_LDHX,     // A = P[X+k..]
+    PF_LDXL2,    // X = EtherType offset, past up to two 802.1Q/802.1ad tags
+    PF_LDXIP,    // X += k + 4 * (P[X+k] & 0x0F)   (IPv4 header length)
+    PF_AND,      // A &= k
+    PF_JEQ,      // A == k ? jt : jf
+    PF_JSET,     // A & k  ? jt : jf
+    PF_JA,       // skip k
+    PF_RET,      // result k (1 = match)
+};
+
+typedef struct {
+    uint8_t  op;
+    uint8_t  jt;
+    uint8_t  jf;
+    uint8_t  rsvd;
+    uint32_t k;
+} pf_insn_t;
+
+typedef struct {
+    uint16_t start;
+    uint16_t len;
+    bool     drop;
+    char     text[WB_PF_TEXT_MAX];
+} pf_rule_t;
+
+typedef struct {
+    pf_insn_t insn[WB_PF_MAX_INSNS];
+    pf_rule_t rule[WB_PF_MAX_RULES];
+    uint16_t  n_insn;
+    uint16_t  n_rule;
+} pf_prog_t;
+
+struct wb_pf_prog {
+    pf_prog_t p;
+    uint32_t  hits[WB_PF_MAX_RULES];            // ingress program only
+};
+
+#if CONFIG_WB_PF
+static wb_pf_prog_t *s_live;                    // ingress rules, NULL = none
+static uint32_t s_gen;                          // readers count in s_readers[s_gen & 1]
+static uint32_t s_readers[2];
+static uint32_t s_frames, s_dropped;
+#endif
+
+// ---- interpreter
+
+static bool run(const pf_insn_t *pc, uint16_t n, const uint8_t *f, uint32_t len)
+{
+    uint32_t a = 0, x = 0;
+
+    for (uint16_t i = 0; i < n; i++) {
+        const pf_insn_t *in = &pc[i];
+        uint32_t off = in->k;
+
+        switch (in->op) {
+        case PF_LDBX:
+            off += x;
+            // fallthrough
+        case PF_LDB:
+            if (off >= len) return false;
+            a = f[off];
+            break;
+        case PF_LDHX:
+            off += x;
+            // fallthrough
+        case PF_LDH:
+            if (off + 2 > len) return false;
+            a = (uint32_t)(f[off] << 8 | f[off + 1]);
+            break;
+        case PF_LDW:
+            if (off + 4 > len) return false;
+            a = (uint32_t)f[off] << 24 | (uint32_t)f[off + 1] << 16 | (uint32_t)f[off + 2] << 8 | f[off + 3];
+            break;
+        case PF_LDXL2:
+            x = 12;
+            for (int t = 0; t < 2; t++) {
+                if (x + 2 > len) return false;
+                uint32_t et = (uint32_t)(f[x] << 8 | f[x + 1]);
+                if (et != 0x8100 && et != 0x88A8) break;
+                x += 4;
+            }
+            break;
+        case PF_LDXIP:
+            off += x;
+            if (off >= len) return false;
+            x = off + 4u * (f[off] & 0x0F);
+            break;
+        case PF_AND:
+            a &= in->k;
+            break;
+        case PF_JEQ:
+            i += (a == in->k) ? in->jt : in->jf;
+            break;
+        case PF_JSET:
+            i += (a & in->k) ? in->jt : in->jf;
+            break;
+        case PF_JA:
+            i += in->k;
+            break;
+        case PF_RET:
+            return in->k != 0;
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+#if CONFIG_WB_PF
+
+// Counted in before the program is loaded: wb_pf_set_rules() frees a
+// replaced program only once its generation has no readers left
+static inline uint32_t read_begin(void)
+{
+    for (;;) {
+        uint32_t g = __atomic_load_n(&s_gen, __ATOMIC_SEQ_CST) & 1;
+        __atomic_fetch_add(&s_readers[g], 1, __ATOMIC_SEQ_CST);
+        // flipped in between: the writer may not wait for this generation
+        if ((__atomic_load_n(&s_gen, __ATOMIC_SEQ_CST) & 1) == g) return g;
+        __atomic_fetch_sub(&s_readers[g], 1, __ATOMIC_RELEASE);
+    }
+}
+
+static inline void read_end(uint32_t g)
+{
+    __atomic_fetch_sub(&s_readers[g], 1, __ATOMIC_RELEASE);
+}
+
+bool wb_pf_drop(const uint8_t *f, uint16_t len)
+{
+    bool drop = false;
+
+    uint32_t g = read_begin();
+    wb_pf_prog_t *p = __atomic_load_n(&s_live, __ATOMIC_SEQ_CST);
+    if (p) {
+        for (int r = 0; r < p->p.n_rule; r++) {
+            const pf_rule_t *ru = &p->p.rule[r];
+            if (run(&p->p.insn[ru->start], ru->len, f, len)) {
+                __atomic_fetch_add(&p->hits[r], 1, __ATOMIC_RELAXED);
+                drop = ru->drop;
+                break;
+            }
+        }
+    }
+    read_end(g);
+
+    __atomic_fetch_add(&s_frames, 1, __ATOMIC_RELAXED);
+    if (drop) __atomic_fetch_add(&s_dropped, 1, __ATOMIC_RELAXED);
+    return drop;
+}
+#endif
+
+// ---- compiler
+
+#define FAIL  0xFF      // jf placeholder: "rule does not match"
+
+typedef struct {
+    pf_insn_t *p;       // rule's first instruction
+    uint16_t   n;
+    uint16_t   cap;
+} emit_t;
+
+static int emit(emit_t *e, uint8_t op, uint32_t k, uint8_t jt, uint8_t jf)
+{
+    if (e->n >= e->cap) return -1;
+    e->p[e->n] = (pf_insn_t){ .op = op, .jt = jt, .jf = jf, .k = k };
+    return e->n++;
+}
+
+// A == k or the rule fails
+static void expect(emit_t *e, uint32_t k)
+{
+    emit(e, PF_JEQ, k, 0, FAIL);
+}
+
+static bool parse_num(const char *s, uint32_t *v)
+{
+    if (!s || !*s) return false;
+    char *end;
+    *v = (uint32_t)strtoul(s, &end, 0);
+    return *end == '\0';
+}
+
+// A = EtherType past VLAN tags; X at it, so the L3 header is at X + 2
+static void emit_ethertype(emit_t *e)
+{
+    emit(e, PF_LDXL2, 0, 0, 0);
+    emit(e, PF_LDHX, 0, 0, 0);
+}
+
+// udp/tcp port over IPv4 or IPv6
+static void emit_port(emit_t *e, uint8_t proto, bool dst, uint32_t port)
+{
+    uint32_t po = dst ? 2 : 0;
+
+    emit_ethertype(e);
+    int j4 = emit(e, PF_JEQ, 0x0800, 0, 0);         // jf -> IPv6 branch, patched
+    emit(e, PF_LDBX, 2 + 9, 0, 0);
+    expect(e, proto);
+    emit(e, PF_LDHX, 2 + 6, 0, 0);
+    emit(e, PF_AND, 0x1FFF, 0, 0);
+    expect(e, 0);                                   // first fragment only
+    emit(e, PF_LDXIP, 2, 0, 0);
+    emit(e, PF_LDHX, po, 0, 0);
+    expect(e, port);
+    int ja = emit(e, PF_JA, 0, 0, 0);               // -> after IPv6 branch, patched
+
+    int v6 = e->n;
+    expect(e, 0x86DD);
+    emit(e, PF_LDBX, 2 + 6, 0, 0);
+    expect(e, proto);
+    emit(e, PF_LDHX, 2 + 40 + po, 0, 0);
+    expect(e, port);
+
+    if (j4 >= 0 && ja >= 0) {
+        e->p[j4].jf = (uint8_t)(v6 - j4 - 1);
+        e->p[ja].k = (uint32_t)(e->n - ja - 1);
+    }
+}
+
+// One rule line into e; false = syntax error
+static bool compile_rule(char *line, emit_t *e, pf_rule_t *ru)
+{
+    char *save = NULL;
+    char *tok[24];
+    int nt = 0;
+    for (char *t = strtok_r(line, " \t", &save); t && nt < 24; t = strtok_r(NULL, " \t", &save)) {
+        tok[nt++] = t;
+    }
+    if (nt < 2) return false;
+
+    if (strcmp(tok[0], "drop") == 0) ru->drop = true;
+    else if (strcmp(tok[0], "pass") == 0) ru->drop = false;
+    else return false;
+
+    int i = 1;
+    while (i < nt) {
+        const char *w = tok[i++];
+        uint32_t v, m = 0xFFFFFFFFu, off;
+
+        if (strcmp(w, "ip") == 0 || strcmp(w, "ip6") == 0 || strcmp(w, "arp") == 0) {
+            emit_ethertype(e);
+            expect(e, w[0] == 'a' ? 0x0806 : (w[2] ? 0x86DD : 0x0800));
+        } else if (strcmp(w, "ether") == 0) {
+            if (i >= nt || !parse_num(tok[i++], &v)) return false;
+            emit(e, PF_LDH, 12, 0, 0);
+            expect(e, v);
+        } else if (strcmp(w, "broadcast") == 0) {
+            emit(e, PF_LDW, 0, 0, 0);
+            expect(e, 0xFFFFFFFFu);
+            emit(e, PF_LDH, 4, 0, 0);
+            expect(e, 0xFFFF);
+        } else if (strcmp(w, "multicast") == 0) {
+            emit(e, PF_LDB, 0, 0, 0);
+            emit(e, PF_JSET, 0x01, 0, FAIL);
+        } else if (strcmp(w, "udp") == 0 || strcmp(w, "tcp") == 0) {
+            if (i + 1 >= nt) return false;
+            bool dst = strcmp(tok[i], "dst") == 0;
+            if (!dst && strcmp(tok[i], "src") != 0) return false;
+            if (!parse_num(tok[i + 1], &v) || v > 0xFFFF) return false;
+            i += 2;
+            emit_port(e, w[0] == 'u' ? 17 : 6, dst, v);
+        } else if (strcmp(w, "icmp6") == 0) {
+            if (i + 1 >= nt || strcmp(tok[i], "type") != 0 || !parse_num(tok[i + 1], &v)) return false;
+            i += 2;
+            emit_ethertype(e);
+            expect(e, 0x86DD);
+            emit(e, PF_LDBX, 2 + 6, 0, 0);
+            expect(e, 58);
+            emit(e, PF_LDBX, 2 + 40, 0, 0);
+            expect(e, v);
+        } else if (strcmp(w, "byte") == 0 || strcmp(w, "half") == 0 || strcmp(w, "word") == 0) {
+            // OFF[&MASK]=VAL as one token
+            if (i >= nt) return false;
+            char *spec = tok[i++];
+            char *eq = strchr(spec, '=');
+            if (!eq) return false;
+            *eq = '\0';
+            char *amp = strchr(spec, '&');
+            if (amp) {
+                *amp = '\0';
+                if (!parse_num(amp + 1, &m)) return false;
+            }
+            if (!parse_num(spec, &off) || !parse_num(eq + 1, &v) || off > WB_PF_LDMAX) return false;
+            emit(e, w[0] == 'b' ? PF_LDB : (w[0] == 'h' ? PF_LDH : PF_LDW), off, 0, 0);
+            if (amp) emit(e, PF_AND, m, 0, 0);
+            expect(e, v);
+        } else {
+            return false;
+        }
+
+        if (i < nt) {
+            if (strcmp(tok[i], "and") != 0) return false;
+            i++;
+            if (i >= nt) return false;
+        }
+    }
+
+    int ok = emit(e, PF_RET, 1, 0, 0);
+    int fail = emit(e, PF_RET, 0, 0, 0);
+    if (ok < 0 || fail < 0) return false;
+
+    for (int k = 0; k < fail; k++) {
+        pf_insn_t *in = &e->p[k];
+        if (in->jf == FAIL) in->jf = (uint8_t)(fail - k - 1);
+    }
+    return true;
+}
+
+static bool compile(const char *src, pf_prog_t *out)
+{
+    static char buf[WB_PF_SRC_MAX];
+    memset(out, 0, sizeof(*out));
+
+    if (strlen(src) >= sizeof(buf)) return false;
+    strcpy(buf, src);
+
+    char *save = NULL;
+    int lineno = 0;
+    for (char *line = strtok_r(buf, ";\n", &save); line; line = strtok_r(NULL, ";\n", &save)) {
+        lineno++;
+        while (*line == ' ' || *line == '\t') line++;
+        if (*line == '\0' || *line == '#') continue;
+
+        if (out->n_rule >= WB_PF_MAX_RULES) {
+            ESP_LOGW(TAG, "rule %d: more than %d rules", lineno, WB_PF_MAX_RULES);
+            return false;
+        }
+
+        pf_rule_t *ru = &out->rule[out->n_rule];
+        strncpy(ru->text, line, sizeof(ru->text) - 1);
+
+        emit_t e = {
+            .p = &out->insn[out->n_insn],
+            .n = 0,
+            .cap = (uint16_t)(WB_PF_MAX_INSNS - out->n_insn),
+        };
+        if (!compile_rule(line, &e, ru)) {
+            ESP_LOGW(TAG, "rule %d: syntax error or over %d instructions: %s", lineno, WB_PF_MAX_INSNS, ru->text);
+            return false;
+        }
+        ru->start = out->n_insn;
+        ru->len = e.n;
+        out->n_insn = (uint16_t)(out->n_insn + e.n);
+        out->n_rule++;
+    }
+    return true;
+}
+
+// ---- rule sets for other users
+
+wb_pf_prog_t *wb_pf_prog_new(const char *text)
+{
+    if (!text) return NULL;
+    wb_pf_prog_t *p = calloc(1, sizeof(*p));
+    if (p && !compile(text, &p->p)) {
+        free(p);
+        p = NULL;
+    }
+    return p;
+}
+
+void wb_pf_prog_free(wb_pf_prog_t *p)
+{
+    free(p);
+}
+
+int wb_pf_prog_match(const wb_pf_prog_t *p, const uint8_t *f, uint16_t len)
+{
+    for (int r = 0; r < p->p.n_rule; r++) {
+        const pf_rule_t *ru = &p->p.rule[r];
+        if (run(&p->p.insn[ru->start], ru->len, f, len)) return ru->drop ? 0 : 1;
+    }
+    return -1;
+}
+
+#if CONFIG_WB_PF
+
+// ---- runtime control
+
+esp_err_t wb_pf_set_rules(const char *text, bool save)
+{
+    if (!text) return ESP_ERR_INVALID_ARG;
+
+    // callers are configuration paths, one at a time
+    wb_pf_prog_t *p = wb_pf_prog_new(text);
+    if (!p) return ESP_ERR_INVALID_ARG;
+
+    wb_pf_prog_t *old = __atomic_exchange_n(&s_live, p, __ATOMIC_SEQ_CST);
+    ESP_LOGI(TAG, "%u rules, %u instructions", p->p.n_rule, p->p.n_insn);
+
+    // readers that may hold old all counted in the generation before the flip
+    uint32_t g = __atomic_fetch_add(&s_gen, 1, __ATOMIC_SEQ_CST) & 1;
+    while (__atomic_load_n(&s_readers[g], __ATOMIC_ACQUIRE)) vTaskDelay(1);
+    wb_pf_prog_free(old);
+
+    if (!save) return ESP_OK;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WB_PF_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_str(h, WB_PF_NVS_KEY, text);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+void wb_pf_init(void)
+{
+    static char src[WB_PF_SRC_MAX];
+    size_t n = sizeof(src);
+    nvs_handle_t h;
+    bool loaded = false;
+
+    if (nvs_open(WB_PF_NVS_NS, NVS_READONLY, &h) == ESP_OK) {
+        loaded = nvs_get_str(h, WB_PF_NVS_KEY, src, &n) == ESP_OK;
+        nvs_close(h);
+    }
+
+    if (loaded && wb_pf_set_rules(src, false) == ESP_OK) return;
+    if (loaded) ESP_LOGW(TAG, "NVS rules invalid, using defaults");
+    if (wb_pf_set_rules(CONFIG_WB_PF_DEFAULT_RULES, false) != ESP_OK) {
+        ESP_LOGE(TAG, "default rules invalid, filter empty");
+    }
+}
+
+bool wb_pf_get_rule(int i, wb_pf_rule_stats_t *out)
+{
+    if (!out || i < 0) return false;
+
+    uint32_t g = read_begin();
+    const wb_pf_prog_t *p = __atomic_load_n(&s_live, __ATOMIC_SEQ_CST);
+    bool ok = p && i < p->p.n_rule;
+    if (ok) {
+        memcpy(out->text, p->p.rule[i].text, sizeof(out->text));
+        out->drop = p->p.rule[i].drop;
+        out->hits = __atomic_load_n(&p->hits[i], __ATOMIC_RELAXED);
+    }
+    read_end(g);
+    return ok;
+}
+
+void wb_pf_get_stats(wb_pf_stats_t *out)
+{
+    if (!out) return;
+
+    out->frames = __atomic_load_n(&s_frames, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&s_dropped, __ATOMIC_RELAXED);
+    uint32_t g = read_begin();
+    const wb_pf_prog_t *p = __atomic_load_n(&s_live, __ATOMIC_SEQ_CST);
+    out->rules = p ? p->p.n_rule : 0;
+    out->insns = p ? p->p.n_insn : 0;
+    read_end(g);
+}
+
+#endif // CONFIG_WB_PF
+#endif // CONFIG_WB_PF || CONFIG_WB_CAP
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+
+// Ethernet ingress filter. Rules are text, one per line or ';'-separated,
+// compiled once into forward-only bytecode; first matching rule wins,
+// no match = pass.
+//
+//   rule := ("drop" | "pass") term ("and" term)*
+//   term := "ip" | "ip6" | "arp" | "ether" TYPE
+//         | "broadcast" | "multicast"
+//         | ("udp" | "tcp") ("dst" | "src") PORT      (IPv4 and IPv6)
+//         | "icmp6" "type" N
+//         | ("byte" | "half" | "word") OFF ["&" MASK] "=" VAL
+//
+// e.g. "drop udp dst 5353; drop udp dst 1900; drop icmp6 type 134"
+// ip, ip6, arp, udp, tcp and icmp6 look past up to two VLAN tags; ether,
+// broadcast, multicast and byte offsets see the frame as it is.
+// Rules are kept in NVS ("wb_pf") and can be replaced at runtime (the
+// "pf" control command, wb_ctl.h) without stopping the RX path.
+
+#define WB_PF_MAX_RULES   8
+#define WB_PF_MAX_INSNS   96     // all rules together = per-frame bound
+#define WB_PF_TEXT_MAX    48     // rule text kept for stats
+
+typedef struct {
+    char     text[WB_PF_TEXT_MAX];
+    bool     drop;
+    uint32_t hits;
+} wb_pf_rule_stats_t;
+
+typedef struct {
+    uint32_t frames;         // frames evaluated
+    uint32_t dropped;
+    uint16_t rules;
+    uint16_t insns;          // compiled program size (worst case per frame)
+} wb_pf_stats_t;
+
+void wb_pf_init(void);
+
+// Compile and install; on a syntax error the old rules stay. save = NVS.
+// Blocks until no frame is still running the old rules.
+esp_err_t wb_pf_set_rules(const char *text, bool save);
+
+// ETH RX path: true = drop the frame
+bool wb_pf_drop(const uint8_t *frame, uint16_t len);
+
+bool wb_pf_get_rule(int i, wb_pf_rule_stats_t *out);
+void wb_pf_get_stats(wb_pf_stats_t *out);
+
+// Rule sets of the same language for other users (the packet capture
+// filter and trigger), compiled onto the heap; NULL = syntax error.
+typedef struct wb_pf_prog wb_pf_prog_t;
+
+wb_pf_prog_t *wb_pf_prog_new(const char *text);
+void wb_pf_prog_free(wb_pf_prog_t *p);
+
+// First matching rule: 1 = "pass", 0 = "drop"; -1 = no rule matched
+int wb_pf_prog_match(const wb_pf_prog_t *p, const uint8_t *frame, uint16_t len);
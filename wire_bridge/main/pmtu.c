@@ -0,0 +1,301 @@
+// pmtu.c — path MTU probing and loss-driven fragment size
+//
+// Sender side state machine, one probe in flight:
+//   search:   binary search [lo, hi] with padded probe datagrams; a size is
+//             good once acked, bad after WB_PMTU_TRIES unanswered probes
+//   validate: one probe at the path size every CONFIG_WB_PMTU_PROBE_MS;
+//             repeated losses search again below that size
+// The path size in use only moves on an ack: a search that gets none at
+// all means the peer is gone or silent, not that the path shrank.
+// Every ack carries the peer's cumulative reassembly counters. The loss
+// since the previous ack shrinks the size by 1/4 when the link is also
+// weak (RSSI), and three clean reports in a row grow it back by a step.
+
+#include "pmtu.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WB_PMTU
+
+static const char *TAG = "wb_pmtu";
+
+#define WB_PMTU_SEARCH_US   200000
+#define WB_PMTU_KEEP_US     ((int64_t)CONFIG_WB_PMTU_PROBE_MS * 1000)
+#define WB_PMTU_TRIES       2          // unanswered probes before a size is bad
+#define WB_PMTU_RESEARCH    3          // lost validation probes before a new search
+#define WB_PMTU_MIN_SAMPLES 8          // frames per report needed to judge loss
+#define WB_PMTU_SHRINK_PCT  5
+#define WB_PMTU_GROW_PCT    1
+#define WB_PMTU_GROW_STEP   128
+#define WB_PMTU_GROW_CLEAN  3
+
+#if CONFIG_WB_CRYPT
+#define WB_PMTU_SEAL        WB_SEC_OVERHEAD
+#else
+#define WB_PMTU_SEAL        0
+#endif
+
+#if CONFIG_WB_FEC
+// parity datagrams carry each unit's header on top of the payload
+#define WB_PMTU_CEIL        ((uint16_t)(WB_MTU_MAX - sizeof(wb_hdr_t) - sizeof(wb_fec_ext_t) - WB_PMTU_SEAL))
+#else
+#define WB_PMTU_CEIL        ((uint16_t)(WB_MTU_MAX - WB_PMTU_SEAL))
+#endif
+
+_Static_assert(WB_MTU >= WB_MTU_MIN && WB_MTU <= WB_PMTU_CEIL, "WB_MAX_PAYLOAD out of range");
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// TX path
+static volatile uint16_t s_cur = WB_MTU;
+static uint16_t s_path = WB_MTU;
+static uint16_t s_cap = WB_PMTU_CEIL;
+static uint16_t s_lo, s_hi;
+static bool     s_search;
+static bool     s_search_acked;   // some size answered during this search
+
+// probe in flight
+static uint16_t s_id;
+static uint16_t s_size;        // 0 = none
+static bool     s_acked;
+static int64_t  s_t_us;
+static uint8_t  s_tries;
+
+// peer loss reports
+static uint32_t s_ok_prev, s_lost_prev;
+static bool     s_have_prev;
+static uint8_t  s_clean;
+static volatile int s_rssi;
+
+// RX path: ack owed to the peer
+static bool     s_ack_req;
+static uint16_t s_ack_id, s_ack_size;
+
+static wb_pmtu_stats_t s_st;
+
+static void update_cur(void)
+{
+    uint16_t c = s_path < s_cap ? s_path : s_cap;
+    s_cur = c < WB_MTU_MIN ? WB_MTU_MIN : c;
+}
+
+// lo is taken as good without a probe; s_path stays until an ack
+static void search_start(uint16_t lo, uint16_t hi)
+{
+    s_search = true;
+    s_search_acked = false;
+    s_lo = lo;
+    s_hi = hi;
+    s_tries = 0;
+}
+
+void wb_pmtu_init(void)
+{
+    taskENTER_CRITICAL(&s_lock);
+    s_cap = WB_PMTU_CEIL;
+    s_size = 0;
+    s_have_prev = false;
+    s_clean = 0;
+    s_ack_req = false;
+    s_path = WB_MTU;
+    search_start(WB_MTU, WB_PMTU_CEIL);
+    s_cur = WB_MTU;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+uint16_t wb_pmtu_get(void)
+{
+    return s_cur;
+}
+
+void wb_pmtu_set_rssi(int rssi)
+{
+    s_rssi = rssi;
+}
+
+void wb_pmtu_on_probe(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_pmtu_probe_t)) return;
+
+    wb_pmtu_probe_t pr;
+    memcpy(&pr, p, sizeof(pr));
+    if (pr.size != n) return;      // truncated on the way
+
+    taskENTER_CRITICAL(&s_lock);
+    s_ack_req = true;
+    s_ack_id = pr.id;
+    s_ack_size = pr.size;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// Called with s_lock held
+static void loss_report(uint32_t ok, uint32_t lost)
+{
+    if (!s_have_prev) {
+        s_have_prev = true;
+        s_ok_prev = ok;
+        s_lost_prev = lost;
+        return;
+    }
+
+    uint32_t d_ok = ok - s_ok_prev, d_lost = lost - s_lost_prev;
+    uint32_t tot = d_ok + d_lost;
+    if (tot < WB_PMTU_MIN_SAMPLES) return;   // keep accumulating
+
+    s_ok_prev = ok;
+    s_lost_prev = lost;
+    s_st.loss_pct = (uint8_t)(d_lost * 100u / tot);
+
+    int rssi = s_rssi;
+    // 0 = unknown RSSI: not weak, unless any RSSI is (threshold 0)
+    bool weak = CONFIG_WB_PMTU_RSSI_WEAK == 0 || (rssi != 0 && rssi < CONFIG_WB_PMTU_RSSI_WEAK);
+
+    if (s_st.loss_pct >= WB_PMTU_SHRINK_PCT && weak) {
+        uint16_t c = (uint16_t)(s_cur * 3 / 4);
+        s_cap = c < WB_MTU_MIN ? WB_MTU_MIN : c;
+        s_clean = 0;
+        s_st.shrinks++;
+    } else if (s_st.loss_pct <= WB_PMTU_GROW_PCT) {
+        if (++s_clean >= WB_PMTU_GROW_CLEAN && s_cap < WB_PMTU_CEIL) {
+            s_cap = (uint16_t)(s_cap + WB_PMTU_GROW_STEP);
+            if (s_cap > WB_PMTU_CEIL) s_cap = WB_PMTU_CEIL;
+            s_clean = 0;
+            s_st.grows++;
+        }
+    } else {
+        s_clean = 0;
+    }
+}
+
+void wb_pmtu_on_ack(const uint8_t *p, int n)
+{
+    if (n < (int)sizeof(wb_pmtu_ack_t)) return;
+
+    wb_pmtu_ack_t a;
+    memcpy(&a, p, sizeof(a));
+
+    taskENTER_CRITICAL(&s_lock);
+    if (s_size && !s_acked && a.id == s_id && a.size == s_size) {
+        s_acked = true;
+        s_tries = 0;
+        s_st.acks_rx++;
+        if (s_search) {
+            // proven: in a search below a failed size this is the first
+            // working size, above the start a larger one
+            s_lo = a.size;
+            s_path = a.size;
+            s_search_acked = true;
+        } else if (a.size > s_path) {
+            s_path = a.size;
+        }
+    }
+    loss_report(a.frames_ok, a.frames_lost);
+    update_cur();
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// Called with s_lock held: the probe in flight went unanswered
+static void probe_lost(void)
+{
+    s_st.probes_lost++;
+    s_tries++;
+
+    if (s_search) {
+        if (s_tries >= WB_PMTU_TRIES) {
+            s_hi = (uint16_t)(s_size - 1);
+            s_tries = 0;
+        }
+    } else if (s_tries >= WB_PMTU_RESEARCH) {
+        // path narrowed, or the peer is gone: search below the failed size
+        if (s_path > WB_MTU_MIN) search_start(WB_MTU_MIN, (uint16_t)(s_path - 1));
+        else search_start(WB_MTU_MIN, WB_PMTU_CEIL);
+    }
+}
+
+uint16_t wb_pmtu_build_probe(uint8_t *buf)
+{
+    int64_t now = esp_timer_get_time();
+    uint16_t size = 0;
+
+    taskENTER_CRITICAL(&s_lock);
+
+    bool due;
+    int64_t age = now - s_t_us;
+    if (!s_size) {
+        due = true;
+    } else if (!s_acked) {
+        due = age >= (s_search ? WB_PMTU_SEARCH_US : WB_PMTU_KEEP_US);
+        if (due) probe_lost();
+    } else {
+        due = s_search || age >= WB_PMTU_KEEP_US;
+    }
+
+    if (due) {
+        if (s_search && s_lo >= s_hi) {
+            s_search = false;
+            // not one ack: the peer is away, the path size stands
+            if (s_search_acked) s_path = s_lo;
+            else s_st.silent++;
+        }
+        size = s_search ? (uint16_t)((s_lo + s_hi + 1) / 2) : s_path;
+        s_id++;
+        s_size = size;
+        s_acked = false;
+        s_t_us = now;
+        s_st.probes_tx++;
+    }
+    update_cur();
+
+    uint16_t cur = s_cur;
+    taskEXIT_CRITICAL(&s_lock);
+
+    static uint16_t s_logged = WB_MTU;
+    if (cur != s_logged) {
+        ESP_LOGI(TAG, "fragment size %u -> %u", s_logged, cur);
+        s_logged = cur;
+    }
+
+    if (!size) return 0;
+
+    wb_pmtu_probe_t pr = { .type = WB_CTRL_PMTU_PROBE, .id = s_id, .size = size };
+    memset(buf, 0, size);
+    memcpy(buf, &pr, sizeof(pr));
+    return size;
+}
+
+bool wb_pmtu_build_ack(wb_pmtu_ack_t *out, uint32_t frames_ok, uint32_t frames_lost)
+{
+    taskENTER_CRITICAL(&s_lock);
+    bool req = s_ack_req;
+    s_ack_req = false;
+    uint16_t id = s_ack_id, size = s_ack_size;
+    taskEXIT_CRITICAL(&s_lock);
+
+    if (!req) return false;
+
+    memset(out, 0, sizeof(*out));
+    out->type = WB_CTRL_PMTU_ACK;
+    out->id = id;
+    out->size = size;
+    out->frames_ok = frames_ok;
+    out->frames_lost = frames_lost;
+    return true;
+}
+
+void wb_pmtu_get_stats(wb_pmtu_stats_t *out)
+{
+    if (!out) return;
+    taskENTER_CRITICAL(&s_lock);
+    *out = s_st;
+    out->cur = s_cur;
+    out->path = s_path;
+    out->cap = s_cap;
+    out->searching = s_search;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+#endif // CONFIG_WB_PMTU
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "wb_proto.h"
+
+// Runtime fragment size. Each side binary-searches the largest fragment
+// payload the peer acknowledges (up to WB_MTU_MAX, one unfragmented IP
+// packet), then keeps probing at that size. Acks carry the peer's
+// reassembly loss; high loss on a weak link shrinks the size, a clean
+// link grows it back.
+
+typedef struct {
+    uint16_t cur;            // fragment payload in use
+    uint16_t path;           // largest size acked by the peer
+    uint16_t cap;            // loss-driven limit
+    bool     searching;
+    uint8_t  loss_pct;       // last reported peer reassembly loss
+    uint32_t probes_tx;
+    uint32_t acks_rx;
+    uint32_t probes_lost;
+    uint32_t silent;         // searches without a single ack: peer away
+    uint32_t shrinks;
+    uint32_t grows;
+} wb_pmtu_stats_t;
+
+void     wb_pmtu_init(void);
+uint16_t wb_pmtu_get(void);              // TX fragment payload size
+void     wb_pmtu_set_rssi(int rssi);     // 0 = unknown
+
+// RX context
+void wb_pmtu_on_probe(const uint8_t *p, int n);
+void wb_pmtu_on_ack(const uint8_t *p, int n);
+
+// udp_tx_task: probe to send (buf has WB_MTU_MAX bytes), 0 = none due
+uint16_t wb_pmtu_build_probe(uint8_t *buf);
+bool     wb_pmtu_build_ack(wb_pmtu_ack_t *out, uint32_t frames_ok, uint32_t frames_lost);
+
+void wb_pmtu_get_stats(wb_pmtu_stats_t *out);
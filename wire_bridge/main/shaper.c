@@ -0,0 +1,230 @@
+// shaper.c — token-bucket shapers in front of tunnel encapsulation
+//
+// Tokens are bytes. Refill is computed lazily from esp_timer time when a
+// bucket is looked at; the refill clock only advances by whole bytes so
+// low rates do not lose their fractions.
+
+#include "shaper.h"
+#include "wb_proto.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+
+#if CONFIG_WB_SHAPE
+
+static const char *TAG = "wb_shape";
+
+#define WB_SHAPE_NVS_NS   "wb_shape"
+#define WB_SHAPE_NVS_KEY  "cfg"
+#define WB_SHAPE_NVS_VER  1
+
+typedef struct {
+    uint8_t        ver;
+    uint8_t        delay;
+    wb_shape_cfg_t cfg[WB_SHAPE_BUCKETS];
+} shape_blob_t;
+
+typedef struct {
+    wb_shape_cfg_t   cfg;
+    int64_t          t_us;     // refill clock
+    uint32_t         tokens;
+    bool             blocked;  // head frame is being held (DELAY)
+    wb_shape_stats_t st;
+} bucket_t;
+
+static bucket_t s_b[WB_SHAPE_BUCKETS];
+#if CONFIG_WB_SHAPE_POLICY_DELAY
+static bool     s_delay = true;
+#else
+static bool     s_delay = false;
+#endif
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void refill(bucket_t *b, int64_t now)
+{
+    uint32_t kbps = b->cfg.rate_kbps;
+    int64_t dt = now - b->t_us;
+    if (dt <= 0) return;
+
+    // bytes = us * kbps / 8000
+    uint64_t add = ((uint64_t)dt * kbps) / 8000u;
+    if (add == 0) return;
+
+    if (b->tokens + add >= b->cfg.burst) {
+        b->tokens = b->cfg.burst;
+        b->t_us = now;
+    } else {
+        b->tokens += (uint32_t)add;
+        b->t_us += (int64_t)(add * 8000u / kbps);
+    }
+}
+
+// 0 = fits, else us until it does
+static uint32_t need_us(bucket_t *b, uint16_t len, int64_t now)
+{
+    if (!b->cfg.rate_kbps) return 0;
+    refill(b, now);
+    if (b->tokens >= len) return 0;
+    return (uint32_t)(((uint64_t)(len - b->tokens) * 8000u + b->cfg.rate_kbps - 1) / b->cfg.rate_kbps);
+}
+
+static void take(bucket_t *b, uint16_t len)
+{
+    if (!b->cfg.rate_kbps) return;
+    b->tokens = (b->tokens > len) ? b->tokens - len : 0;
+}
+
+static inline bool is_group(const uint8_t *f)
+{
+    return f[0] & 0x01;
+}
+
+bool wb_shape_police(wb_tc_t tc, const uint8_t *f, uint16_t len)
+{
+    if (s_delay) return true;
+
+    int64_t now = esp_timer_get_time();
+    bucket_t *c = &s_b[tc];
+    bucket_t *g = is_group(f) ? &s_b[WB_SHAPE_BCAST] : NULL;
+
+    taskENTER_CRITICAL(&s_lock);
+    bool ok = need_us(c, len, now) == 0 && (!g || need_us(g, len, now) == 0);
+    if (ok) {
+        take(c, len);
+        c->st.passed++;
+        if (g) {
+            take(g, len);
+            g->st.passed++;
+        }
+    } else {
+        c->st.dropped++;
+        if (g) g->st.dropped++;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+uint32_t wb_shape_delay(wb_tc_t tc, const uint8_t *f, uint16_t len)
+{
+    if (!s_delay) return 0;
+
+    int64_t now = esp_timer_get_time();
+    bucket_t *c = &s_b[tc];
+    bucket_t *g = is_group(f) ? &s_b[WB_SHAPE_BCAST] : NULL;
+
+    taskENTER_CRITICAL(&s_lock);
+    uint32_t w = need_us(c, len, now);
+    if (g) {
+        uint32_t wg = need_us(g, len, now);
+        if (wg > w) w = wg;
+    }
+    if (w == 0) {
+        take(c, len);
+        c->st.passed++;
+        if (c->blocked) c->st.delayed++;
+        c->blocked = false;
+        if (g) {
+            take(g, len);
+            g->st.passed++;
+            if (g->blocked) g->st.delayed++;
+            g->blocked = false;
+        }
+    } else {
+        // the TX task retries the same head frame; count it when it goes
+        c->blocked = true;
+        if (g) g->blocked = true;
+    }
+    taskEXIT_CRITICAL(&s_lock);
+    return w;
+}
+
+static esp_err_t save(void)
+{
+    shape_blob_t blob = { .ver = WB_SHAPE_NVS_VER, .delay = s_delay };
+
+    taskENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < WB_SHAPE_BUCKETS; i++) blob.cfg[i] = s_b[i].cfg;
+    taskEXIT_CRITICAL(&s_lock);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WB_SHAPE_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, WB_SHAPE_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+esp_err_t wb_shape_set(int bucket, uint32_t rate_kbps, uint32_t burst, bool persist)
+{
+    if (bucket < 0 || bucket >= WB_SHAPE_BUCKETS) return ESP_ERR_INVALID_ARG;
+    if (rate_kbps && burst < WB_MAX_FRAME) burst = WB_MAX_FRAME;    // any frame must fit
+
+    bucket_t *b = &s_b[bucket];
+    taskENTER_CRITICAL(&s_lock);
+    b->cfg.rate_kbps = rate_kbps;
+    b->cfg.burst = burst;
+    b->tokens = burst;
+    b->t_us = esp_timer_get_time();
+    taskEXIT_CRITICAL(&s_lock);
+
+    return persist ? save() : ESP_OK;
+}
+
+esp_err_t wb_shape_set_delay(bool delay, bool persist)
+{
+    s_delay = delay;
+    return persist ? save() : ESP_OK;
+}
+
+bool wb_shape_get_delay(void)
+{
+    return s_delay;
+}
+
+void wb_shape_get(int bucket, wb_shape_cfg_t *cfg, wb_shape_stats_t *st)
+{
+    if (bucket < 0 || bucket >= WB_SHAPE_BUCKETS) return;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (cfg) *cfg = s_b[bucket].cfg;
+    if (st) *st = s_b[bucket].st;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+void wb_shape_init(void)
+{
+    static const uint32_t def_kbps[WB_SHAPE_BUCKETS] = {
+        CONFIG_WB_SHAPE_RT_KBPS,
+        CONFIG_WB_SHAPE_CTRL_KBPS,
+        CONFIG_WB_SHAPE_BE_KBPS,
+        CONFIG_WB_SHAPE_BULK_KBPS,
+        CONFIG_WB_SHAPE_BCAST_KBPS,
+    };
+
+    shape_blob_t blob;
+    size_t n = sizeof(blob);
+    nvs_handle_t h;
+    bool loaded = false;
+    if (nvs_open(WB_SHAPE_NVS_NS, NVS_READONLY, &h) == ESP_OK) {
+        loaded = nvs_get_blob(h, WB_SHAPE_NVS_KEY, &blob, &n) == ESP_OK &&
+                 n == sizeof(blob) && blob.ver == WB_SHAPE_NVS_VER;
+        nvs_close(h);
+    }
+
+    if (loaded) s_delay = blob.delay;
+    for (int i = 0; i < WB_SHAPE_BUCKETS; i++) {
+        if (loaded) wb_shape_set(i, blob.cfg[i].rate_kbps, blob.cfg[i].burst, false);
+        else wb_shape_set(i, def_kbps[i], CONFIG_WB_SHAPE_BURST_KB * 1024u, false);
+    }
+
+    ESP_LOGI(TAG, "shaper: %s, policy=%s, bcast=%lu kbps", loaded ? "NVS" : "defaults",
+             s_delay ? "delay" : "drop", (unsigned long)s_b[WB_SHAPE_BCAST].cfg.rate_kbps);
+}
+
+#endif // CONFIG_WB_SHAPE
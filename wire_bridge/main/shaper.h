@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "txq.h"
+
+// Token-bucket shaping per traffic class plus one bucket for
+// broadcast/multicast (a group frame must fit both). Policy DROP polices
+// at enqueue; DELAY holds the frame in its class queue until it fits.
+// Limits live in NVS ("wb_shape") and can be changed at runtime.
+
+#define WB_SHAPE_BCAST    WB_TC_COUNT          // bucket index for group frames
+#define WB_SHAPE_BUCKETS  (WB_TC_COUNT + 1)
+
+typedef struct {
+    uint32_t rate_kbps;    // 0 = unlimited
+    uint32_t burst;        // bucket size, bytes
+} wb_shape_cfg_t;
+
+typedef struct {
+    uint32_t passed;       // frames that fit the bucket
+    uint32_t delayed;      // of passed, frames that had to wait (DELAY)
+    uint32_t dropped;      // frames dropped (DROP)
+} wb_shape_stats_t;
+
+void wb_shape_init(void);
+
+// Producers: false = drop (DROP policy only; always true with DELAY)
+bool wb_shape_police(wb_tc_t tc, const uint8_t *frame, uint16_t len);
+
+// udp_tx_task: 0 = send now (tokens taken), else us until it fits (DELAY only)
+uint32_t wb_shape_delay(wb_tc_t tc, const uint8_t *frame, uint16_t len);
+
+// Runtime control; save = also write to NVS
+esp_err_t wb_shape_set(int bucket, uint32_t rate_kbps, uint32_t burst, bool save);
+esp_err_t wb_shape_set_delay(bool delay, bool save);
+bool      wb_shape_get_delay(void);
+
+void wb_shape_get(int bucket, wb_shape_cfg_t *cfg, wb_shape_stats_t *st);
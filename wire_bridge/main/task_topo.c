@@ -0,0 +1,300 @@
+// task_topo.c — stage placement (core, priority, stack) and per-stage CPU time
+#include "task_topo.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "wb_topo";
+
+#define WB_TOPO_NVS_NS   "wb_topo"
+#define WB_TOPO_NVS_KEY  "spec"
+#define WB_TOPO_SRC_MAX  192
+
+// CPU time needs the FreeRTOS run-time counters in microseconds
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS && CONFIG_FREERTOS_RUN_TIME_STATS_USING_ESP_TIMER
+#define WB_TOPO_CPU 1
+#else
+#define WB_TOPO_CPU 0
+#endif
+
+#if CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_1
+#define WB_WIFI_CORE 1
+#elif CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0
+#define WB_WIFI_CORE 0
+#else
+#define WB_WIFI_CORE WB_CORE_ANY
+#endif
+
+typedef struct {
+    const char    *name;     // in topology text
+    const char    *task;     // FreeRTOS task name
+    bool           fixed;    // placed by its driver's sdkconfig options
+    wb_stage_cfg_t def;
+} stage_def_t;
+
+// Built-in placement: what the tasks were created with before topologies
+static const stage_def_t k_stage[WB_STAGE_N] = {
+    [WB_STAGE_UDP_RX]  = { "udp_rx",  "wb_udp_rx", false, { WB_CORE_ANY, 18, 4096 } },
+    [WB_STAGE_UDP_TX]  = { "udp_tx",  "wb_udp_tx", false, { WB_CORE_ANY, 18, 4096 } },
+    [WB_STAGE_ETH_RX]  = { "eth_rx",  "emac_rx",   false, { WB_CORE_ANY, 15, 4096 } },  // ETH_MAC_DEFAULT_CONFIG
+    [WB_STAGE_STATUS]  = { "status",  "status",    false, { WB_CORE_ANY, 10, 4096 } },
+    [WB_STAGE_BUTTONS] = { "buttons", "buttons",   false, { WB_CORE_ANY, 12, 2048 } },
+    [WB_STAGE_UI]      = { "ui",      "taskLVGL",  false, { WB_CORE_ANY, 4, 7168 } },   // ESP_LVGL_PORT_INIT_CONFIG
+    [WB_STAGE_CAP]     = { "cap",     "wb_cap",    false, { WB_CORE_ANY, 2, 4096 } },
+    [WB_STAGE_WIFI]    = { "wifi",    "wifi",      true,  { WB_WIFI_CORE, 0, 0 } },
+};
+
+static bool s_loaded = false;
+static wb_stage_cfg_t s_cfg[WB_STAGE_N];
+
+static TaskHandle_t s_task[WB_STAGE_N];
+static uint32_t s_rt_last[WB_STAGE_N];   // run-time counter at the last poll
+static uint64_t s_cpu_us[WB_STAGE_N];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// ---- topology text
+
+static int stage_find(const char *name, size_t n)
+{
+    for (int i = 0; i < WB_STAGE_N; i++) {
+        if (strlen(k_stage[i].name) == n && memcmp(k_stage[i].name, name, n) == 0) return i;
+    }
+    return -1;
+}
+
+// "123" -> 123; false on anything else or > max
+static bool parse_uint(const char *s, size_t n, long max, long *out)
+{
+    if (n == 0 || n > 6) return false;
+    long v = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    if (v > max) return false;
+    *out = v;
+    return true;
+}
+
+// entry = stage:core:prio:stack
+static bool parse_entry(const char *s, size_t n, wb_stage_cfg_t *cfg)
+{
+    const char *f[4];
+    size_t fl[4];
+    int nf = 0;
+    const char *p = s, *end = s + n;
+
+    while (nf < 4) {
+        const char *c = memchr(p, ':', (size_t)(end - p));
+        if (!c) c = end;
+        f[nf] = p;
+        fl[nf] = (size_t)(c - p);
+        nf++;
+        if (c == end) break;
+        p = c + 1;
+    }
+    if (nf != 4 || f[3] + fl[3] != end) {
+        ESP_LOGE(TAG, "'%.*s': want stage:core:prio:stack", (int)n, s);
+        return false;
+    }
+
+    int st = stage_find(f[0], fl[0]);
+    if (st < 0 || k_stage[st].fixed) {
+        ESP_LOGE(TAG, "'%.*s': %s stage", (int)n, s, st < 0 ? "unknown" : "fixed");
+        return false;
+    }
+
+    wb_stage_cfg_t c = k_stage[st].def;
+    long core, prio, stack;
+    if (fl[1] == 3 && memcmp(f[1], "any", 3) == 0) {
+        core = WB_CORE_ANY;
+    } else if (!parse_uint(f[1], fl[1], portNUM_PROCESSORS - 1, &core)) {
+        ESP_LOGE(TAG, "'%.*s': core is 0..%d or any", (int)n, s, portNUM_PROCESSORS - 1);
+        return false;
+    }
+    if (!parse_uint(f[2], fl[2], configMAX_PRIORITIES - 1, &prio) ||
+        !parse_uint(f[3], fl[3], 65535, &stack) || (stack && stack < 1024)) {
+        ESP_LOGE(TAG, "'%.*s': prio 0..%d, stack 0 or 1024..65535", (int)n, s, configMAX_PRIORITIES - 1);
+        return false;
+    }
+
+    c.core = (int8_t)core;
+    if (prio) c.prio = (uint8_t)prio;
+    if (stack) c.stack = (uint16_t)stack;
+    cfg[st] = c;
+    return true;
+}
+
+static bool parse(const char *text, wb_stage_cfg_t *cfg)
+{
+    for (int i = 0; i < WB_STAGE_N; i++) cfg[i] = k_stage[i].def;
+
+    const char *p = text;
+    while (*p) {
+        size_t sep = strspn(p, " \t\r\n;,");
+        p += sep;
+        size_t n = strcspn(p, " \t\r\n;,");
+        if (n == 0) break;
+        if (!parse_entry(p, n, cfg)) return false;
+        p += n;
+    }
+    return true;
+}
+
+static void topo_load(void)
+{
+    if (s_loaded) return;
+    s_loaded = true;
+    for (int i = 0; i < WB_STAGE_N; i++) s_cfg[i] = k_stage[i].def;
+
+    static char src[WB_TOPO_SRC_MAX];
+    size_t n = sizeof(src);
+    nvs_handle_t h;
+    bool loaded = false;
+
+    if (nvs_open(WB_TOPO_NVS_NS, NVS_READONLY, &h) == ESP_OK) {
+        loaded = nvs_get_str(h, WB_TOPO_NVS_KEY, src, &n) == ESP_OK;
+        nvs_close(h);
+    }
+
+    if (loaded && wb_topo_set(src, false) == ESP_OK) return;
+    if (loaded) ESP_LOGW(TAG, "NVS topology invalid, using WB_TOPO");
+    if (wb_topo_set(CONFIG_WB_TOPO, false) != ESP_OK) {
+        ESP_LOGE(TAG, "WB_TOPO invalid, built-in placement");
+    }
+}
+
+esp_err_t wb_topo_set(const char *text, bool save)
+{
+    if (!text || strlen(text) >= WB_TOPO_SRC_MAX) return ESP_ERR_INVALID_ARG;
+    topo_load();
+
+    wb_stage_cfg_t cfg[WB_STAGE_N];
+    if (!parse(text, cfg)) return ESP_ERR_INVALID_ARG;
+    memcpy(s_cfg, cfg, sizeof(s_cfg));
+    if (*text) ESP_LOGI(TAG, "topology: %s", text);
+
+    if (!save) return ESP_OK;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(WB_TOPO_NVS_NS, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_str(h, WB_TOPO_NVS_KEY, text);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+const wb_stage_cfg_t *wb_topo_get(wb_stage_t st)
+{
+    topo_load();
+    return &s_cfg[st < WB_STAGE_N ? st : 0];
+}
+
+const char *wb_topo_name(wb_stage_t st)
+{
+    return st < WB_STAGE_N ? k_stage[st].name : "?";
+}
+
+// ---- tasks
+
+BaseType_t wb_task_create(wb_stage_t st, TaskFunction_t fn, void *arg, TaskHandle_t *out)
+{
+    const wb_stage_cfg_t *c = wb_topo_get(st);
+    TaskHandle_t h = NULL;
+
+    BaseType_t r = xTaskCreatePinnedToCore(fn, k_stage[st].task, c->stack, arg, c->prio, &h,
+                                           c->core == WB_CORE_ANY ? tskNO_AFFINITY : c->core);
+    if (r == pdPASS) {
+        wb_topo_adopt(st, h);
+    } else {
+        ESP_LOGE(TAG, "%s: task not created (stack %u)", k_stage[st].name, c->stack);
+    }
+    if (out) *out = h;
+    return r;
+}
+
+void wb_topo_adopt(wb_stage_t st, TaskHandle_t h)
+{
+    if (st >= WB_STAGE_N) return;
+    if (!h) h = xTaskGetHandle(k_stage[st].task);
+    if (!h) {
+        ESP_LOGW(TAG, "%s: no task '%s', not accounted", k_stage[st].name, k_stage[st].task);
+        return;
+    }
+    taskENTER_CRITICAL(&s_lock);
+    s_task[st] = h;
+    s_rt_last[st] = 0;      // counters run from the task's creation
+    s_cpu_us[st] = 0;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+typedef struct {
+    esp_err_t  (*fn)(void *);
+    void        *arg;
+    esp_err_t    err;
+    TaskHandle_t caller;
+} call_t;
+
+static void call_task(void *p)
+{
+    call_t *c = (call_t *)p;
+    c->err = c->fn(c->arg);
+    xTaskNotifyGive(c->caller);
+    vTaskDelete(NULL);
+}
+
+esp_err_t wb_topo_call_on(wb_stage_t st, esp_err_t (*fn)(void *), void *arg)
+{
+    int core = wb_topo_get(st)->core;
+    if (core == WB_CORE_ANY || core == xPortGetCoreID()) return fn(arg);
+
+    call_t c = { .fn = fn, .arg = arg, .err = ESP_FAIL, .caller = xTaskGetCurrentTaskHandle() };
+    if (xTaskCreatePinnedToCore(call_task, "wb_topo_call", 4096, &c, uxTaskPriorityGet(NULL),
+                                NULL, core) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return c.err;
+}
+
+// ---- accounting
+
+bool wb_topo_cpu_stats(void)
+{
+    return WB_TOPO_CPU;
+}
+
+bool wb_topo_get_stats(wb_stage_t st, wb_stage_stats_t *out)
+{
+    if (!out || st >= WB_STAGE_N) return false;
+    topo_load();
+
+    taskENTER_CRITICAL(&s_lock);
+    TaskHandle_t h = s_task[st];
+    taskEXIT_CRITICAL(&s_lock);
+
+    out->name = k_stage[st].name;
+    out->cfg = s_cfg[st];
+    out->running = h != NULL;
+    out->stack_free = h ? (uint32_t)uxTaskGetStackHighWaterMark(h) : 0;
+
+#if WB_TOPO_CPU
+    uint32_t now = h ? (uint32_t)ulTaskGetRunTimeCounter(h) : 0;
+#endif
+    taskENTER_CRITICAL(&s_lock);
+#if WB_TOPO_CPU
+    // a concurrent poll may have read a later value: never step back
+    uint32_t d = now - s_rt_last[st];
+    if (h == s_task[st] && d < 0x80000000u) {
+        s_cpu_us[st] += d;
+        s_rt_last[st] = now;
+    }
+#endif
+    out->cpu_us = s_cpu_us[st];
+    taskEXIT_CRITICAL(&s_lock);
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Task topology: pinned core, priority and stack for each pipeline stage.
+// Text, one entry per stage, space- or ';'-separated:
+//
+//   entry := STAGE ":" CORE ":" PRIO ":" STACK      CORE = 0, 1 or "any"
+//
+// e.g. "udp_rx:1:18:4096 udp_tx:1:18:4096 eth_rx:1:15:0 ui:0:4:0"
+// Stages not listed keep their built-in placement; PRIO or STACK 0 = the
+// built-in value. Kept in NVS ("wb_topo") over WB_TOPO, read once: a new
+// topology applies from the next start.
+
+typedef enum {
+    WB_STAGE_UDP_RX,     // transport receive task (socket transports)
+    WB_STAGE_UDP_TX,     // udp_tx_task: queues, codecs, send
+    WB_STAGE_ETH_RX,     // EMAC RX task, runs the bridge_core.c ingress
+    WB_STAGE_STATUS,
+    WB_STAGE_BUTTONS,
+    WB_STAGE_UI,         // esp_lvgl_port task
+    WB_STAGE_CAP,        // capture ring -> pcapng files on SPIFFS
+    WB_STAGE_WIFI,       // driver task, placed by sdkconfig: accounting only
+    WB_STAGE_N,
+} wb_stage_t;
+
+#define WB_CORE_ANY (-1)
+
+typedef struct {
+    int8_t   core;       // WB_CORE_ANY = not pinned
+    uint8_t  prio;
+    uint16_t stack;      // bytes
+} wb_stage_cfg_t;
+
+typedef struct {
+    const char    *name;
+    wb_stage_cfg_t cfg;
+    bool           running;      // task created or adopted
+    uint32_t       stack_free;   // high-water mark, bytes
+    uint64_t       cpu_us;       // run time since start; 0 without run-time stats
+} wb_stage_stats_t;
+
+// Parse and install for tasks created from now on; save = NVS
+esp_err_t wb_topo_set(const char *text, bool save);
+
+const wb_stage_cfg_t *wb_topo_get(wb_stage_t st);
+const char *wb_topo_name(wb_stage_t st);
+
+// xTaskCreatePinnedToCore() with the stage's placement, registered for
+// accounting
+BaseType_t wb_task_create(wb_stage_t st, TaskFunction_t fn, void *arg, TaskHandle_t *out);
+
+// Account a task some driver created for the stage; h = NULL looks it up
+// by the driver's task name
+void wb_topo_adopt(wb_stage_t st, TaskHandle_t h);
+
+// Run fn on the stage's core, for drivers that pin their task to the
+// caller's core; blocks until it returns
+esp_err_t wb_topo_call_on(wb_stage_t st, esp_err_t (*fn)(void *), void *arg);
+
+// true = CPU time is measured (FreeRTOS run-time stats on esp_timer)
+bool wb_topo_cpu_stats(void);
+
+// Call at least once an hour: the run-time counters are 32-bit
+bool wb_topo_get_stats(wb_stage_t st, wb_stage_stats_t *out);
@@ -0,0 +1,57 @@
+#pragma once
+// transport.h — datagram transport under the tunnel
+//
+// udp_tunnel.c hands a backend complete datagrams (header, optional
+// extension, payload slice) and gets whole datagrams back. Peers are named
+// by node number, the last octet of their 192.168.50.x tunnel address,
+// whatever the backend uses underneath. One backend is picked in Kconfig
+// (CONFIG_WB_TRANSPORT_*).
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Datagram pieces in wire order
+typedef struct {
+    const void *p;
+    size_t      len;
+} wb_seg_t;
+
+#define WB_SEG_MAX 3
+
+// One received datagram from node `from` (0 = not a tunnel address);
+// p is only valid during the call
+typedef void (*wb_tp_rx_cb_t)(uint8_t from, const uint8_t *p, int n);
+
+typedef struct {
+    const char *name;
+    uint16_t    mtu;                        // largest datagram, bytes
+    bool (*open)(wb_tp_rx_cb_t rx);
+    // seg[] as one datagram to node `to`: bytes sent, -1 = dropped
+    // (over mtu, no buffer); called from one task only
+    int  (*send)(uint8_t to, const wb_seg_t *seg, int nseg);
+} wb_transport_t;
+
+extern const wb_transport_t wb_tp_udp;      // transport_udp.c: socket or raw PCB
+extern const wb_transport_t wb_tp_espnow;   // transport_espnow.c
+extern const wb_transport_t wb_tp_linux;    // host port: tp_linux.c, or wb_bench's capture
+
+#if CONFIG_WB_TRANSPORT_ESPNOW
+#define WB_TRANSPORT (&wb_tp_espnow)
+#elif CONFIG_WB_TRANSPORT_LINUX
+#define WB_TRANSPORT (&wb_tp_linux)
+#else
+#define WB_TRANSPORT (&wb_tp_udp)
+#endif
+
+// ESP-NOW backend: no association, so this is the link state
+typedef struct {
+    bool     peer_known;      // peer MAC configured or learned
+    int      rssi;            // last datagram from the peer
+    int64_t  t_rx_us;         // last datagram, 0 = never
+    uint32_t tx;
+    uint32_t tx_fail;         // not acked after the driver's retries
+    uint32_t tx_nomem;        // driver queue full
+    uint32_t rx;
+} wb_espnow_stats_t;
+
+void wb_espnow_get_stats(wb_espnow_stats_t *out);
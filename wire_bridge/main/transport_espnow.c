@@ -0,0 +1,211 @@
+// transport_espnow.c — tunnel datagrams as ESP-NOW action frames
+//
+// No association, no DHCP, no IP/UDP stack: the radio only has to sit on
+// CONFIG_WB_WIFI_CHANNEL (bridge_wifi.c). Datagrams keep the wb_hdr_t
+// framing; the tunnel fragments to fit the ESP-NOW payload (1470 bytes
+// with v2, 250 with v1).
+//  - Peer MAC from Kconfig, or learned from the first tunnel datagram
+//    (registered with the driver from the TX task, not the Wi-Fi task);
+//    until then datagrams go to the broadcast address
+//  - Unicast frames are acked and retried by the driver; send status
+//    only feeds the counters, the tunnel has its own loss handling
+//  - RX callback runs in the Wi-Fi task and hands the datagram straight
+//    to the tunnel (like the raw UDP backend in the tcpip thread)
+// Point-to-point only: every datagram comes from / goes to the one peer.
+
+#include "transport.h"
+#include "wb_proto.h"
+#include "bridge_cfg.h"
+
+#if CONFIG_WB_TRANSPORT_ESPNOW
+
+#include <string.h>
+#include <stdio.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_now.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "wb_tp_espnow";
+
+#if CONFIG_WB_ESPNOW_V2
+#define WB_ESPNOW_MTU ESP_NOW_MAX_DATA_LEN_V2
+#else
+#define WB_ESPNOW_MTU ESP_NOW_MAX_DATA_LEN
+#endif
+
+#if CONFIG_WB_ROLE_AP
+#define WB_ESPNOW_NODE WB_IP_STA_LAST
+#else
+#define WB_ESPNOW_NODE WB_IP_AP_LAST
+#endif
+
+static const uint8_t s_bcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static wb_tp_rx_cb_t s_rx = NULL;
+static uint8_t s_peer[6];
+static volatile bool s_peer_seen = false;   // s_peer set by RX, not yet added
+static volatile bool s_peer_known = false;  // s_peer added: unicast to it
+static bool s_peer_fixed = false;           // from Kconfig
+static uint8_t s_tx_buf[WB_ESPNOW_MTU];     // gather buffer, TX task only
+
+static wb_espnow_stats_t s_st;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static bool add_peer(const uint8_t *mac)
+{
+    esp_now_peer_info_t pi = {0};
+    memcpy(pi.peer_addr, mac, 6);
+    pi.channel = 0;                       // current channel
+    pi.ifidx = WIFI_IF_STA;
+    pi.encrypt = false;
+
+    esp_err_t err = esp_now_is_peer_exist(mac) ? esp_now_mod_peer(&pi) : esp_now_add_peer(&pi);
+    if (err != ESP_OK) return false;
+
+    esp_now_rate_config_t rc = {
+#if CONFIG_WB_ESPNOW_RATE_1M
+        .phymode = WIFI_PHY_MODE_11B,
+        .rate = WIFI_PHY_RATE_1M_L,
+#elif CONFIG_WB_ESPNOW_RATE_MCS3
+        .phymode = WIFI_PHY_MODE_HT20,
+        .rate = WIFI_PHY_RATE_MCS3_LGI,
+#else
+        .phymode = WIFI_PHY_MODE_HT20,
+        .rate = WIFI_PHY_RATE_MCS7_SGI,
+#endif
+    };
+    return esp_now_set_peer_rate_config(mac, &rc) == ESP_OK;
+}
+
+// Wi-Fi task
+static void espnow_recv_cb(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    if (!info || !data || len < (int)sizeof(wb_hdr_t)) return;
+
+    uint16_t magic;
+    memcpy(&magic, data, sizeof(magic));
+    if (magic != WB_MAGIC && magic != WB_MAGIC_SEC) return;
+
+    if (!s_peer_seen) {
+        // first tunnel datagram names the peer
+        memcpy(s_peer, info->src_addr, 6);
+        s_peer_seen = true;
+    } else if (memcmp(info->src_addr, s_peer, 6) != 0) {
+        return;                           // some other ESP-NOW sender
+    }
+
+    portENTER_CRITICAL(&s_mux);
+    s_st.rx++;
+    s_st.t_rx_us = esp_timer_get_time();
+    if (info->rx_ctrl) s_st.rssi = info->rx_ctrl->rssi;
+    portEXIT_CRITICAL(&s_mux);
+
+    s_rx(WB_ESPNOW_NODE, data, len);
+}
+
+static void espnow_send_cb(const esp_now_send_info_t *info, esp_now_send_status_t status)
+{
+    (void)info;
+    if (status == ESP_NOW_SEND_SUCCESS) return;
+
+    portENTER_CRITICAL(&s_mux);
+    s_st.tx_fail++;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static bool parse_mac(const char *s, uint8_t *mac)
+{
+    unsigned m[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6) return false;
+    for (int i = 0; i < 6; i++) {
+        if (m[i] > 0xFF) return false;
+        mac[i] = (uint8_t)m[i];
+    }
+    return true;
+}
+
+static bool espnow_open(wb_tp_rx_cb_t rx)
+{
+    s_rx = rx;
+
+    if (esp_now_init() != ESP_OK) {
+        ESP_LOGE(TAG, "esp_now_init failed (Wi-Fi not started?)");
+        return false;
+    }
+    esp_now_register_recv_cb(espnow_recv_cb);
+    esp_now_register_send_cb(espnow_send_cb);
+
+    if (!add_peer(s_bcast)) {
+        ESP_LOGE(TAG, "broadcast peer setup failed");
+        return false;
+    }
+
+    const char *cfg = CONFIG_WB_ESPNOW_PEER_MAC;
+    if (cfg[0]) {
+        if (!parse_mac(cfg, s_peer) || !add_peer(s_peer)) {
+            ESP_LOGE(TAG, "bad peer MAC \"%s\"", cfg);
+            return false;
+        }
+        s_peer_fixed = true;
+        s_peer_seen = true;
+        s_peer_known = true;
+    }
+
+    ESP_LOGI(TAG, "ESP-NOW: ch=%d mtu=%d peer=%s", CONFIG_WB_WIFI_CHANNEL, WB_ESPNOW_MTU,
+             s_peer_fixed ? cfg : "learn");
+    return true;
+}
+
+static int espnow_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    (void)to;                             // the one peer
+
+    if (s_peer_seen && !s_peer_known) {
+        if (add_peer(s_peer)) {
+            s_peer_known = true;
+            ESP_LOGI(TAG, "peer %02x:%02x:%02x:%02x:%02x:%02x", s_peer[0], s_peer[1],
+                     s_peer[2], s_peer[3], s_peer[4], s_peer[5]);
+        }
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) n += seg[i].len;
+    if (n > WB_ESPNOW_MTU) return -1;
+
+    uint8_t *o = s_tx_buf;
+    for (int i = 0; i < nseg; i++) {
+        memcpy(o, seg[i].p, seg[i].len);
+        o += seg[i].len;
+    }
+
+    // the driver copies the payload before returning
+    esp_err_t err = esp_now_send(s_peer_known ? s_peer : s_bcast, s_tx_buf, n);
+
+    portENTER_CRITICAL(&s_mux);
+    if (err == ESP_OK) s_st.tx++;
+    else if (err == ESP_ERR_ESPNOW_NO_MEM) s_st.tx_nomem++;
+    portEXIT_CRITICAL(&s_mux);
+
+    return err == ESP_OK ? (int)n : -1;
+}
+
+void wb_espnow_get_stats(wb_espnow_stats_t *out)
+{
+    if (!out) return;
+    portENTER_CRITICAL(&s_mux);
+    *out = s_st;
+    portEXIT_CRITICAL(&s_mux);
+    out->peer_known = s_peer_known;
+}
+
+const wb_transport_t wb_tp_espnow = {
+    .name = "espnow",
+    .mtu  = WB_ESPNOW_MTU,
+    .open = espnow_open,
+    .send = espnow_send,
+};
+
+#endif
@@ -0,0 +1,223 @@
+// transport_udp.c — tunnel datagrams over UDP/IP on the Wi-Fi link
+//  - BSD sockets: own RX task, sendmsg (header + payload iovecs) or
+//    sendto from a stack bounce buffer
+//  - lwIP raw PCB: RX callback in the tcpip thread, pbuf goes straight to
+//    reassembly; TX posts one pbuf per datagram to the tcpip thread
+// Node n is 192.168.50.n, all on CONFIG_WB_UDP_PORT.
+
+#include "transport.h"
+#include "bridge_cfg.h"
+#include "task_topo.h"
+
+#if CONFIG_WB_TRANSPORT_SOCKET || CONFIG_WB_TRANSPORT_RAW
+
+#include <string.h>
+#if CONFIG_WB_TRANSPORT_RAW
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "lwip/priv/tcpip_priv.h"
+#else
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "wb_tp_udp";
+
+#define WB_UDP_MTU 1472           // one 1500-byte IPv4 packet
+
+static wb_tp_rx_cb_t s_rx = NULL;
+
+// Source address (network order) -> node, 0 = outside the tunnel subnet
+static uint8_t node_of(uint32_t ip_be)
+{
+    const uint8_t *b = (const uint8_t *)&ip_be;
+    if (b[0] != WB_NET_BASE_IP0 || b[1] != WB_NET_BASE_IP1 || b[2] != WB_NET_BASE_IP2) return 0;
+    return b[3];
+}
+
+#if CONFIG_WB_TRANSPORT_RAW
+static struct udp_pcb *s_pcb = NULL;
+static uint8_t s_rx_flat[2048];   // only for chained pbufs
+
+// tcpip thread: no socket mailbox, no copy for single pbufs
+static void raw_recv_cb(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    (void)arg; (void)pcb; (void)port;
+    if (!p) return;
+
+    uint8_t from = node_of(ip4_addr_get_u32(ip_2_ip4(addr)));
+    if (p->len == p->tot_len) {
+        s_rx(from, (const uint8_t *)p->payload, p->len);
+    } else if (p->tot_len <= sizeof(s_rx_flat)) {
+        pbuf_copy_partial(p, s_rx_flat, p->tot_len, 0);
+        s_rx(from, s_rx_flat, p->tot_len);
+    }
+    pbuf_free(p);
+}
+
+static void raw_send_cb(void *ctx)
+{
+    struct pbuf *p = (struct pbuf *)ctx;
+
+    // destination node rides in the last byte (single PBUF_RAM pbuf)
+    uint8_t to = ((const uint8_t *)p->payload)[p->len - 1];
+    pbuf_realloc(p, (u16_t)(p->tot_len - 1));
+
+    ip_addr_t dst;
+    IP_ADDR4(&dst, WB_NET_BASE_IP0, WB_NET_BASE_IP1, WB_NET_BASE_IP2, to);
+    (void)udp_sendto(s_pcb, p, &dst, CONFIG_WB_UDP_PORT);
+    pbuf_free(p);
+}
+
+// raw API is not thread safe: PCB is created inside the tcpip thread
+static err_t raw_open_cb(struct tcpip_api_call_data *call)
+{
+    (void)call;
+    s_pcb = udp_new();
+    if (!s_pcb) return ERR_MEM;
+
+    err_t err = udp_bind(s_pcb, IP_ADDR_ANY, CONFIG_WB_UDP_PORT);
+    if (err != ERR_OK) {
+        udp_remove(s_pcb);
+        s_pcb = NULL;
+        return err;
+    }
+    udp_recv(s_pcb, raw_recv_cb, NULL);
+    return ERR_OK;
+}
+
+static bool udp_open(wb_tp_rx_cb_t rx)
+{
+    s_rx = rx;
+
+    struct tcpip_api_call_data call = {0};
+    if (tcpip_api_call(raw_open_cb, &call) != ERR_OK) {
+        ESP_LOGE(TAG, "raw udp pcb setup failed");
+        return false;
+    }
+    return true;
+}
+
+static int udp_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    // one copy into a pbuf; udp_sendto runs in the tcpip thread
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) n += seg[i].len;
+    if (n > WB_UDP_MTU) return -1;
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(n + 1), PBUF_RAM);
+    if (!p) return -1;
+
+    uint8_t *o = (uint8_t *)p->payload;
+    for (int i = 0; i < nseg; i++) {
+        memcpy(o, seg[i].p, seg[i].len);
+        o += seg[i].len;
+    }
+    *o = to;
+
+    if (tcpip_try_callback(raw_send_cb, p) != ERR_OK) {
+        pbuf_free(p);
+        return -1;
+    }
+    return (int)n;
+}
+#else
+static int s_sock = -1;
+
+static void udp_rx_task(void *arg)
+{
+    (void)arg;
+    uint8_t rxbuf[2048] __attribute__((aligned(4)));
+
+    while (1) {
+        struct sockaddr_in src;
+        socklen_t slen = sizeof(src);
+        int n = recvfrom(s_sock, rxbuf, sizeof(rxbuf), 0, (struct sockaddr *)&src, &slen);
+        if (n <= 0) continue;
+        s_rx(node_of(src.sin_addr.s_addr), rxbuf, n);
+    }
+}
+
+static bool udp_open(wb_tp_rx_cb_t rx)
+{
+    s_rx = rx;
+
+    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (s_sock < 0) {
+        ESP_LOGE(TAG, "socket() failed");
+        return false;
+    }
+
+    struct sockaddr_in local = {0};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(CONFIG_WB_UDP_PORT);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (bind(s_sock, (struct sockaddr*)&local, sizeof(local)) != 0) {
+        ESP_LOGE(TAG, "bind() failed");
+        return false;
+    }
+
+    wb_task_create(WB_STAGE_UDP_RX, udp_rx_task, NULL, NULL);
+    return true;
+}
+
+static int udp_send(uint8_t to, const wb_seg_t *seg, int nseg)
+{
+    struct sockaddr_in dst = {0};
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(CONFIG_WB_UDP_PORT);
+    dst.sin_addr.s_addr = htonl((uint32_t)WB_NET_BASE_IP0 << 24 | WB_NET_BASE_IP1 << 16 |
+                                WB_NET_BASE_IP2 << 8 | to);
+
+    size_t n = 0;
+    for (int i = 0; i < nseg; i++) n += seg[i].len;
+    if (n > WB_UDP_MTU) return -1;
+
+#if CONFIG_WB_TX_SENDMSG
+    // pieces go as separate iovecs; lwIP copies them once into its pbuf
+    struct iovec iov[WB_SEG_MAX];
+    for (int i = 0; i < nseg; i++) {
+        iov[i].iov_base = (void *)seg[i].p;
+        iov[i].iov_len = seg[i].len;
+    }
+    struct msghdr msg = {
+        .msg_name = &dst,
+        .msg_namelen = sizeof(dst),
+        .msg_iov = iov,
+        .msg_iovlen = nseg,
+    };
+    return (int)sendmsg(s_sock, &msg, 0);
+#else
+    uint8_t out[WB_UDP_MTU];
+    uint8_t *o = out;
+
+    for (int i = 0; i < nseg; i++) {
+        memcpy(o, seg[i].p, seg[i].len);
+        o += seg[i].len;
+    }
+
+    return (int)sendto(s_sock, out, n, 0, (const struct sockaddr *)&dst, sizeof(dst));
+#endif
+}
+#endif
+
+const wb_transport_t wb_tp_udp = {
+#if CONFIG_WB_TRANSPORT_RAW
+    .name = "raw",
+#else
+    .name = "socket",
+#endif
+    .mtu  = WB_UDP_MTU,
+    .open = udp_open,
+    .send = udp_send,
+};
+
+#endif
@@ -0,0 +1,270 @@
+// txq.c — traffic classes and the TX scheduler
+//
+// One FreeRTOS queue per class. RT always goes first; CTRL/BE/BULK are
+// served by deficit round robin with a quantum of weight x WB_MAX_FRAME
+// bytes, so a bulk copy gets its share but can never starve DMX.
+// Each class leaves enough pool buffers to fill the queues of the classes
+// above it (RT above CTRL above BE/BULK), so a bulk burst or a busy
+// reassembly cannot starve RT or CTRL of buffers. The pool covers every
+// queue plus reassembly (asserted in udp_tunnel.c), so each class can
+// still fill its own queue.
+// With the DELAY shaping policy a class whose head frame does not fit its
+// token bucket is skipped; pop() then reports how long until one fits.
+
+#include "txq.h"
+#include "frame_pool.h"
+#include "wb_proto.h"
+#include "shaper.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+static const uint16_t s_depth[WB_TC_COUNT] = {
+    CONFIG_WB_TXQ_DEPTH_RT,
+    CONFIG_WB_TXQ_DEPTH_CTRL,
+    CONFIG_WB_TXQ_DEPTH_BE,
+    CONFIG_WB_TXQ_DEPTH_BULK,
+};
+// pool buffers a class must leave free
+static const uint16_t s_keep[WB_TC_COUNT] = {
+    0,
+    CONFIG_WB_TXQ_DEPTH_RT,
+    CONFIG_WB_TXQ_DEPTH_RT + CONFIG_WB_TXQ_DEPTH_CTRL,
+    CONFIG_WB_TXQ_DEPTH_RT + CONFIG_WB_TXQ_DEPTH_CTRL,
+};
+static const uint8_t s_weight[WB_TC_COUNT] = { 0, 4, 2, 1 };
+static const char *const s_name[WB_TC_COUNT] = { "rt", "ctrl", "be", "bulk" };
+
+typedef struct {
+    uint32_t enqueued, dropped, sent;
+    uint32_t lat_max_us;
+    uint64_t lat_sum_us;
+} tc_cnt_t;
+
+static QueueHandle_t s_q[WB_TC_COUNT];
+static tc_cnt_t      s_cnt[WB_TC_COUNT];
+
+// DRR state (consumer only)
+static int     s_rr = WB_TC_CTRL;
+static bool    s_visit = false;          // quantum already added for this visit
+static int32_t s_deficit[WB_TC_COUNT];
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+bool wb_txq_init(void)
+{
+    for (int c = 0; c < WB_TC_COUNT; c++) {
+        if (s_q[c]) continue;
+        s_q[c] = xQueueCreate(s_depth[c], sizeof(wb_txq_item_t));
+        if (!s_q[c]) return false;
+    }
+    return true;
+}
+
+static wb_tc_t class_of_port(uint16_t port)
+{
+    switch (port) {
+    case 5568:              // sACN (E1.31)
+    case 6454:              // Art-Net
+    case 319: case 320:     // PTP event / general
+        return WB_TC_RT;
+    case 53: case 67: case 68: case 123:
+        return WB_TC_CTRL;
+    default:
+        return WB_TC_COUNT;
+    }
+}
+
+static wb_tc_t class_of_dscp(uint8_t dscp)
+{
+    if (dscp >= 48) return WB_TC_CTRL;          // CS6/CS7 network control
+    if (dscp >= 40) return WB_TC_RT;            // CS5, EF (46)
+    if (dscp >= 24) return WB_TC_CTRL;          // CS3/AF3x, CS4/AF4x
+    if (dscp >= 8 && dscp < 16) return WB_TC_BULK;   // CS1, AF1x
+    return WB_TC_COUNT;
+}
+
+static const wb_tc_t s_pcp_class[8] = {
+    WB_TC_BE, WB_TC_BULK, WB_TC_BULK, WB_TC_CTRL, WB_TC_RT, WB_TC_RT, WB_TC_CTRL, WB_TC_CTRL,
+};
+
+wb_tc_t wb_txq_classify(const uint8_t *f, uint16_t len)
+{
+    if (len < 14) return WB_TC_BE;
+
+    uint16_t et = (uint16_t)(f[12] << 8 | f[13]);
+    uint16_t l3 = 14;
+    int pcp = -1;
+    if (et == 0x8100 && len >= 18) {
+        pcp = f[14] >> 5;
+        et = (uint16_t)(f[16] << 8 | f[17]);
+        l3 = 18;
+    }
+
+    switch (et) {
+    case 0x88F7: return WB_TC_RT;        // PTP over Ethernet
+    case 0x0806:                         // ARP
+    case 0x88CC: return WB_TC_CTRL;      // LLDP
+    default: break;
+    }
+
+    const uint8_t *ip = f + l3;
+    uint8_t dscp = 0, proto = 0;
+    uint16_t l4 = 0;
+
+    if (et == 0x0800 && len >= l3 + 20) {
+        dscp = ip[1] >> 2;
+        proto = ip[9];
+        l4 = (uint16_t)(l3 + (ip[0] & 0x0F) * 4);
+        if (proto == 1 || proto == 2) return WB_TC_CTRL;     // ICMP, IGMP
+    } else if (et == 0x86DD && len >= l3 + 40) {
+        dscp = (uint8_t)(((ip[0] & 0x0F) << 4 | ip[1] >> 4) >> 2);
+        proto = ip[6];
+        l4 = (uint16_t)(l3 + 40);
+        if (proto == 58) return WB_TC_CTRL;                  // ICMPv6 (ND)
+    }
+
+    if (proto == 17 && len >= l4 + 4) {
+        wb_tc_t c = class_of_port((uint16_t)(f[l4 + 2] << 8 | f[l4 + 3]));
+        if (c == WB_TC_COUNT) c = class_of_port((uint16_t)(f[l4] << 8 | f[l4 + 1]));
+        if (c != WB_TC_COUNT) return c;
+    }
+
+    wb_tc_t c = class_of_dscp(dscp);
+    if (c != WB_TC_COUNT) return c;
+    if (pcp >= 0) return s_pcp_class[pcp];
+    return WB_TC_BE;
+}
+
+uint8_t *wb_txq_alloc(wb_tc_t tc)
+{
+    uint8_t *buf = wb_pool_alloc_keep(s_keep[tc]);
+    if (!buf) {
+        taskENTER_CRITICAL(&s_lock);
+        s_cnt[tc].dropped++;
+        taskEXIT_CRITICAL(&s_lock);
+    }
+    return buf;
+}
+
+bool wb_txq_push(wb_tc_t tc, wb_txq_item_t *it)
+{
+    it->t_us = (uint32_t)esp_timer_get_time();
+    bool ok = xQueueSend(s_q[tc], it, 0) == pdTRUE;
+
+    taskENTER_CRITICAL(&s_lock);
+    if (ok) s_cnt[tc].enqueued++;
+    else s_cnt[tc].dropped++;
+    taskEXIT_CRITICAL(&s_lock);
+    return ok;
+}
+
+bool wb_txq_pending(void)
+{
+    for (int c = 0; c < WB_TC_COUNT; c++) {
+        if (uxQueueMessagesWaiting(s_q[c])) return true;
+    }
+    return false;
+}
+
+static void took(wb_tc_t tc, const wb_txq_item_t *it)
+{
+    uint32_t lat = (uint32_t)esp_timer_get_time() - it->t_us;
+    tc_cnt_t *n = &s_cnt[tc];
+
+    taskENTER_CRITICAL(&s_lock);
+    n->sent++;
+    n->lat_sum_us += lat;
+    if (lat > n->lat_max_us) n->lat_max_us = lat;
+    taskEXIT_CRITICAL(&s_lock);
+}
+
+// 0 = head may go now (shaper tokens taken)
+static uint32_t head_wait(wb_tc_t tc, const wb_txq_item_t *h)
+{
+#if CONFIG_WB_SHAPE
+    return wb_shape_delay(tc, h->buf + h->off, h->len);
+#else
+    (void)tc;
+    (void)h;
+    return 0;
+#endif
+}
+
+static void rr_next(void)
+{
+    s_rr = (s_rr + 1 < WB_TC_COUNT) ? s_rr + 1 : WB_TC_CTRL;
+    s_visit = false;
+}
+
+static inline void wait_min(uint32_t *wait_us, uint32_t w)
+{
+    if (w && (*wait_us == 0 || w < *wait_us)) *wait_us = w;
+}
+
+bool wb_txq_pop(wb_txq_item_t *it, wb_tc_t *tc, uint32_t *wait_us)
+{
+    wb_txq_item_t head;
+    *wait_us = 0;
+
+    if (xQueuePeek(s_q[WB_TC_RT], &head, 0) == pdTRUE) {
+        uint32_t w = head_wait(WB_TC_RT, &head);
+        if (!w) {
+            (void)xQueueReceive(s_q[WB_TC_RT], it, 0);
+            *tc = WB_TC_RT;
+            took(WB_TC_RT, it);
+            return true;
+        }
+        wait_min(wait_us, w);
+    }
+
+    // quantum >= largest frame, so two passes always find a frame if any
+    for (int n = 0; n < 2 * (WB_TC_COUNT - 1); n++) {
+        if (xQueuePeek(s_q[s_rr], &head, 0) != pdTRUE) {
+            s_deficit[s_rr] = 0;
+            rr_next();
+            continue;
+        }
+        if (!s_visit) {
+            s_deficit[s_rr] += s_weight[s_rr] * WB_MAX_FRAME;
+            s_visit = true;
+        }
+        if (head.len <= s_deficit[s_rr]) {
+            uint32_t w = head_wait((wb_tc_t)s_rr, &head);
+            if (w) {
+                wait_min(wait_us, w);
+                rr_next();
+                continue;
+            }
+            (void)xQueueReceive(s_q[s_rr], it, 0);
+            s_deficit[s_rr] -= head.len;
+            *tc = (wb_tc_t)s_rr;
+            took(*tc, it);
+            return true;
+        }
+        rr_next();
+    }
+    return false;
+}
+
+const char *wb_txq_class_name(wb_tc_t tc)
+{
+    return (tc < WB_TC_COUNT) ? s_name[tc] : "?";
+}
+
+void wb_txq_get_stats(wb_tc_t tc, wb_tc_stats_t *out)
+{
+    if (!out || tc >= WB_TC_COUNT) return;
+
+    taskENTER_CRITICAL(&s_lock);
+    tc_cnt_t n = s_cnt[tc];
+    taskEXIT_CRITICAL(&s_lock);
+
+    out->enqueued = n.enqueued;
+    out->dropped = n.dropped;
+    out->sent = n.sent;
+    out->depth = s_q[tc] ? uxQueueMessagesWaiting(s_q[tc]) : 0;
+    out->lat_avg_us = n.sent ? (uint32_t)(n.lat_sum_us / n.sent) : 0;
+    out->lat_max_us = n.lat_max_us;
+}
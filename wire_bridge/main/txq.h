@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+
+// TX traffic classes: per-class queues in front of udp_tx_task.
+// RT is served with strict priority; the rest share what is left by
+// deficit round robin (weights 4:2:1 in bytes).
+
+typedef enum {
+    WB_TC_RT = 0,      // sACN / Art-Net / PTP, DSCP EF/CS5, PCP 4-5
+    WB_TC_CTRL,        // ARP, LLDP, ICMP, DNS/DHCP/NTP, DSCP CS6/7 & AF3x/4x, PCP 3/6/7
+    WB_TC_BE,          // everything else
+    WB_TC_BULK,        // DSCP CS1/AF1x, PCP 1-2
+    WB_TC_COUNT
+} wb_tc_t;
+
+typedef struct {
+    uint8_t *buf;      // frame pool buffer
+    uint16_t off;      // frame starts at buf + off
+    uint16_t len;
+    uint32_t t_us;     // enqueue time (esp_timer, truncated)
+    uint32_t t_in_us;  // bridge ingress, same clock; 0 = enqueue time
+    uint8_t  peer;     // destination peer or WB_PEER_FLOOD (udp_tunnel.h)
+    uint8_t  skip;     // flood: peer the frame came from, or WB_PEER_NONE
+} wb_txq_item_t;
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t dropped;      // queue full or no pool buffer for this class
+    uint32_t sent;         // dequeued by the TX task
+    uint32_t depth;        // frames waiting now
+    uint32_t lat_avg_us;   // queueing delay, enqueue -> dequeue
+    uint32_t lat_max_us;
+} wb_tc_stats_t;
+
+bool    wb_txq_init(void);
+wb_tc_t wb_txq_classify(const uint8_t *frame, uint16_t len);
+
+// Producers (any task): alloc honours the class reserves, push fails when full
+uint8_t *wb_txq_alloc(wb_tc_t tc);
+bool     wb_txq_push(wb_tc_t tc, wb_txq_item_t *it);
+
+// Consumer (udp_tx_task only). pop() false with *wait_us > 0: frames are
+// queued but the shaper holds them for that long.
+bool wb_txq_pending(void);
+bool wb_txq_pop(wb_txq_item_t *it, wb_tc_t *tc, uint32_t *wait_us);
+
+const char *wb_txq_class_name(wb_tc_t tc);
+void        wb_txq_get_stats(wb_tc_t tc, wb_tc_stats_t *out);
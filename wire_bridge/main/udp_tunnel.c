@@ -2,228 +2,1252 @@
 // ESP-IDF 6.x
 //
 // Fixes:
-//  - TX queue holds pointers (low RAM)
-//  - Reassembly uses fragment bitmap (works with >2 fragments, out-of-order)
-//  - Simple timeout resets stuck reassembly
+//  - TX queue holds pointers to frame pool buffers (no malloc per frame)
+//  - TX queue split into traffic classes: RT strict priority, the rest
+//    deficit round robin (txq.c)
+//  - Optional token-bucket shaping per class and for broadcast/multicast,
+//    drop or delay, limits in NVS (shaper.c)
+//  - Reassembly merges received byte ranges (any fragment size, out-of-order,
+//    overlapping resends)
+//  - Reassembly table: several frames in flight, looked up by seq,
+//    per-slot timeout + LRU eviction when the table is full
+//  - TX sends header + payload slice as two iovecs (sendmsg), no bounce buffer
+//  - Small frames can be aggregated into one datagram (WB_F_AGG), flushed
+//    by an esp_timer deadline
+//  - Optional XOR parity FEC over groups of datagrams (fec.c)
+//  - Optional NACK retransmission for bulk (TCP) frames (arq.c)
+//  - Optional Ethernet header compression with per-flow contexts (hdr_comp.c)
+//  - Optional adaptive LZ4 payload compression (comp.c)
+//  - Optional sACN/Art-Net delta coding against per-universe keyframes
+//    (dmx_delta.c)
+//  - Fragment size probed against the path and adapted to loss (pmtu.c)
+//  - Ping/echo link probes: RTT percentiles, loss, reordering, jitter
+//    (link_probe.c)
+//  - Hub mode: several STA peers, each with its own seq space, reassembly
+//    slots and counters; unicast by learned MAC, floods encoded once
+//  - Transport behind transport.h: UDP over the Wi-Fi link, socket or raw
+//    PCB (transport_udp.c), or ESP-NOW without association (transport_espnow.c);
+//    fragment size capped to what one datagram of the backend holds
 
 #include "udp_tunnel.h"
+#include "wb_proto.h"
+#include "frame_pool.h"
+#include "fec.h"
+#include "arq.h"
+#include "hdr_comp.h"
+#include "comp.h"
+#include "dmx_delta.h"
+#include "txq.h"
+#include "shaper.h"
+#include "pmtu.h"
+#include "link_probe.h"
+#include "fdb.h"
+#include "crypt.h"
+#include "transport.h"
+#include "task_topo.h"
+#include "wb_stats.h"
+#include "capture.h"
+#include "bridge_cfg.h"
 
 #include <string.h>
-#include <stdlib.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
 
 #include "esp_log.h"
 #include "esp_timer.h"
+#if CONFIG_WB_TX_PROFILE
+#include "esp_cpu.h"
+#endif
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 
 static const char *TAG = "wb_udp";
 
-#define WB_MAGIC 0xBEEF
-#define WB_VER   1
+#define WB_MAX_FRAGS    8                         // disjoint ranges per frame (ESP-NOW v1: 8 fragments)
+#define WB_REASM_SLOTS  CONFIG_WB_REASM_SLOTS     // frames reassembled in parallel
+#define WB_REASM_TO_MS  CONFIG_WB_REASM_TIMEOUT_MS // timeout for missing frags
 
-#define WB_MAX_FRAME    1600
-#define WB_MTU          CONFIG_WB_MAX_PAYLOAD     // fragment payload bytes (400..1400)
-#define WB_MAX_FRAGS    8                         // enough: 1600/400=4, 1600/200=8 etc.
-#define WB_REASM_TO_MS  50                        // timeout for missing frags
+#define WB_TX_HEADROOM  16        // free bytes before a queued frame, for in-place codecs
 
-typedef struct __attribute__((packed)) {
-    uint16_t magic;
-    uint8_t  ver;
-    uint8_t  flags;
-    uint16_t seq;
-    uint16_t frame_len;
-    uint16_t frag_off;
-    uint16_t frag_len;
-} wb_hdr_t;
+_Static_assert(WB_POOL_BUF_SIZE >= WB_MAX_FRAME, "frame pool buffers too small");
 
-// Reassembly state
+typedef struct {
+    uint16_t s, e;            // [s, e) bytes of the frame
+} wb_range_t;
+
+// Reassembly state (one per slot)
 typedef struct {
     bool     in_use;
+    uint8_t  space;           // WB_F_REL or 0: reliable frames have their own seq space
     uint16_t seq;
     uint16_t frame_len;
-    uint8_t  total_frags;     // expected fragments count
-    uint8_t  got_frags;       // how many received (unique)
-    uint8_t  bitmap;          // bit i = fragment i received (WB_MAX_FRAGS<=8)
+    uint8_t  nranges;
+    wb_range_t rng[WB_MAX_FRAGS];  // received bytes: sorted, disjoint, not touching
+    int64_t  t_first_us;      // first fragment time
     int64_t  t_last_us;       // last fragment time
-    uint8_t  buf[WB_MAX_FRAME];
+    uint8_t *buf;             // frame pool buffer, held while in_use
 } wb_reasm_t;
 
-// TX queue item
+#if CONFIG_WB_ROLE_AP
+#define WB_PEER_LAST  WB_IP_STA_LAST
+#else
+#define WB_PEER_LAST  WB_IP_AP_LAST
+#endif
+
+#if CONFIG_WB_HUB
+#define WB_PEERS        CONFIG_WB_HUB_PEERS
+#define WB_PEER_IDLE_US (10 * 1000000LL)   // silent this long: left out of floods
+#else
+#define WB_PEERS        1
+#endif
+
+// every queue full, one frame in udp_tx_task, every reassembly slot busy,
+// a full retransmit window
+#if CONFIG_WB_ARQ
+#define WB_POOL_ARQ     CONFIG_WB_ARQ_WINDOW
+#else
+#define WB_POOL_ARQ     0
+#endif
+#define WB_POOL_NEED    (CONFIG_WB_TXQ_DEPTH_RT + CONFIG_WB_TXQ_DEPTH_CTRL + CONFIG_WB_TXQ_DEPTH_BE + \
+                         CONFIG_WB_TXQ_DEPTH_BULK + 1 + WB_PEERS * WB_REASM_SLOTS + WB_POOL_ARQ)
+_Static_assert(CONFIG_WB_POOL_FRAMES >= WB_POOL_NEED,
+               "WB_POOL_FRAMES below TX queue depth + reassembly slots + ARQ window");
+
+// One tunnel peer: own seq space, reassembly slots and counters;
+// st.ip_last is its transport node number
 typedef struct {
-    uint16_t len;
-    uint8_t *buf;             // malloc'd, freed in tx task
-} tx_item_t;
+    uint16_t tx_seq;
+    bool     rx_seq_ok;
+    uint16_t rx_seq_max;      // highest data seq seen, gaps = loss
+    uint32_t rx_gaps;         // seq gaps (late frames not given back), no-buffer drops
+    int64_t  t_rx_us;         // last datagram, 0 = never
+    wb_reasm_t re[WB_REASM_SLOTS];
+    wb_reasm_slot_stats_t re_st[WB_REASM_SLOTS];
+#if CONFIG_WB_CRYPT
+    wb_crypt_win_t crypt;     // anti-replay over the datagram numbers of node st.ip_last
+#endif
+#if CONFIG_WB_HUB
+    // path MTU probe to answer: the hub acks spokes without probing itself
+    volatile bool pmtu_ack;
+    uint16_t pmtu_id, pmtu_size;
+#endif
+    wb_peer_stats_t st;
+} wb_peer_t;
 
-static int s_sock = -1;
-static struct sockaddr_in s_peer = {0};
+static wb_peer_t s_peers[WB_PEERS];
+static uint16_t s_frag_cap = WB_MTU_MAX;   // largest payload one datagram of the transport holds
 
 static wb_frame_rx_cb_t s_rx_cb = NULL;
 static void *s_rx_user = NULL;
 
-static QueueHandle_t s_txq = NULL;
+static TaskHandle_t s_tx_task = NULL;
+static volatile bool s_tx_wake = false;   // timer / ctrl work for udp_tx_task
+#if CONFIG_WB_SHAPE
+static esp_timer_handle_t s_shape_timer = NULL;   // shaper hold-off expired
+#endif
+static uint32_t s_tx_dgrams;                      // udp_tx_task: sent so far
 
-static wb_reasm_t s_re = {0};
-static uint16_t s_seq = 1;
+#if CONFIG_WB_ROLE_STA
+// A hub floods only to spokes heard from lately: a STA with nothing to
+// send still shows up this often
+#define WB_KEEPALIVE_MS 2000
+static esp_timer_handle_t s_ka_timer = NULL;
+static volatile bool s_ka_due = false;
+static uint32_t s_ka_dgrams;                      // s_tx_dgrams at the last tick
+#endif
 
-static uint32_t s_tx = 0, s_rx = 0, s_drop = 0;
+#if CONFIG_WB_AGG
+// Aggregation buffer, owned by udp_tx_task
+static uint8_t  s_agg[WB_MTU_MAX];
+static uint16_t s_agg_len = 0;
+static uint16_t s_agg_cnt = 0;
+static uint8_t  s_agg_peer = 0, s_agg_skip = WB_PEER_NONE;   // destination of the open aggregate
+static volatile bool s_agg_due = false;
+static esp_timer_handle_t s_agg_timer = NULL;
+#endif
 
-uint32_t wb_udp_get_tx(void){ return s_tx; }
-uint32_t wb_udp_get_rx(void){ return s_rx; }
-uint32_t wb_udp_get_drop(void){ return s_drop; }
+static uint8_t s_rx_scratch[WB_MAX_FRAME];   // RX path only: rebuilt frames
+static uint8_t s_rx_unz[WB_MAX_FRAME];       // RX path only: decompressed frames
+static int64_t  s_rx_t_us;                   // RX path: arrival of the datagram in hand
+static uint32_t s_rx_t0_us;                  // RX path: arrival of the first fragment of the frame in hand
 
-static uint8_t calc_total_frags(uint16_t frame_len)
+#if CONFIG_WB_AGG && CONFIG_WB_LAT
+#define WB_AGG_TIMED 32                      // frames of one aggregate timed; the rest are not
+static uint32_t s_agg_t_in[WB_AGG_TIMED], s_agg_t_deq[WB_AGG_TIMED];
+#endif
+
+int wb_udp_get_reasm_slots(void){ return WB_REASM_SLOTS; }
+
+// Slot counters summed over the peers
+bool wb_udp_get_reasm_stats(int slot, wb_reasm_slot_stats_t *out)
 {
-    // ceil(frame_len / WB_MTU)
-    uint32_t n = (frame_len + WB_MTU - 1) / WB_MTU;
-    if (n == 0) n = 1;
-    if (n > WB_MAX_FRAGS) return 0; // unsupported
-    return (uint8_t)n;
+    if (!out || slot < 0 || slot >= WB_REASM_SLOTS) return false;
+    memset(out, 0, sizeof(*out));
+    for (int p = 0; p < WB_PEERS; p++) {
+        const wb_reasm_slot_stats_t *st = &s_peers[p].re_st[slot];
+        out->completed += st->completed;
+        out->timeouts += st->timeouts;
+        out->evictions += st->evictions;
+    }
+    return true;
 }
 
-static void reasm_reset(uint16_t seq, uint16_t frame_len)
+int wb_udp_get_peers(void)
 {
-    memset(&s_re, 0, sizeof(s_re));
-    s_re.in_use = true;
-    s_re.seq = seq;
-    s_re.frame_len = frame_len;
-    s_re.total_frags = calc_total_frags(frame_len);
-    s_re.t_last_us = esp_timer_get_time();
-    // if total_frags==0 -> will be dropped by handler
+    return WB_PEERS;
 }
 
-static void reasm_maybe_timeout(void)
+bool wb_udp_get_peer_stats(int peer, wb_peer_stats_t *out)
 {
-    if (!s_re.in_use) return;
-    int64_t now = esp_timer_get_time();
-    if ((now - s_re.t_last_us) > (int64_t)WB_REASM_TO_MS * 1000) {
-        // drop incomplete frame
-        s_drop++;
-        s_re.in_use = false;
+    if (!out || peer < 0 || peer >= WB_PEERS) return false;
+    const wb_peer_t *pe = &s_peers[peer];
+    *out = pe->st;
+#if CONFIG_WB_HUB
+    out->active = pe->t_rx_us && esp_timer_get_time() - pe->t_rx_us < WB_PEER_IDLE_US;
+#else
+    out->active = pe->t_rx_us != 0;
+#endif
+    return true;
+}
+
+static inline uint8_t peer_index(const wb_peer_t *pe)
+{
+    return (uint8_t)(pe - s_peers);
+}
+
+#if CONFIG_WB_HUB
+static inline bool peer_active(const wb_peer_t *pe, int64_t now)
+{
+    return pe->t_rx_us && now - pe->t_rx_us < WB_PEER_IDLE_US;
+}
+#endif
+
+// Datagram source node -> peer; NULL = not ours
+static wb_peer_t *peer_find(uint8_t node)
+{
+#if CONFIG_WB_HUB
+    int i = node - WB_IP_STA_BASE;
+    if (i < 0 || i >= WB_PEERS) return NULL;
+    return &s_peers[i];
+#else
+    (void)node;
+    return &s_peers[0];
+#endif
+}
+
+static void peers_init(void)
+{
+    for (int i = 0; i < WB_PEERS; i++) {
+        wb_peer_t *pe = &s_peers[i];
+#if CONFIG_WB_HUB
+        uint8_t last = (uint8_t)(WB_IP_STA_BASE + i);
+#else
+        uint8_t last = WB_PEER_LAST;
+#endif
+        pe->tx_seq = 1;
+        pe->st.ip_last = last;
+    }
+}
+
+// Data seq gaps = frames the peer sent that never arrived; a late one
+// gives its gap back. Only first fragments count, so a frame counts once.
+static void rx_seq_track(wb_peer_t *pe, uint16_t seq)
+{
+    int16_t d = (int16_t)(seq - pe->rx_seq_max);
+
+    if (!pe->rx_seq_ok || d < -256) {
+        // first datagram, or the peer restarted
+        pe->rx_seq_ok = true;
+        pe->rx_seq_max = seq;
+    } else if (d > 0) {
+        pe->st.rx_lost += (uint32_t)(d - 1);
+        pe->rx_gaps += (uint32_t)(d - 1);
+        pe->rx_seq_max = seq;
+    } else if (d < 0 && pe->st.rx_lost) {
+        pe->st.rx_lost--;
+    }
+}
+
+// Fragment payload for new datagrams
+static uint16_t tx_mtu(void)
+{
+#if CONFIG_WB_PMTU
+    uint16_t m = wb_pmtu_get();
+#else
+    uint16_t m = WB_MTU;
+#endif
+    return m < s_frag_cap ? m : s_frag_cap;
+}
+
+#if CONFIG_WB_PMTU
+// Multi-fragment frames delivered / lost, summed over the slots
+static void reasm_totals(uint32_t *ok, uint32_t *lost)
+{
+    wb_reasm_slot_stats_t st;
+    *ok = 0;
+    *lost = 0;
+    for (int i = 0; i < WB_REASM_SLOTS; i++) {
+        wb_udp_get_reasm_stats(i, &st);
+        *ok += st.completed;
+        *lost += st.timeouts + st.evictions;
+    }
+}
+#endif
+
+static void reasm_release(wb_reasm_t *re)
+{
+    wb_pool_free(re->buf);
+    re->buf = NULL;
+    re->in_use = false;
+}
+
+static void reasm_reset(wb_reasm_t *re, uint8_t space, uint16_t seq, uint16_t frame_len, int64_t now)
+{
+    // keep the pool buffer when the slot is reused; fragments overwrite it
+    uint8_t *buf = re->buf;
+    memset(re, 0, sizeof(*re));
+    re->buf = buf ? buf : wb_pool_alloc();
+    re->in_use = true;
+    re->space = space;
+    re->seq = seq;
+    re->frame_len = frame_len;
+    re->t_first_us = now;
+    re->t_last_us = now;
+}
+
+// Merge [s, e) into the received ranges; false = too many holes to track
+static bool reasm_mark(wb_reasm_t *re, uint16_t s, uint16_t e)
+{
+    wb_range_t *r = re->rng;
+    int n = re->nranges;
+    int i = 0;
+
+    while (i < n && r[i].e < s) i++;
+
+    // absorb every range that overlaps or touches [s, e)
+    int j = i;
+    while (j < n && r[j].s <= e) {
+        if (r[j].s < s) s = r[j].s;
+        if (r[j].e > e) e = r[j].e;
+        j++;
+    }
+    if (i == j && n >= WB_MAX_FRAGS) return false;
+
+    memmove(&r[i + 1], &r[j], (size_t)(n - j) * sizeof(*r));
+    r[i].s = s;
+    r[i].e = e;
+    re->nranges = (uint8_t)(n - (j - i) + 1);
+    return true;
+}
+
+static void reasm_expire(wb_peer_t *pe, int64_t now)
+{
+    for (int i = 0; i < WB_REASM_SLOTS; i++) {
+        wb_reasm_t *re = &pe->re[i];
+        if (!re->in_use) continue;
+        if ((now - re->t_last_us) > (int64_t)WB_REASM_TO_MS * 1000) {
+            // drop incomplete frame
+            wb_stats_inc(WB_CTR_TUN_RX_DROP);
+            pe->re_st[i].timeouts++;
+            reasm_release(re);
+        }
     }
 }
 
-static void handle_packet(const uint8_t *p, int n)
+// Find slot for seq; otherwise take a free slot or evict the least recently used one.
+static int reasm_lookup(wb_peer_t *pe, uint8_t space, uint16_t seq, uint16_t frame_len, int64_t now)
 {
-    reasm_maybe_timeout();
+    int free_i = -1, lru_i = 0;
 
-    if (n < (int)sizeof(wb_hdr_t)) { s_drop++; return; }
+    for (int i = 0; i < WB_REASM_SLOTS; i++) {
+        wb_reasm_t *re = &pe->re[i];
+        if (!re->in_use) {
+            if (free_i < 0) free_i = i;
+            continue;
+        }
+        if (re->seq == seq && re->space == space) {
+            if (re->frame_len == frame_len) return i;
+            // same seq, different frame (seq wrapped / stale): restart slot
+            wb_stats_inc(WB_CTR_TUN_RX_DROP);
+            pe->re_st[i].evictions++;
+            reasm_reset(re, space, seq, frame_len, now);
+            return i;
+        }
+        if (re->t_last_us < pe->re[lru_i].t_last_us) lru_i = i;
+    }
+
+    int i = free_i;
+    if (i < 0) {
+        // table full: the oldest incomplete frame is lost
+        i = lru_i;
+        wb_stats_inc(WB_CTR_TUN_RX_DROP);
+        pe->re_st[i].evictions++;
+    }
+    reasm_reset(&pe->re[i], space, seq, frame_len, now);
+    return i;
+}
+
+static void tx_wake(void);
+static bool enqueue_frame(const uint8_t *frame, size_t len, uint8_t peer, uint8_t skip, uint32_t t_in);
+
+#if CONFIG_WB_HUB
+// Peer frame on the hub: relay it to the other peers as the MAC table
+// says; true = it (also) belongs on our Ethernet
+static bool hub_forward(wb_peer_t *pe, const uint8_t *f, uint16_t len)
+{
+    uint8_t from = peer_index(pe);
+    uint8_t to = WB_PEER_FLOOD;
+
+    if (len < 14) return true;
+    if (!(f[0] & 0x01)) {
+        uint8_t q = 0;
+        uint8_t side = wb_fdb_lookup(f, &q);
+        if (side == WB_FDB_LOCAL) return true;
+        if (side == WB_FDB_REMOTE) {
+            if (q == from || q >= WB_PEERS) return false;   // stays behind its own peer
+            to = q;
+        }
+    }
+
+    if (to == WB_PEER_FLOOD) {
+        // relay only when another peer would get it
+        int64_t now = esp_timer_get_time();
+        bool any = false;
+        for (int i = 0; i < WB_PEERS && !any; i++) any = i != from && peer_active(&s_peers[i], now);
+        if (!any) return true;
+    }
+
+    if (enqueue_frame(f, len, to, to == WB_PEER_FLOOD ? from : WB_PEER_NONE, s_rx_t0_us)) pe->st.relayed++;
+    return to == WB_PEER_FLOOD;
+}
+#endif
+
+// Decoded frame from a peer: learn where its source lives, then Ethernet
+// and/or (hub) other peers
+static void rx_frame(wb_peer_t *pe, const uint8_t *frame, uint16_t len)
+{
+    pe->st.rx_frames++;
+    wb_cap_frame(WB_CAP_TUN_IN, frame, len);
+#if CONFIG_WB_FDB
+    wb_fdb_tunnel_in(frame, len, peer_index(pe));
+#endif
+#if CONFIG_WB_HUB
+    if (!hub_forward(pe, frame, len)) return;
+#endif
+    wb_stats_inc(WB_CTR_TUN_RX_FRAMES);
+    if (!s_rx_cb) return;
+#if CONFIG_WB_LAT
+    // the callback ends in esp_eth_transmit()
+    uint32_t t = (uint32_t)esp_timer_get_time();
+    s_rx_cb(frame, len, s_rx_user);
+    uint32_t t_out = (uint32_t)esp_timer_get_time();
+    wb_stats_lat_add(WB_LAT_RX_EGRESS, t_out - t);
+    wb_stats_lat_add(WB_LAT_RX_TOTAL, t_out - s_rx_t0_us);
+#else
+    s_rx_cb(frame, len, s_rx_user);
+#endif
+}
+
+// Frames from pe known lost so far; only ever grows
+static uint32_t rx_losses(const wb_peer_t *pe)
+{
+    uint32_t n = pe->rx_gaps;
+    for (int i = 0; i < WB_REASM_SLOTS; i++) n += pe->re_st[i].timeouts + pe->re_st[i].evictions;
+#if CONFIG_WB_ARQ
+    wb_arq_stats_t as;
+    wb_arq_get_stats(&as);
+    n += as.giveups;
+#endif
+    return n;
+}
+
+static uint32_t s_hc_lost;    // rx_losses() when HC contexts were last checked
+
+// Complete frame out of the tunnel: undo per-frame codecs, hand on
+static void deliver_frame(wb_peer_t *pe, uint8_t fflags, const uint8_t *frame, uint16_t len)
+{
+#if CONFIG_WB_HUB
+    // HC / DMX decoder contexts are not kept per peer
+    if (fflags & (WB_F_HC | WB_F_DELTA)) {
+        wb_stats_inc(WB_CTR_TUN_RX_DROP);
+        return;
+    }
+#endif
+    if (fflags & WB_F_COMP) {
+        frame = wb_comp_decode(frame, &len, s_rx_unz);
+        if (!frame) {
+            wb_stats_inc(WB_CTR_TUN_RX_DROP);
+            return;
+        }
+    }
+    if (fflags & WB_F_HC) {
+        // a lost frame may have reassigned a context: the decoder trusts
+        // each one again only after a full header
+        uint32_t lost = rx_losses(pe);
+        if (lost != s_hc_lost) {
+            s_hc_lost = lost;
+            wb_hc_rx_gap();
+        }
+        frame = wb_hc_decode(frame, &len, s_rx_scratch);
+        if (!frame) {
+            // unknown context: tx task tells the peer to reinstall it
+            wb_stats_inc(WB_CTR_TUN_RX_DROP);
+            tx_wake();
+            return;
+        }
+    }
+    if (fflags & WB_F_DELTA) {
+        // never combined with WB_F_HC, so s_rx_scratch is free
+#if CONFIG_WB_DMX_DELTA
+        frame = (fflags & WB_F_HC) ? NULL : wb_dmx_decode(frame, &len, s_rx_scratch);
+#else
+        frame = NULL;
+#endif
+        if (!frame) {
+            // no keyframe yet: tx task asks the peer for one
+            wb_stats_inc(WB_CTR_TUN_RX_DROP);
+            tx_wake();
+            return;
+        }
+    }
+    rx_frame(pe, frame, len);
+}
+
+static void deliver_tunnel_frame(wb_peer_t *pe, const wb_hdr_t *h, const uint8_t *frame, uint16_t len)
+{
+#if CONFIG_WB_ARQ
+    if (h->flags & WB_F_REL) wb_arq_rx_done(h->seq);
+#endif
+    deliver_frame(pe, h->flags & WB_F_FRAME_MASK, frame, len);
+}
+
+#if CONFIG_WB_HUB
+// RX context: remember the probe, udp_tx_task acks it to this peer
+static void hub_on_probe(wb_peer_t *pe, const uint8_t *p, int n)
+{
+    wb_pmtu_probe_t pr;
+    if (n < (int)sizeof(pr)) return;
+    memcpy(&pr, p, sizeof(pr));
+    if (pr.size != n) return;      // truncated on the way
+    pe->pmtu_id = pr.id;
+    pe->pmtu_size = pr.size;
+    __atomic_store_n(&pe->pmtu_ack, true, __ATOMIC_RELEASE);
+    tx_wake();
+}
+#endif
+
+static void handle_ctrl(wb_peer_t *pe, const uint8_t *p, int n)
+{
+#if !CONFIG_WB_HUB
+    (void)pe;
+#endif
+    switch (p[0]) {
+#if CONFIG_WB_ARQ
+    case WB_CTRL_NACK:
+        wb_arq_on_nack(p, n);
+        tx_wake();
+        break;
+#endif
+    case WB_CTRL_HC_RESYNC:
+        wb_hc_on_resync(p, n);
+        break;
+#if CONFIG_WB_DMX_DELTA
+    case WB_CTRL_DMX_KEYREQ:
+        wb_dmx_on_keyreq(p, n);
+        tx_wake();
+        break;
+#endif
+#if CONFIG_WB_PMTU
+    case WB_CTRL_PMTU_PROBE:
+        wb_pmtu_on_probe(p, n);
+        tx_wake();
+        break;
+    case WB_CTRL_PMTU_ACK:
+        wb_pmtu_on_ack(p, n);
+        break;
+#elif CONFIG_WB_HUB
+    case WB_CTRL_PMTU_PROBE:
+        hub_on_probe(pe, p, n);
+        break;
+#endif
+#if CONFIG_WB_LP
+    case WB_CTRL_LP_PING:
+        wb_lp_on_ping(p, n);
+        tx_wake();
+        break;
+    case WB_CTRL_LP_ECHO:
+        wb_lp_on_echo(p, n);
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+// Split an aggregated datagram back into frames
+static void deliver_aggregate(wb_peer_t *pe, const wb_hdr_t *h, const uint8_t *payload)
+{
+    if (h->frag_off != 0 || h->frag_len != h->frame_len) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+
+    const uint8_t *p = payload;
+    const uint8_t *end = payload + h->frag_len;
+    uint32_t n = 0;
+
+    while ((size_t)(end - p) >= sizeof(wb_agg_rec_t)) {
+        wb_agg_rec_t r;
+        memcpy(&r, p, sizeof(r));
+        p += sizeof(r);
+
+        if (r.len == 0 || r.len > (size_t)(end - p)) { wb_stats_inc(WB_CTR_TUN_RX_DROP); break; }
+
+        deliver_frame(pe, r.flags & WB_F_FRAME_MASK, p, r.len);
+        p += r.len;
+        n++;
+    }
+
+    wb_stats_frame(WB_CTR_AGG_RX_DGRAMS, WB_CTR_AGG_RX_FRAMES, n);
+}
+
+// One data fragment; header already copied out of the datagram
+static void handle_fragment(wb_peer_t *pe, const wb_hdr_t *hp, const uint8_t *payload, int n)
+{
+    int64_t now = s_rx_t_us;
+    s_rx_t0_us = (uint32_t)now;   // unless it completes a reassembly
+    reasm_expire(pe, now);
+
+    wb_hdr_t h = *hp;
+
+    if (h.magic != WB_MAGIC || h.ver != WB_VER) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+    if (h.frame_len == 0 || h.frame_len > WB_MAX_FRAME) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+    if ((int)h.frag_len != n) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+    if ((uint32_t)h.frag_off + (uint32_t)h.frag_len > (uint32_t)h.frame_len) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+    // any size the peer may have picked; offsets need not be aligned
+    if (h.frag_len == 0 || h.frag_len > WB_MTU_MAX) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+
+    if (h.flags & WB_F_CTRL) {
+        if (h.frag_off == 0 && h.frag_len == h.frame_len) handle_ctrl(pe, payload, n);
+        return;
+    }
+
+    if (!(h.flags & WB_F_REL) && h.frag_off == 0) rx_seq_track(pe, h.seq);
+
+    if (h.flags & WB_F_AGG) {
+        deliver_aggregate(pe, &h, payload);
+        return;
+    }
+
+#if CONFIG_WB_ARQ
+    // duplicate of a frame already delivered (crossed retransmit) or too old
+    if ((h.flags & WB_F_REL) && !wb_arq_rx_seen(h.seq)) return;
+#endif
+
+    // single-fragment frame: deliver straight from the datagram, no slot needed
+    if (h.frag_off == 0 && h.frag_len == h.frame_len) {
+        deliver_tunnel_frame(pe, &h, payload, h.frame_len);
+        return;
+    }
+
+    int si = reasm_lookup(pe, h.flags & WB_F_REL, h.seq, h.frame_len, now);
+    wb_reasm_t *re = &pe->re[si];
+
+    if (!re->buf) { // pool exhausted
+        wb_stats_inc(WB_CTR_TUN_RX_DROP);
+        pe->rx_gaps++;
+        reasm_release(re);
+        return;
+    }
+
+    // copy payload; overlaps (resend at another fragment size) carry the same bytes
+    memcpy(&re->buf[h.frag_off], payload, h.frag_len);
+
+    if (!reasm_mark(re, h.frag_off, (uint16_t)(h.frag_off + h.frag_len))) {
+        wb_stats_inc(WB_CTR_TUN_RX_DROP);
+        pe->re_st[si].evictions++;
+        reasm_release(re);
+        return;
+    }
+
+    re->t_last_us = now;
+
+    // complete when one range covers the frame
+    if (re->nranges == 1 && re->rng[0].s == 0 && re->rng[0].e == re->frame_len) {
+        pe->re_st[si].completed++;
+        s_rx_t0_us = (uint32_t)re->t_first_us;
+#if CONFIG_WB_LAT
+        wb_stats_lat_add(WB_LAT_RX_REASM, (uint32_t)(now - re->t_first_us));
+#endif
+        deliver_tunnel_frame(pe, &h, re->buf, re->frame_len);
+        reasm_release(re);
+    }
+}
+
+static wb_peer_t *s_rx_peer;   // RX path: sender of the datagram in hand
+
+static void fec_deliver(const wb_hdr_t *h, const uint8_t *payload, int n)
+{
+    handle_fragment(s_rx_peer, h, payload, n);
+}
+
+// Whole datagram from the transport (its RX task / thread)
+#if CONFIG_WB_CRYPT
+static uint8_t s_open_buf[WB_MTU_MAX + sizeof(wb_hdr_t) + sizeof(wb_fec_ext_t)];   // RX context
+#endif
+
+static void handle_packet(uint8_t from, const uint8_t *p, int n)
+{
+    s_rx_t_us = esp_timer_get_time();
+    wb_stats_frame(WB_CTR_WIFI_RX_DGRAMS, WB_CTR_WIFI_RX_BYTES, (uint32_t)n);
+
+    wb_peer_t *pe = peer_find(from);
+    if (!pe || n < (int)sizeof(wb_hdr_t)) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+
+#if CONFIG_WB_CRYPT
+    // nothing below sees a datagram that is not authentic and new
+    n = wb_crypt_open(&pe->crypt, pe->st.ip_last, p, n, s_open_buf, sizeof(s_open_buf));
+    if (n < (int)sizeof(wb_hdr_t)) { wb_stats_inc(WB_CTR_TUN_RX_DROP); return; }
+    p = s_open_buf;
+#endif
+
+    pe->t_rx_us = s_rx_t_us;
+    pe->st.rx_datagrams++;
+    pe->st.rx_bytes += (uint32_t)n;
 
     wb_hdr_t h;
     memcpy(&h, p, sizeof(h));
 
-    if (h.magic != WB_MAGIC || h.ver != WB_VER) { s_drop++; return; }
-    if (h.frame_len == 0 || h.frame_len > WB_MAX_FRAME) { s_drop++; return; }
-    if ((int)(sizeof(wb_hdr_t) + h.frag_len) != n) { s_drop++; return; }
-    if ((uint32_t)h.frag_off + (uint32_t)h.frag_len > (uint32_t)h.frame_len) { s_drop++; return; }
-    if (h.frag_len == 0 || h.frag_len > WB_MTU) { s_drop++; return; }
-
-    // determine fragment index
-    if ((h.frag_off % WB_MTU) != 0) {
-        // require aligned offsets (simplifies reassembly). last fragment still aligned by off
-        s_drop++;
+    if (h.magic == WB_MAGIC && (h.flags & WB_F_FEC)) {
+        s_rx_peer = pe;
+        wb_fec_rx(p, n, fec_deliver);
         return;
     }
-    uint16_t frag_idx = (uint16_t)(h.frag_off / WB_MTU);
-    if (frag_idx >= WB_MAX_FRAGS) { s_drop++; return; }
+    handle_fragment(pe, &h, p + sizeof(h), n - (int)sizeof(h));
+}
 
-    const uint8_t *payload = p + sizeof(wb_hdr_t);
+#if CONFIG_WB_TX_PROFILE
+// Cycles spent per frame in the fragment/send loop, by frame size class
+// (<=64, <=512, larger). Logged every WB_PROF_LOG_MS.
+#define WB_PROF_LOG_MS 5000
 
-    // new frame
-    if (!s_re.in_use || s_re.seq != h.seq || s_re.frame_len != h.frame_len) {
-        reasm_reset(h.seq, h.frame_len);
-        if (s_re.total_frags == 0) { // too many fragments needed
-            s_drop++;
-            s_re.in_use = false;
-            return;
+#if CONFIG_WB_TRANSPORT_RAW
+#define WB_TX_MODE "raw"
+#elif CONFIG_WB_TRANSPORT_ESPNOW
+#define WB_TX_MODE "espnow"
+#elif CONFIG_WB_TRANSPORT_LINUX
+#define WB_TX_MODE "linux"
+#elif CONFIG_WB_TX_SENDMSG
+#define WB_TX_MODE "sendmsg"
+#else
+#define WB_TX_MODE "copy"
+#endif
+
+static const char *const s_prof_name[3] = { "<=64", "<=512", "<=1514" };
+static uint32_t s_prof_frames[3];
+static uint64_t s_prof_cycles[3];
+static int64_t  s_prof_last_us;
+
+static void tx_profile_add(uint16_t frame_len, uint32_t cycles)
+{
+    int b = (frame_len <= 64) ? 0 : (frame_len <= 512) ? 1 : 2;
+    s_prof_frames[b]++;
+    s_prof_cycles[b] += cycles;
+
+    int64_t now = esp_timer_get_time();
+    if ((now - s_prof_last_us) < (int64_t)WB_PROF_LOG_MS * 1000) return;
+    s_prof_last_us = now;
+
+    for (int i = 0; i < 3; i++) {
+        if (!s_prof_frames[i]) continue;
+        ESP_LOGI(TAG, "tx %s %s: %u frames, %u cycles/frame",
+                 WB_TX_MODE, s_prof_name[i],
+                 (unsigned)s_prof_frames[i], (unsigned)(s_prof_cycles[i] / s_prof_frames[i]));
+    }
+}
+#endif
+
+#if CONFIG_WB_CRYPT
+static uint8_t s_seal_buf[WB_MTU_MAX + sizeof(wb_hdr_t) + sizeof(wb_fec_ext_t) + WB_SEC_OVERHEAD];   // udp_tx_task
+#endif
+
+static int send_segs(const wb_peer_t *pe, const wb_seg_t *seg, int nseg)
+{
+#if CONFIG_WB_CRYPT
+    // the pieces go out as one sealed datagram
+    int n = wb_crypt_seal(seg, nseg, s_seal_buf, sizeof(s_seal_buf));
+    wb_seg_t sealed = { s_seal_buf, (size_t)n };
+    int r = n > 0 ? WB_TRANSPORT->send(pe->st.ip_last, &sealed, 1) : -1;
+#else
+    int r = WB_TRANSPORT->send(pe->st.ip_last, seg, nseg);
+#endif
+    if (r > 0) {
+        wb_stats_frame(WB_CTR_WIFI_TX_DGRAMS, WB_CTR_WIFI_TX_BYTES, (uint32_t)r);
+        s_tx_dgrams++;
+    } else {
+        wb_stats_inc(WB_CTR_WIFI_TX_FAIL);
+    }
+    return r;
+}
+
+#if CONFIG_WB_FEC
+static esp_timer_handle_t s_fec_timer = NULL;   // open parity group's hold expired
+
+static void fec_send_parity(void)
+{
+    wb_hdr_t h;
+    wb_fec_ext_t ext;
+    const uint8_t *pl;
+
+    uint16_t n = wb_fec_tx_parity(&h, &ext, &pl);
+    if (n == 0) return;
+
+    wb_seg_t seg[3] = { { &h, sizeof(h) }, { &ext, sizeof(ext) }, { pl, n } };
+    (void)send_segs(&s_peers[0], seg, 3);
+}
+#endif
+
+// One datagram: header + payload slice of the frame buffer
+static int send_fragment(wb_peer_t *pe, wb_hdr_t *h, const uint8_t *payload)
+{
+#if CONFIG_WB_FEC
+    wb_fec_ext_t ext;
+    wb_fec_tx_protect(h, &ext, payload);
+
+    wb_seg_t seg[3] = { { h, sizeof(*h) }, { &ext, sizeof(ext) }, { payload, h->frag_len } };
+    int r = send_segs(pe, seg, 3);
+
+    if (wb_fec_tx_group_full()) fec_send_parity();
+#else
+    wb_seg_t seg[2] = { { h, sizeof(*h) }, { payload, h->frag_len } };
+    int r = send_segs(pe, seg, 2);
+#endif
+    if (r > 0) {
+        pe->st.tx_datagrams++;
+        pe->st.tx_bytes += (uint32_t)r;
+    }
+    return r;
+}
+
+// Fragment one frame (or aggregate) to one peer
+static void send_frame(wb_peer_t *pe, uint8_t flags, uint16_t seq, const uint8_t *buf, uint16_t frame_len)
+{
+    uint16_t mtu = tx_mtu();
+
+    for (uint16_t off = 0; off < frame_len; ) {
+        uint16_t frag = (uint16_t)(frame_len - off);
+        if (frag > mtu) frag = mtu;
+
+        wb_hdr_t h = {
+            .magic = WB_MAGIC,
+            .ver = WB_VER,
+            .flags = flags,
+            .seq = seq,
+            .frame_len = frame_len,
+            .frag_off = off,
+            .frag_len = frag,
+        };
+
+        (void)send_fragment(pe, &h, buf + off);
+
+        off = (uint16_t)(off + frag);
+    }
+}
+
+// Data frame to one peer, or (hub) encoded once and sent to every active
+// peer but skip, each in its own seq space
+static void send_to(uint8_t peer, uint8_t skip, uint8_t flags, const uint8_t *buf, uint16_t len)
+{
+#if CONFIG_WB_HUB
+    if (peer == WB_PEER_FLOOD) {
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < WB_PEERS; i++) {
+            wb_peer_t *pe = &s_peers[i];
+            if (i == skip || !peer_active(pe, now)) continue;
+            send_frame(pe, flags, pe->tx_seq++, buf, len);
         }
+        return;
     }
+#else
+    (void)skip;
+#endif
+    if (peer >= WB_PEERS) {
+        wb_stats_inc(WB_CTR_TUN_TX_DROP);
+        return;
+    }
+    wb_peer_t *pe = &s_peers[peer];
+    send_frame(pe, flags, pe->tx_seq++, buf, len);
+}
+
+#if CONFIG_WB_LAT
+// A frame's last fragment went out at now
+static void tx_lat_add(uint32_t now, uint32_t t_in, uint32_t t_deq)
+{
+    wb_stats_lat_add(WB_LAT_TX_FRAG, now - t_deq);
+    wb_stats_lat_add(WB_LAT_TX_TOTAL, now - t_in);
+}
+#endif
+
+#if CONFIG_WB_AGG
+// cnt records of the aggregate buffer as one datagram
+static void agg_send(const uint8_t *p, uint16_t len, uint16_t cnt)
+{
+    if (cnt == 1) {
+        // lone frame: send it plain, no record header
+        wb_agg_rec_t r;
+        memcpy(&r, p, sizeof(r));
+        send_to(s_agg_peer, s_agg_skip, WB_F_DATA | r.flags, p + sizeof(r), r.len);
+    } else {
+        send_to(s_agg_peer, s_agg_skip, WB_F_DATA | WB_F_AGG, p, len);
+        wb_stats_frame(WB_CTR_AGG_TX_DGRAMS, WB_CTR_AGG_TX_FRAMES, cnt);
+    }
+}
 
-    // total_frags validation: index must be within expected
-    if (frag_idx >= s_re.total_frags) { s_drop++; return; }
+static void agg_flush(void)
+{
+    s_agg_due = false;
+    if (s_agg_cnt == 0) return;
 
-    // copy payload
-    memcpy(&s_re.buf[h.frag_off], payload, h.frag_len);
+    esp_timer_stop(s_agg_timer);
 
-    // mark received (avoid double-counting)
-    uint8_t bit = (uint8_t)(1u << frag_idx);
-    if ((s_re.bitmap & bit) == 0) {
-        s_re.bitmap |= bit;
-        s_re.got_frags++;
+    // the path MTU may have shrunk since the frames were added, and the
+    // receiver takes an aggregate only unfragmented: split on records
+    uint16_t mtu = tx_mtu();
+    uint16_t start = 0, end = 0, cnt = 0;
+    while (end < s_agg_len) {
+        wb_agg_rec_t r;
+        memcpy(&r, s_agg + end, sizeof(r));
+        uint16_t next = (uint16_t)(end + sizeof(r) + r.len);
+        if (cnt && next - start > mtu) {
+            agg_send(s_agg + start, (uint16_t)(end - start), cnt);
+            start = end;
+            cnt = 0;
+        }
+        end = next;
+        cnt++;
     }
+    agg_send(s_agg + start, (uint16_t)(end - start), cnt);
 
-    s_re.t_last_us = esp_timer_get_time();
+#if CONFIG_WB_LAT
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    for (int i = 0; i < s_agg_cnt && i < WB_AGG_TIMED; i++) tx_lat_add(now, s_agg_t_in[i], s_agg_t_deq[i]);
+#endif
+    s_agg_len = 0;
+    s_agg_cnt = 0;
+}
 
-    // complete when got all fragments
-    if (s_re.got_frags >= s_re.total_frags) {
-        // also sanity check last fragment length matches frame_len
-        // (optional strictness)
-        if (s_rx_cb) s_rx_cb(s_re.buf, s_re.frame_len, s_rx_user);
-        s_re.in_use = false;
+static void agg_add(uint8_t peer, uint8_t skip, const uint8_t *frame, uint16_t len, uint8_t fflags,
+                    uint32_t t_in, uint32_t t_deq)
+{
+    // one aggregate = one destination
+    if (s_agg_cnt && (peer != s_agg_peer || skip != s_agg_skip)) agg_flush();
+    if (s_agg_len + sizeof(wb_agg_rec_t) + len > tx_mtu()) agg_flush();
+    s_agg_peer = peer;
+    s_agg_skip = skip;
+
+    wb_agg_rec_t r = { .len = len, .flags = fflags };
+    memcpy(s_agg + s_agg_len, &r, sizeof(r));
+    memcpy(s_agg + s_agg_len + sizeof(r), frame, len);
+    s_agg_len = (uint16_t)(s_agg_len + sizeof(r) + len);
+#if CONFIG_WB_LAT
+    if (s_agg_cnt < WB_AGG_TIMED) {
+        s_agg_t_in[s_agg_cnt] = t_in;
+        s_agg_t_deq[s_agg_cnt] = t_deq;
     }
+#else
+    (void)t_in;
+    (void)t_deq;
+#endif
+
+    // first frame arms the flush deadline
+    if (s_agg_cnt++ == 0) esp_timer_start_once(s_agg_timer, CONFIG_WB_AGG_FLUSH_US);
 }
 
-static void udp_rx_task(void *arg)
+// esp_timer task context
+static void agg_timer_cb(void *arg)
 {
     (void)arg;
-    uint8_t rxbuf[2048];
+    s_agg_due = true;
+    tx_wake();
+}
+#endif
 
-    while (1) {
-        int n = recv(s_sock, rxbuf, sizeof(rxbuf), 0);
-        if (n <= 0) continue;
-        s_rx++;
-        handle_packet(rxbuf, n);
+static void send_ctrl_to(wb_peer_t *pe, const void *p, uint16_t n)
+{
+    wb_hdr_t h = {
+        .magic = WB_MAGIC,
+        .ver = WB_VER,
+        .flags = WB_F_CTRL,
+        .seq = 0,
+        .frame_len = n,
+        .frag_off = 0,
+        .frag_len = n,
+    };
+    (void)send_fragment(pe, &h, (const uint8_t *)p);
+}
+
+// Control datagrams belong to the point-to-point features: peer 0
+static void send_ctrl(const void *p, uint16_t n)
+{
+    send_ctrl_to(&s_peers[0], p, n);
+}
+
+#if CONFIG_WB_HUB
+// udp_tx_task: ack each spoke's path MTU probe with its own reassembly
+// outcomes, so spokes keep their probing on
+static void hub_pmtu_acks(void)
+{
+    for (int i = 0; i < WB_PEERS; i++) {
+        wb_peer_t *pe = &s_peers[i];
+        if (!__atomic_exchange_n(&pe->pmtu_ack, false, __ATOMIC_ACQUIRE)) continue;
+
+        wb_pmtu_ack_t a = { .type = WB_CTRL_PMTU_ACK, .id = pe->pmtu_id, .size = pe->pmtu_size };
+        for (int k = 0; k < WB_REASM_SLOTS; k++) {
+            a.frames_ok += pe->re_st[k].completed;
+            a.frames_lost += pe->re_st[k].timeouts + pe->re_st[k].evictions;
+        }
+        send_ctrl_to(pe, &a, sizeof(a));
+    }
+}
+#endif
+
+#if CONFIG_WB_ROLE_STA
+// udp_tx_task: nothing sent since the last tick
+static void ka_service(void)
+{
+    if (!s_ka_due) return;
+    s_ka_due = false;
+    if (s_tx_dgrams == s_ka_dgrams) {
+        static const uint8_t ka[4] = { WB_CTRL_KEEPALIVE };
+        send_ctrl(ka, sizeof(ka));
     }
+    s_ka_dgrams = s_tx_dgrams;
 }
 
+static void ka_timer_cb(void *arg)
+{
+    (void)arg;
+    s_ka_due = true;
+    tx_wake();
+}
+#endif
+
+#if CONFIG_WB_ARQ
+static esp_timer_handle_t s_arq_timer = NULL;
+
+static void arq_resend(uint16_t seq, uint8_t fflags, const uint8_t *buf, uint16_t len)
+{
+    send_frame(&s_peers[0], WB_F_DATA | WB_F_REL | fflags, seq, buf, len);
+}
+
+// udp_tx_task: NACK our gaps, resend what the peer asked for
+static void arq_service(void)
+{
+    wb_nack_t nk;
+    if (wb_arq_rx_build_nack(&nk)) send_ctrl(&nk, sizeof(nk));
+    wb_arq_tx_service(arq_resend);
+}
+
+static void arq_timer_cb(void *arg)
+{
+    (void)arg;
+    if (wb_arq_pending()) tx_wake();
+}
+#endif
+
+#if CONFIG_WB_PMTU
+static esp_timer_handle_t s_pmtu_timer = NULL;
+static uint8_t s_pmtu_buf[WB_MTU_MAX];   // udp_tx_task: padded probe
+
+// udp_tx_task: ack the peer's probe, send ours when due
+static void pmtu_service(void)
+{
+    wb_pmtu_ack_t ack;
+    uint32_t ok, lost;
+
+    reasm_totals(&ok, &lost);
+    if (wb_pmtu_build_ack(&ack, ok, lost)) send_ctrl(&ack, sizeof(ack));
+
+    uint16_t n = wb_pmtu_build_probe(s_pmtu_buf);
+    if (n) send_ctrl(s_pmtu_buf, n);
+}
+
+static void pmtu_timer_cb(void *arg)
+{
+    (void)arg;
+    tx_wake();
+}
+#endif
+
+#if CONFIG_WB_LP
+static esp_timer_handle_t s_lp_timer = NULL;
+
+// udp_tx_task: echo the peer's ping first, it is being timed
+static void lp_service(void)
+{
+    wb_lp_echo_t e;
+    if (wb_lp_build_echo(&e)) send_ctrl(&e, sizeof(e));
+
+    wb_lp_ping_t pg;
+    if (wb_lp_build_ping(&pg)) send_ctrl(&pg, sizeof(pg));
+}
+
+static void lp_timer_cb(void *arg)
+{
+    (void)arg;
+    tx_wake();
+}
+#endif
+
+// Wake udp_tx_task for non-frame work (timers, NACK received)
+static void tx_wake(void)
+{
+    s_tx_wake = true;
+    if (s_tx_task) xTaskNotifyGive(s_tx_task);
+}
+
+#if CONFIG_WB_SHAPE || CONFIG_WB_FEC
+// Shaper hold-off or parity group hold over: udp_tx_task looks again
+static void tx_timer_cb(void *arg)
+{
+    (void)arg;
+    if (s_tx_task) xTaskNotifyGive(s_tx_task);
+}
+#endif
+
 static void udp_tx_task(void *arg)
 {
     (void)arg;
-    tx_item_t it;
+    wb_txq_item_t it;
+    wb_tc_t tc;
+    uint32_t hold_us = 0;
 
     while (1) {
-        if (xQueueReceive(s_txq, &it, portMAX_DELAY) != pdTRUE) continue;
+        if (hold_us || !wb_txq_pending()) {
+#if CONFIG_WB_FEC
+            // nothing sendable: close a partial parity group once it has
+            // waited WB_FEC_HOLD_MS for company, not after every datagram
+            uint32_t fec_us;
+            if (wb_fec_tx_partial_due(&fec_us)) {
+                fec_send_parity();
+            } else if (fec_us) {
+                esp_timer_stop(s_fec_timer);
+                esp_timer_start_once(s_fec_timer, fec_us);
+            }
+#endif
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
 
-        if (!it.buf || it.len == 0 || it.len > WB_MAX_FRAME) {
-            s_drop++;
-            if (it.buf) free(it.buf);
+        if (s_tx_wake) {
+            // link probes (timed, so first) / aggregation deadline / ARQ work /
+            // HC resync / DMX keyframes / PMTU
+            s_tx_wake = false;
+#if CONFIG_WB_LP
+            lp_service();
+#endif
+#if CONFIG_WB_AGG
+            if (s_agg_due) agg_flush();
+#endif
+#if CONFIG_WB_ARQ
+            arq_service();
+#endif
+            wb_hc_resync_t rs;
+            if (wb_hc_build_resync(&rs)) send_ctrl(&rs, sizeof(rs));
+#if CONFIG_WB_DMX_DELTA
+            wb_dmx_keyreq_t kr;
+            if (wb_dmx_build_keyreq(&kr)) send_ctrl(&kr, sizeof(kr));
+#endif
+#if CONFIG_WB_PMTU
+            pmtu_service();
+#endif
+#if CONFIG_WB_HUB
+            hub_pmtu_acks();
+#endif
+#if CONFIG_WB_ROLE_STA
+            ka_service();
+#endif
+        }
+
+        if (!wb_txq_pop(&it, &tc, &hold_us)) {
+#if CONFIG_WB_SHAPE
+            // everything queued is over its rate: sleep until a bucket refills
+            if (hold_us) {
+                esp_timer_stop(s_shape_timer);
+                esp_timer_start_once(s_shape_timer, hold_us);
+            }
+#endif
             continue;
         }
 
-        uint16_t seq = s_seq++;
-        uint16_t frame_len = it.len;
+        if (!it.buf || it.len == 0 || it.len > WB_MAX_FRAME) {
+            wb_stats_inc(WB_CTR_TUN_TX_DROP);
+            wb_pool_free(it.buf);
+            continue;
+        }
 
-        for (uint16_t off = 0; off < frame_len; ) {
-            uint16_t frag = (uint16_t)(frame_len - off);
-            if (frag > WB_MTU) frag = WB_MTU;
+        uint8_t *f = it.buf + it.off;
+        uint16_t len = it.len;
+        uint8_t ff = 0;
+        uint32_t t_in = it.t_in_us ? it.t_in_us : it.t_us, t_deq = 0;
+#if CONFIG_WB_LAT
+        t_deq = (uint32_t)esp_timer_get_time();
+        wb_stats_lat_add(WB_LAT_TX_QUEUE, t_deq - it.t_us);
+#endif
+        wb_cap_frame(WB_CAP_TUN_OUT, f, len);
 
-            uint8_t out[sizeof(wb_hdr_t) + WB_MTU];
+        // classify on the plain frame, before any codec touches it
+#if CONFIG_WB_ARQ
+        bool bulk = wb_arq_is_bulk(f, len);
+#endif
+#if CONFIG_WB_COMP
+        uint8_t cflow = wb_comp_flow(f, len);
+#endif
+#if CONFIG_WB_DMX_DELTA
+        if (wb_dmx_encode(&f, &len)) ff |= WB_F_DELTA;
+#endif
+#if CONFIG_WB_HC
+        if (!(ff & WB_F_DELTA) && wb_hc_encode(&f, &len)) ff |= WB_F_HC;
+#endif
+#if CONFIG_WB_COMP
+        if (wb_comp_encode(cflow, f, &len)) ff |= WB_F_COMP;
+#endif
 
-            wb_hdr_t h = {
-                .magic = WB_MAGIC,
-                .ver = WB_VER,
-                .flags = 1,
-                .seq = seq,
-                .frame_len = frame_len,
-                .frag_off = off,
-                .frag_len = frag,
-            };
+#if CONFIG_WB_AGG
+        bool agg = len <= CONFIG_WB_AGG_MAX_FRAME && len + sizeof(wb_agg_rec_t) <= sizeof(s_agg);
+#if CONFIG_WB_ARQ
+        // TCP ACKs and short segments need their own reliable seq
+        agg = agg && !bulk;
+#endif
+        if (agg) {
+            agg_add(it.peer, it.skip, f, len, ff, t_in, t_deq);
+            wb_pool_free(it.buf);
+            if (s_agg_due) agg_flush();
+            continue;
+        }
+        // keep frame order: pending small frames go first
+        agg_flush();
+#endif
 
-            memcpy(out, &h, sizeof(h));
-            memcpy(out + sizeof(h), it.buf + off, frag);
+#if CONFIG_WB_TX_PROFILE
+        uint32_t c0 = esp_cpu_get_cycle_count();
+#endif
 
-            int sent = sendto(s_sock, out, (int)(sizeof(h) + frag), 0,
-                              (struct sockaddr*)&s_peer, sizeof(s_peer));
-            if (sent > 0) s_tx++;
-            else s_drop++;
+#if CONFIG_WB_ARQ
+        if (bulk) {
+            uint16_t seq = wb_arq_next_seq();
+            send_frame(&s_peers[0], WB_F_DATA | WB_F_REL | ff, seq, f, len);
+            wb_arq_tx_store(seq, it.buf, f, len, ff);   // retransmit window owns the buffer now
+            it.buf = NULL;
+        } else
+#endif
+        send_to(it.peer, it.skip, WB_F_DATA | ff, f, len);
 
-            off = (uint16_t)(off + frag);
-        }
+#if CONFIG_WB_TX_PROFILE
+        tx_profile_add(len, esp_cpu_get_cycle_count() - c0);
+#endif
+#if CONFIG_WB_LAT
+        tx_lat_add((uint32_t)esp_timer_get_time(), t_in, t_deq);
+#else
+        (void)t_in;
+        (void)t_deq;
+#endif
 
-        free(it.buf);
+        wb_pool_free(it.buf);
     }
 }
 
@@ -232,66 +1256,184 @@ void wb_udp_start(wb_frame_rx_cb_t cb, void *user)
     s_rx_cb = cb;
     s_rx_user = user;
 
-    s_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
-    if (s_sock < 0) {
-        ESP_LOGE(TAG, "socket() failed");
+    if (!wb_pool_init()) return;
+
+    if (!wb_txq_init()) {
+        ESP_LOGE(TAG, "TX class queues: no RAM");
         return;
     }
 
-    struct sockaddr_in local = {0};
-    local.sin_family = AF_INET;
-    local.sin_port = htons(CONFIG_WB_UDP_PORT);
-    local.sin_addr.s_addr = htonl(INADDR_ANY);
+#if CONFIG_WB_AGG
+    const esp_timer_create_args_t targs = {
+        .callback = agg_timer_cb,
+        .name = "wb_agg",
+    };
+    if (esp_timer_create(&targs, &s_agg_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "esp_timer_create failed");
+        return;
+    }
+#endif
 
-    if (bind(s_sock, (struct sockaddr*)&local, sizeof(local)) != 0) {
-        ESP_LOGE(TAG, "bind() failed");
+#if CONFIG_WB_ARQ
+    const esp_timer_create_args_t aargs = {
+        .callback = arq_timer_cb,
+        .name = "wb_arq",
+    };
+    if (esp_timer_create(&aargs, &s_arq_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_arq_timer, (uint64_t)CONFIG_WB_ARQ_NACK_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "arq timer failed");
         return;
     }
+#endif
 
-    s_peer.sin_family = AF_INET;
-    s_peer.sin_port = htons(CONFIG_WB_UDP_PORT);
+#if CONFIG_WB_SHAPE
+    wb_shape_init();
+    const esp_timer_create_args_t sargs = {
+        .callback = tx_timer_cb,
+        .name = "wb_shape",
+    };
+    if (esp_timer_create(&sargs, &s_shape_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "shape timer failed");
+        return;
+    }
+#endif
 
-#if CONFIG_WB_ROLE_AP
-    s_peer.sin_addr.s_addr = inet_addr("192.168.50.2");
-#else
-    s_peer.sin_addr.s_addr = inet_addr("192.168.50.1");
+#if CONFIG_WB_FEC
+    const esp_timer_create_args_t fargs = {
+        .callback = tx_timer_cb,
+        .name = "wb_fec",
+    };
+    if (esp_timer_create(&fargs, &s_fec_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "fec timer failed");
+        return;
+    }
 #endif
 
-    s_txq = xQueueCreate(16, sizeof(tx_item_t));
-    if (!s_txq) {
-        ESP_LOGE(TAG, "xQueueCreate failed (no RAM)");
+#if CONFIG_WB_PMTU
+    wb_pmtu_init();
+    const esp_timer_create_args_t pargs = {
+        .callback = pmtu_timer_cb,
+        .name = "wb_pmtu",
+    };
+    if (esp_timer_create(&pargs, &s_pmtu_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_pmtu_timer, 100 * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "pmtu timer failed");
         return;
     }
+#endif
 
-    xTaskCreate(udp_rx_task, "wb_udp_rx", 4096, NULL, 18, NULL);
-    xTaskCreate(udp_tx_task, "wb_udp_tx", 4096, NULL, 18, NULL);
+#if CONFIG_WB_LP
+    wb_lp_init();
+    const esp_timer_create_args_t largs = {
+        .callback = lp_timer_cb,
+        .name = "wb_lp",
+    };
+    if (esp_timer_create(&largs, &s_lp_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_lp_timer, (uint64_t)CONFIG_WB_LP_INTERVAL_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "link probe timer failed");
+        return;
+    }
+#endif
 
-    ESP_LOGI(TAG, "UDP tunnel: port=%d peer=%s payload=%d",
-             CONFIG_WB_UDP_PORT,
-#if CONFIG_WB_ROLE_AP
-             "192.168.50.2"
+#if CONFIG_WB_ROLE_STA
+    const esp_timer_create_args_t kargs = {
+        .callback = ka_timer_cb,
+        .name = "wb_ka",
+    };
+    if (esp_timer_create(&kargs, &s_ka_timer) != ESP_OK ||
+        esp_timer_start_periodic(s_ka_timer, (uint64_t)WB_KEEPALIVE_MS * 1000) != ESP_OK) {
+        ESP_LOGE(TAG, "keepalive timer failed");
+        return;
+    }
+#endif
+
+    peers_init();
+#if CONFIG_WB_CRYPT
+    if (!wb_crypt_init()) {
+        ESP_LOGE(TAG, "tunnel not started: no usable key");
+        return;
+    }
+    uint16_t dgram = (uint16_t)(WB_TRANSPORT->mtu - WB_SEC_OVERHEAD);
 #else
-             "192.168.50.1"
+    uint16_t dgram = WB_TRANSPORT->mtu;
+#endif
+#if CONFIG_WB_FEC
+    s_frag_cap = wb_frag_cap(dgram, true);
+#else
+    s_frag_cap = wb_frag_cap(dgram, false);
+#endif
+    if (!WB_TRANSPORT->open(handle_packet)) {
+        ESP_LOGE(TAG, "transport %s failed", WB_TRANSPORT->name);
+        return;
+    }
+
+    wb_task_create(WB_STAGE_UDP_TX, udp_tx_task, NULL, &s_tx_task);
+
+#if CONFIG_WB_HUB
+    ESP_LOGI(TAG, "UDP tunnel hub: peers=.%d-.%d payload=%d transport=%s",
+             WB_IP_STA_BASE, WB_IP_STA_BASE + WB_PEERS - 1, tx_mtu(), WB_TRANSPORT->name);
+#else
+    ESP_LOGI(TAG, "UDP tunnel: peer=.%d payload=%d transport=%s",
+             WB_PEER_LAST, tx_mtu(), WB_TRANSPORT->name);
 #endif
-             , WB_MTU);
 }
 
-bool wb_udp_send_frame(const uint8_t *frame, size_t len)
+// Any task: copy into a pool buffer and queue by class for udp_tx_task
+static bool enqueue_frame(const uint8_t *frame, size_t len, uint8_t peer, uint8_t skip, uint32_t t_in)
 {
-    if (!s_txq || !frame || len == 0 || len > WB_MAX_FRAME) return false;
+    if (!s_tx_task || !frame || len == 0 || len > WB_POOL_BUF_SIZE - WB_TX_HEADROOM) {
+        wb_stats_inc(WB_CTR_TUN_TX_DROP);
+        return false;
+    }
 
-    tx_item_t it = {0};
+    wb_tc_t tc = wb_txq_classify(frame, (uint16_t)len);
+#if CONFIG_WB_SHAPE
+    if (!wb_shape_police(tc, frame, (uint16_t)len)) {
+        wb_stats_inc(WB_CTR_TUN_TX_DROP);
+        return false;
+    }
+#endif
+
+    wb_txq_item_t it = {0};
     it.len = (uint16_t)len;
-    it.buf = (uint8_t*)malloc(len);
+    it.off = WB_TX_HEADROOM;
+    it.peer = peer;
+    it.skip = skip;
+    it.t_in_us = t_in;
+    it.buf = wb_txq_alloc(tc);
     if (!it.buf) {
-        s_drop++;
+        wb_stats_inc(WB_CTR_TUN_TX_DROP);
         return false;
     }
-    memcpy(it.buf, frame, len);
+    memcpy(it.buf + it.off, frame, len);
 
-    if (xQueueSend(s_txq, &it, 0) == pdTRUE) return true;
+    if (wb_txq_push(tc, &it)) {
+        wb_stats_inc(WB_CTR_TUN_TX_FRAMES);
+        xTaskNotifyGive(s_tx_task);
+        return true;
+    }
 
-    free(it.buf);
-    s_drop++;
+    wb_pool_free(it.buf);
+    wb_stats_inc(WB_CTR_TUN_TX_DROP);
     return false;
 }
+
+bool wb_udp_send_frame_at(const uint8_t *frame, size_t len, uint32_t t_in_us)
+{
+    uint8_t peer = 0;
+#if CONFIG_WB_HUB
+    // unicast to the peer the MAC was learned behind, everything else floods
+    uint8_t q = 0;
+    peer = WB_PEER_FLOOD;
+    if (frame && len >= 14 && !(frame[0] & 0x01) &&
+        wb_fdb_lookup(frame, &q) == WB_FDB_REMOTE && q < WB_PEERS) {
+        peer = q;
+    }
+#endif
+    return enqueue_frame(frame, len, peer, WB_PEER_NONE, t_in_us);
+}
+
+bool wb_udp_send_frame(const uint8_t *frame, size_t len)
+{
+    return wb_udp_send_frame_at(frame, len, 0);
+}
@@ -7,7 +7,37 @@ typedef void (*wb_frame_rx_cb_t)(const uint8_t *frame, size_t len, void *user);
 
 void wb_udp_start(wb_frame_rx_cb_t cb, void *user);
 bool wb_udp_send_frame(const uint8_t *frame, size_t len);
+// t_in_us: when the frame reached the bridge (esp_timer, truncated), for
+// the latency histograms; 0 = now
+bool wb_udp_send_frame_at(const uint8_t *frame, size_t len, uint32_t t_in_us);
 
-uint32_t wb_udp_get_tx(void);
-uint32_t wb_udp_get_rx(void);
-uint32_t wb_udp_get_drop(void);
\ No newline at end of file
+// Datagram, frame and drop counters: wb_stats.h
+
+// Per-slot reassembly counters
+typedef struct {
+    uint32_t completed;   // frames delivered from this slot
+    uint32_t timeouts;    // incomplete frames dropped after CONFIG_WB_REASM_TIMEOUT_MS
+    uint32_t evictions;   // incomplete frames pushed out by newer ones (LRU)
+} wb_reasm_slot_stats_t;
+
+int  wb_udp_get_reasm_slots(void);
+bool wb_udp_get_reasm_stats(int slot, wb_reasm_slot_stats_t *out);
+
+// Tunnel peers: one in point-to-point mode, CONFIG_WB_HUB_PEERS on a hub
+#define WB_PEER_FLOOD  0xFF    // every active peer
+#define WB_PEER_NONE   0xFE
+
+typedef struct {
+    bool     active;          // heard from within the idle timeout
+    uint8_t  ip_last;         // 192.168.50.x
+    uint32_t tx_datagrams;
+    uint32_t tx_bytes;        // UDP payload, headers included
+    uint32_t rx_datagrams;
+    uint32_t rx_bytes;
+    uint32_t rx_frames;       // frames delivered from this peer
+    uint32_t rx_lost;         // data seq gaps never filled
+    uint32_t relayed;         // hub: frames from this peer sent on to other peers
+} wb_peer_stats_t;
+
+int  wb_udp_get_peers(void);
+bool wb_udp_get_peer_stats(int peer, wb_peer_stats_t *out);
@@ -0,0 +1,218 @@
+// wb_ctl.c — runtime control commands (serial console, host stdin)
+#include "wb_ctl.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "crypt.h"
+#include "pkt_filter.h"
+#include "shaper.h"
+#include "task_topo.h"
+
+#define WB_CTL_ARGS  24
+#define WB_CTL_TEXT  512     // rejoined rule text
+
+static const wb_ctl_cmd_t k_cmds[] = {
+    { "key", "HEX", "tunnel key: save 64 hex digits to NVS, used from the next start" },
+    { "pf", "[[save] RULES | clear]", "ingress filter: show rules and hits, or replace them" },
+    { "shape", "[[save] CLASS KBPS [BURST] | [save] policy drop|delay]",
+      "shaper: show buckets, or set a class (rt ctrl be bulk bcast) rate, 0 = unlimited" },
+    { "topo", "[[save] SPEC | clear]", "task placement: show stages, or set it for tasks started from now on" },
+};
+
+#define WB_CTL_N ((int)(sizeof(k_cmds) / sizeof(k_cmds[0])))
+
+// argv[from..] joined by single spaces
+static bool join(int argc, char **argv, int from, char *out, size_t n)
+{
+    size_t k = 0;
+    out[0] = '\0';
+    for (int i = from; i < argc; i++) {
+        int w = snprintf(out + k, n - k, "%s%s", k ? " " : "", argv[i]);
+        if (w < 0 || (size_t)w >= n - k) return false;
+        k += (size_t)w;
+    }
+    return true;
+}
+
+static esp_err_t cmd_pf(int argc, char **argv)
+{
+#if CONFIG_WB_PF
+    if (argc == 1) {
+        wb_pf_stats_t st;
+        wb_pf_rule_stats_t r;
+        wb_pf_get_stats(&st);
+        printf("%u rules, %u instructions, %lu frames, %lu dropped\n", st.rules, st.insns,
+               (unsigned long)st.frames, (unsigned long)st.dropped);
+        for (int i = 0; wb_pf_get_rule(i, &r); i++) {
+            printf("  %d: %s  (%lu hits)\n", i, r.text, (unsigned long)r.hits);
+        }
+        return ESP_OK;
+    }
+
+    bool save = strcmp(argv[1], "save") == 0;
+    static char text[WB_CTL_TEXT];
+    if (argc == 2 + save && strcmp(argv[1 + save], "clear") == 0) {
+        text[0] = '\0';
+    } else if (argc == 1 + save || !join(argc, argv, 1 + save, text, sizeof(text))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return wb_pf_set_rules(text, save);
+#else
+    printf("pf: filter not built (WB_PF)\n");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+#if CONFIG_WB_SHAPE
+static int shape_bucket(const char *name)
+{
+    if (strcmp(name, "bcast") == 0) return WB_SHAPE_BCAST;
+    for (int c = 0; c < WB_TC_COUNT; c++) {
+        if (strcmp(name, wb_txq_class_name((wb_tc_t)c)) == 0) return c;
+    }
+    return -1;
+}
+
+// decimal, the whole argument
+static bool parse_u32(const char *s, uint32_t *out)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (!*s || *end || v > UINT32_MAX) return false;
+    *out = (uint32_t)v;
+    return true;
+}
+#endif
+
+static esp_err_t cmd_shape(int argc, char **argv)
+{
+#if CONFIG_WB_SHAPE
+    if (argc == 1) {
+        printf("policy %s\n", wb_shape_get_delay() ? "delay" : "drop");
+        for (int i = 0; i < WB_SHAPE_BUCKETS; i++) {
+            wb_shape_cfg_t c;
+            wb_shape_stats_t st;
+            wb_shape_get(i, &c, &st);
+            printf("  %-5s %6lu kbps burst %6lu  passed %lu delayed %lu dropped %lu\n",
+                   i == WB_SHAPE_BCAST ? "bcast" : wb_txq_class_name((wb_tc_t)i),
+                   (unsigned long)c.rate_kbps, (unsigned long)c.burst, (unsigned long)st.passed,
+                   (unsigned long)st.delayed, (unsigned long)st.dropped);
+        }
+        return ESP_OK;
+    }
+
+    bool save = strcmp(argv[1], "save") == 0;
+    char **a = argv + 1 + save;
+    int n = argc - 1 - save;
+
+    if (n == 2 && strcmp(a[0], "policy") == 0) {
+        if (strcmp(a[1], "delay") == 0) return wb_shape_set_delay(true, save);
+        if (strcmp(a[1], "drop") == 0) return wb_shape_set_delay(false, save);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    int b = n >= 2 && n <= 3 ? shape_bucket(a[0]) : -1;
+    wb_shape_cfg_t c;
+    if (b < 0) return ESP_ERR_INVALID_ARG;
+    wb_shape_get(b, &c, NULL);
+    if (!parse_u32(a[1], &c.rate_kbps) || (n == 3 && !parse_u32(a[2], &c.burst))) return ESP_ERR_INVALID_ARG;
+    return wb_shape_set(b, c.rate_kbps, c.burst, save);
+#else
+    printf("shape: shaper not built (WB_SHAPE)\n");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static esp_err_t cmd_key(int argc, char **argv)
+{
+#if CONFIG_WB_CRYPT
+    uint8_t key[WB_CRYPT_KEY_LEN];
+    if (argc != 2 || !wb_crypt_parse_key(argv[1], key)) return ESP_ERR_INVALID_ARG;
+    esp_err_t err = wb_crypt_save_key(key);
+    memset(key, 0, sizeof(key));
+    memset(argv[1], 0, strlen(argv[1]));     // the line buffer
+    if (err == ESP_OK) printf("key: saved, used from the next start; set the same key on the peer\n");
+    return err;
+#else
+    printf("key: encryption not built (WB_CRYPT)\n");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+static esp_err_t cmd_topo(int argc, char **argv)
+{
+    if (argc == 1) {
+        for (int i = 0; i < WB_STAGE_N; i++) {
+            wb_stage_stats_t s;
+            if (!wb_topo_get_stats((wb_stage_t)i, &s)) continue;
+            char core[5] = "any";
+            if (s.cfg.core != WB_CORE_ANY) snprintf(core, sizeof(core), "%d", s.cfg.core);
+            printf("  %-8s core %-3s prio %2u stack %5u", s.name, core, s.cfg.prio, s.cfg.stack);
+            if (!s.running) printf("  (not running)\n");
+            else if (wb_topo_cpu_stats()) printf("  cpu %llu ms, stack free %lu\n",
+                                                 (unsigned long long)(s.cpu_us / 1000), (unsigned long)s.stack_free);
+            else printf("  stack free %lu\n", (unsigned long)s.stack_free);
+        }
+        return ESP_OK;
+    }
+
+    bool save = strcmp(argv[1], "save") == 0;
+    static char text[WB_CTL_TEXT];
+    if (argc == 2 + save && strcmp(argv[1 + save], "clear") == 0) {
+        text[0] = '\0';
+    } else if (argc == 1 + save || !join(argc, argv, 1 + save, text, sizeof(text))) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = wb_topo_set(text, save);
+    if (err == ESP_OK) printf("topo: running tasks keep their placement%s\n", save ? "; saved for the next start" : "");
+    return err;
+}
+
+const wb_ctl_cmd_t *wb_ctl_cmds(int *n)
+{
+    if (n) *n = WB_CTL_N;
+    return k_cmds;
+}
+
+esp_err_t wb_ctl_run(int argc, char **argv)
+{
+    if (argc < 1) return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    if (strcmp(argv[0], "pf") == 0) err = cmd_pf(argc, argv);
+    else if (strcmp(argv[0], "key") == 0) err = cmd_key(argc, argv);
+    else if (strcmp(argv[0], "shape") == 0) err = cmd_shape(argc, argv);
+    else if (strcmp(argv[0], "topo") == 0) err = cmd_topo(argc, argv);
+    else if (strcmp(argv[0], "help") == 0) {
+        for (int i = 0; i < WB_CTL_N; i++) {
+            printf("%s %s\n    %s\n", k_cmds[i].name, k_cmds[i].args, k_cmds[i].help);
+        }
+        return ESP_OK;
+    }
+
+    if (err == ESP_ERR_INVALID_ARG) {
+        for (int i = 0; i < WB_CTL_N; i++) {
+            if (strcmp(argv[0], k_cmds[i].name) == 0) printf("usage: %s %s\n", k_cmds[i].name, k_cmds[i].args);
+        }
+    } else if (err == ESP_ERR_NOT_FOUND) {
+        printf("%s: unknown command, try help\n", argv[0]);
+    } else if (err != ESP_OK && err != ESP_ERR_NOT_SUPPORTED) {
+        printf("%s: %s\n", argv[0], esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t wb_ctl_line(char *line)
+{
+    char *argv[WB_CTL_ARGS];
+    int argc = 0;
+    char *save = NULL;
+    for (char *t = strtok_r(line, " \t\r\n", &save); t && argc < WB_CTL_ARGS; t = strtok_r(NULL, " \t\r\n", &save)) {
+        argv[argc++] = t;
+    }
+    return argc ? wb_ctl_run(argc, argv) : ESP_OK;
+}
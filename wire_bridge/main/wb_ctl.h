@@ -0,0 +1,34 @@
+#pragma once
+#include "esp_err.h"
+
+// Runtime control commands, one per line: "name arg ...". The device reads
+// them from the serial console (CONFIG_WB_CONSOLE), wb_host from stdin.
+// Results go to stdout.
+//
+//   key HEX                     tunnel key (crypt.h), 64 hex digits, to NVS;
+//                               used from the next start
+//   pf                          ingress filter rules and their hits
+//   pf [save] RULES | clear     replace them (pkt_filter.h); save = NVS too
+//   shape                       shaper policy, bucket limits and counters
+//   shape [save] CLASS KBPS [BURST]
+//                               rate of rt|ctrl|be|bulk|bcast, 0 = unlimited;
+//                               burst in bytes, kept when left out
+//   shape [save] policy drop|delay
+//   topo                        task placement per stage, CPU time, stack
+//   topo [save] SPEC | clear    new placement (task_topo.h) for tasks started
+//                               from now on; save = NVS, used at next start
+
+typedef struct {
+    const char *name;
+    const char *args;     // usage
+    const char *help;
+} wb_ctl_cmd_t;
+
+// All commands; *n = how many
+const wb_ctl_cmd_t *wb_ctl_cmds(int *n);
+
+// argv[0] names the command
+esp_err_t wb_ctl_run(int argc, char **argv);
+
+// Split on blanks and run; a blank line is ESP_OK
+esp_err_t wb_ctl_line(char *line);
@@ -0,0 +1,155 @@
+#pragma once
+// wb_proto.h — tunnel wire format shared by udp_tunnel.c and its codec stages
+#include <stdint.h>
+#include <stdbool.h>
+
+#define WB_MAGIC 0xBEEF
+#define WB_VER   2         // bumped on wire format changes (2: aggregation)
+
+#define WB_MAX_FRAME    1600
+#define WB_MTU          CONFIG_WB_MAX_PAYLOAD     // starting fragment payload (400..1400)
+#define WB_MTU_MIN      400                       // sender never fragments smaller
+#define WB_MTU_MAX      1456                      // 1472 UDP payload - wb_hdr_t - wb_fec_ext_t
+
+// wb_hdr_t.flags
+#define WB_F_DATA  0x01   // carries frame data (always set)
+#define WB_F_AGG   0x02   // payload is a list of wb_agg_rec_t + frame
+#define WB_F_FEC   0x04   // wb_fec_ext_t follows the header
+#define WB_F_CTRL  0x08   // control datagram, payload starts with WB_CTRL_* type
+#define WB_F_REL   0x10   // frame uses the reliable (NACK/retransmit) seq space
+#define WB_F_COMP  0x20   // frame: LZ4 block compressed (comp.c)
+#define WB_F_HC    0x40   // frame: Ethernet header replaced by a context byte (hdr_comp.c)
+#define WB_F_DELTA 0x80   // frame: DMX universe as keyframe or delta (dmx_delta.c)
+
+// Per-frame codec bits; in an aggregate they live in each wb_agg_rec_t
+#define WB_F_FRAME_MASK  (WB_F_HC | WB_F_COMP | WB_F_DELTA)
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  ver;
+    uint8_t  flags;
+    uint16_t seq;
+    uint16_t frame_len;
+    uint16_t frag_off;
+    uint16_t frag_len;
+} wb_hdr_t;
+
+// Aggregated datagram: frag_off=0, frame_len=frag_len, payload = records
+typedef struct __attribute__((packed)) {
+    uint16_t len;             // frame bytes following this record header
+    uint8_t  flags;           // WB_F_FRAME_MASK bits of this frame
+} wb_agg_rec_t;
+
+// FEC extension: data datagrams carry idx < WB_FEC_PARITY_IDX,
+// parity datagram carries idx == WB_FEC_PARITY_IDX and count = datagrams covered
+#define WB_FEC_PARITY_IDX 0xFF
+
+typedef struct __attribute__((packed)) {
+    uint16_t group;
+    uint8_t  idx;
+    uint8_t  count;
+} wb_fec_ext_t;
+
+// Control datagrams: frag_off=0, frame_len=frag_len=payload length
+#define WB_CTRL_NACK       1
+#define WB_CTRL_HC_RESYNC  2
+#define WB_CTRL_DMX_KEYREQ 3
+#define WB_CTRL_PMTU_PROBE 4
+#define WB_CTRL_PMTU_ACK   5
+#define WB_CTRL_LP_PING    6
+#define WB_CTRL_LP_ECHO    7
+#define WB_CTRL_KEEPALIVE  8   // type byte only: a STA that has sent nothing lately
+
+// NACK: bit i of mask = reliable seq (base + i) still missing
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd;
+    uint16_t base;
+    uint32_t mask;
+} wb_nack_t;
+
+// Header compression resync: bit i of mask = context i unknown/stale at sender of this
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd[3];
+    uint32_t mask;
+} wb_hc_resync_t;
+
+// DMX keyframe request: bit i of mask = stream i has no usable keyframe
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd[3];
+    uint32_t mask;
+} wb_dmx_keyreq_t;
+
+// Path MTU probe: zero padded so the whole payload is size bytes
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd;
+    uint16_t id;
+    uint16_t size;
+} wb_pmtu_probe_t;
+
+// Probe ack; also reports the acker's multi-fragment frame outcomes
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd;
+    uint16_t id;
+    uint16_t size;
+    uint16_t rsvd2;
+    uint32_t frames_ok;       // reassembled (cumulative)
+    uint32_t frames_lost;     // timed out / evicted incomplete (cumulative)
+} wb_pmtu_ack_t;
+
+// Link probe; times are the sender's esp_timer, truncated to 32 bits
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  boot;            // random per boot, never 0; a change = sender restarted
+    uint8_t  rsvd[2];
+    uint32_t seq;
+    uint32_t t_tx_us;
+} wb_lp_ping_t;
+
+// Echo of one ping, plus the echoer's cumulative view of our pings
+typedef struct __attribute__((packed)) {
+    uint8_t  type;
+    uint8_t  rsvd[3];
+    uint32_t seq;
+    uint32_t t_tx_us;         // copied from the ping
+    uint32_t hold_us;         // ping arrival -> echo sent, taken out of the RTT
+    uint32_t rx_pings;        // pings received
+    uint32_t rx_expected;     // pings sent by us as far as seq numbers show
+} wb_lp_echo_t;
+
+// Sealed datagram (CONFIG_WB_CRYPT): wb_sec_hdr_t, then the plain
+// datagram encrypted, then a 16-byte AEAD tag. The header is the AAD;
+// the nonce is the salt and seq fields as sent, so it never repeats per
+// sender, and the salt's address byte keeps the senders apart.
+#define WB_MAGIC_SEC     0xBEE5
+#define WB_SEC_TAG_LEN   16
+
+#define WB_SEC_AES_GCM     1
+#define WB_SEC_CHACHAPOLY  2
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t  ver;
+    uint8_t  alg;             // WB_SEC_*
+    uint32_t salt;            // sender's address byte << 24 | random per boot
+    uint64_t seq;             // sender's datagram number: boot count << 40 | n
+} wb_sec_hdr_t;
+
+#define WB_SEC_OVERHEAD  (sizeof(wb_sec_hdr_t) + WB_SEC_TAG_LEN)
+
+_Static_assert(WB_MTU_MAX + sizeof(wb_hdr_t) + sizeof(wb_fec_ext_t) == 1472, "WB_MTU_MAX must fill one IP packet");
+
+// Largest fragment payload in a datagram of dgram bytes (transport mtu).
+// With FEC every datagram carries wb_fec_ext_t and a parity datagram adds
+// a unit header (hdr + u16 len + u16 pad) in front of the folded payload.
+static inline uint16_t wb_frag_cap(uint16_t dgram, bool fec)
+{
+    int n = dgram - (int)sizeof(wb_hdr_t);
+    if (fec) n -= (int)(sizeof(wb_fec_ext_t) + sizeof(wb_hdr_t) + 4);
+    if (n > WB_MTU_MAX) n = WB_MTU_MAX;
+    return n > 0 ? (uint16_t)n : 0;
+}
@@ -0,0 +1,243 @@
+// wb_stats.c — sharded 64-bit bridge counters and their snapshot
+#include "wb_stats.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "wb_stats";
+
+__thread wb_stats_shard_t *wb_stats_self;
+
+static wb_stats_shard_t s_shard[WB_STATS_SHARDS];
+static uint32_t s_nshard;                       // claimed, may pass WB_STATS_SHARDS
+static wb_stats_shard_t s_spill = { .shared = 1 };
+static portMUX_TYPE s_spill_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef struct {
+    volatile uint32_t seq;     // odd while the writer is updating
+    wb_lat_hist_t h;
+} lat_slot_t;
+
+static lat_slot_t s_lat[WB_LAT_N];
+
+static const char *const k_name[WB_CTR_N] = {
+    [WB_CTR_ETH_RX_FRAMES]   = "eth_rx_frames",
+    [WB_CTR_ETH_RX_BYTES]    = "eth_rx_bytes",
+    [WB_CTR_ETH_RX_FILTERED] = "eth_rx_filtered",
+    [WB_CTR_ETH_RX_LOCAL]    = "eth_rx_local",
+    [WB_CTR_ETH_TX_FRAMES]   = "eth_tx_frames",
+    [WB_CTR_ETH_TX_BYTES]    = "eth_tx_bytes",
+    [WB_CTR_ETH_TX_FAIL]     = "eth_tx_fail",
+    [WB_CTR_TUN_TX_FRAMES]   = "tun_tx_frames",
+    [WB_CTR_TUN_TX_DROP]     = "tun_tx_drop",
+    [WB_CTR_TUN_RX_FRAMES]   = "tun_rx_frames",
+    [WB_CTR_TUN_RX_DROP]     = "tun_rx_drop",
+    [WB_CTR_AGG_TX_DGRAMS]   = "agg_tx_dgrams",
+    [WB_CTR_AGG_TX_FRAMES]   = "agg_tx_frames",
+    [WB_CTR_AGG_RX_DGRAMS]   = "agg_rx_dgrams",
+    [WB_CTR_AGG_RX_FRAMES]   = "agg_rx_frames",
+    [WB_CTR_WIFI_TX_DGRAMS]  = "wifi_tx_dgrams",
+    [WB_CTR_WIFI_TX_BYTES]   = "wifi_tx_bytes",
+    [WB_CTR_WIFI_TX_FAIL]    = "wifi_tx_fail",
+    [WB_CTR_WIFI_RX_DGRAMS]  = "wifi_rx_dgrams",
+    [WB_CTR_WIFI_RX_BYTES]   = "wifi_rx_bytes",
+    [WB_CTR_CAP_FRAMES]      = "cap_frames",
+    [WB_CTR_CAP_CYCLES]      = "cap_cycles",
+    [WB_CTR_CAP_FILTERED]    = "cap_filtered",
+    [WB_CTR_CAP_LOST]        = "cap_lost",
+};
+
+// First count from a task: a shard of its own for good
+wb_stats_shard_t *wb_stats_claim(void)
+{
+    uint32_t i = __atomic_fetch_add(&s_nshard, 1, __ATOMIC_RELAXED);
+    if (i < WB_STATS_SHARDS) {
+        wb_stats_self = &s_shard[i];
+    } else {
+        if (i == WB_STATS_SHARDS) ESP_LOGW(TAG, "more than %d writer tasks: the rest share a locked shard",
+                                           WB_STATS_SHARDS);
+        wb_stats_self = &s_spill;
+    }
+    return wb_stats_self;
+}
+
+void wb_stats_add_shared(wb_ctr_t c1, uint32_t v1, wb_ctr_t c2, uint32_t v2)
+{
+    taskENTER_CRITICAL(&s_spill_lock);
+    s_spill.c[c1] += v1;
+    if (c2 < WB_CTR_N) s_spill.c[c2] += v2;
+    taskEXIT_CRITICAL(&s_spill_lock);
+}
+
+// Copy n bytes guarded by seq between its writer's updates. A reader above
+// the writer's priority on the writer's core would spin while it is
+// preempted mid-update: after a few tries, sleep a tick and let it finish.
+static void seq_read(const volatile uint32_t *seq, const void *src, void *dst, size_t n)
+{
+    for (int tries = 1;; tries++) {
+        uint32_t s0 = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+        if (!(s0 & 1)) {
+            memcpy(dst, src, n);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(seq, __ATOMIC_RELAXED) == s0) return;
+        }
+        if (tries % 4 == 0) vTaskDelay(1);
+    }
+}
+
+static void shard_read(const wb_stats_shard_t *s, uint64_t *c)
+{
+    seq_read(&s->seq, (const void *)s->c, c, sizeof(s->c));
+}
+
+void wb_stats_snapshot(wb_stats_t *out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+
+    uint32_t n = __atomic_load_n(&s_nshard, __ATOMIC_ACQUIRE);
+    uint64_t c[WB_CTR_N];
+    for (uint32_t i = 0; i < n && i < WB_STATS_SHARDS; i++) {
+        shard_read(&s_shard[i], c);
+        for (int k = 0; k < WB_CTR_N; k++) out->c[k] += c[k];
+    }
+
+    taskENTER_CRITICAL(&s_spill_lock);
+    for (int k = 0; k < WB_CTR_N; k++) out->c[k] += s_spill.c[k];
+    taskEXIT_CRITICAL(&s_spill_lock);
+
+    out->t_us = esp_timer_get_time();
+    out->writers = n;
+}
+
+uint64_t wb_stats_get(wb_ctr_t c)
+{
+    if (c >= WB_CTR_N) return 0;
+
+    uint32_t n = __atomic_load_n(&s_nshard, __ATOMIC_ACQUIRE);
+    uint64_t sum = 0, v[WB_CTR_N];
+    for (uint32_t i = 0; i < n && i < WB_STATS_SHARDS; i++) {
+        shard_read(&s_shard[i], v);
+        sum += v[c];
+    }
+    taskENTER_CRITICAL(&s_spill_lock);
+    sum += s_spill.c[c];
+    taskEXIT_CRITICAL(&s_spill_lock);
+    return sum;
+}
+
+const char *wb_stats_name(wb_ctr_t c)
+{
+    return c < WB_CTR_N ? k_name[c] : "?";
+}
+
+// ---- latency histograms
+
+static const char *const k_lat_name[WB_LAT_N] = {
+    [WB_LAT_TX_QUEUE]  = "tx_queue",
+    [WB_LAT_TX_FRAG]   = "tx_frag",
+    [WB_LAT_TX_TOTAL]  = "tx_total",
+    [WB_LAT_RX_REASM]  = "rx_reasm",
+    [WB_LAT_RX_EGRESS] = "rx_egress",
+    [WB_LAT_RX_TOTAL]  = "rx_total",
+};
+
+// 0..7 exact, then 8 linear buckets per power of two
+static inline int lat_bucket(uint32_t us)
+{
+    if (us < 8) return (int)us;
+    int e = 31 - __builtin_clz(us);
+    int i = (e - 2) * 8 + (int)((us >> (e - 3)) & 7);
+    return i < WB_LAT_BUCKETS ? i : WB_LAT_BUCKETS - 1;
+}
+
+// Largest value that lands in bucket i
+static uint32_t lat_bucket_top(int i)
+{
+    if (i < 8) return (uint32_t)i;
+    int e = i / 8 + 2;
+    return ((uint32_t)(8 + i % 8 + 1) << (e - 3)) - 1;
+}
+
+void wb_stats_lat_add(wb_lat_t st, uint32_t us)
+{
+    if (st >= WB_LAT_N) return;
+    lat_slot_t *s = &s_lat[st];
+
+    s->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s->h.n++;
+    s->h.sum_us += us;
+    if (us > s->h.max_us) s->h.max_us = us;
+    s->h.b[lat_bucket(us)]++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    s->seq++;
+}
+
+void wb_stats_lat_snapshot(wb_lat_t st, wb_lat_hist_t *out)
+{
+    if (!out) return;
+    if (st >= WB_LAT_N) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    seq_read(&s_lat[st].seq, &s_lat[st].h, out, sizeof(*out));
+}
+
+void wb_stats_lat_sub(wb_lat_hist_t *h, const wb_lat_hist_t *prev)
+{
+    if (!h || !prev) return;
+    uint32_t max = 0;
+    h->n -= prev->n;
+    h->sum_us -= prev->sum_us;
+    for (int i = 0; i < WB_LAT_BUCKETS; i++) {
+        h->b[i] -= prev->b[i];
+        if (h->b[i]) max = lat_bucket_top(i);
+    }
+    if (max < h->max_us) h->max_us = max;
+}
+
+// Smallest bucket top with at least rank samples at or below it
+static uint32_t lat_rank(const wb_lat_hist_t *h, uint64_t rank)
+{
+    uint64_t acc = 0;
+    for (int i = 0; i < WB_LAT_BUCKETS; i++) {
+        acc += h->b[i];
+        if (acc >= rank) {
+            uint32_t top = lat_bucket_top(i);
+            return top < h->max_us ? top : h->max_us;
+        }
+    }
+    return h->max_us;
+}
+
+void wb_stats_lat_pct(const wb_lat_hist_t *h, wb_lat_pct_t *out)
+{
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!h || h->n == 0) return;
+
+    out->n = h->n;
+    out->avg_us = (uint32_t)(h->sum_us / h->n);
+    // nearest rank, rounded up: p99.9 of 100 samples is the largest
+    out->p50_us = lat_rank(h, ((uint64_t)h->n * 500 + 999) / 1000);
+    out->p99_us = lat_rank(h, ((uint64_t)h->n * 990 + 999) / 1000);
+    out->p999_us = lat_rank(h, ((uint64_t)h->n * 999 + 999) / 1000);
+    out->max_us = h->max_us;
+}
+
+void wb_stats_lat_get(wb_lat_t st, wb_lat_pct_t *out)
+{
+    wb_lat_hist_t h;
+    wb_stats_lat_snapshot(st, &h);
+    wb_stats_lat_pct(&h, out);
+}
+
+const char *wb_stats_lat_name(wb_lat_t st)
+{
+    return st < WB_LAT_N ? k_lat_name[st] : "?";
+}
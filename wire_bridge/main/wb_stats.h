@@ -0,0 +1,159 @@
+#pragma once
+#include <stdint.h>
+
+// Bridge counters for the Ethernet, tunnel and Wi-Fi layers. 64-bit, one
+// shard per writing task: an add is a plain add to memory no other task
+// writes, between two bumps of the shard's sequence count. No locks, no
+// atomic read-modify-write. Tasks only: an ISR would share the shard of
+// the task it interrupted.
+
+typedef enum {
+    // Ethernet
+    WB_CTR_ETH_RX_FRAMES,
+    WB_CTR_ETH_RX_BYTES,
+    WB_CTR_ETH_RX_FILTERED,   // dropped by the ingress filter
+    WB_CTR_ETH_RX_LOCAL,      // both hosts on our segment (FDB): not tunnelled
+    WB_CTR_ETH_TX_FRAMES,
+    WB_CTR_ETH_TX_BYTES,
+    WB_CTR_ETH_TX_FAIL,
+
+    // tunnel: frames
+    WB_CTR_TUN_TX_FRAMES,     // queued for udp_tx_task
+    WB_CTR_TUN_TX_DROP,       // policed, no buffer, queue full, no peer
+    WB_CTR_TUN_RX_FRAMES,     // delivered to the Ethernet side
+    WB_CTR_TUN_RX_DROP,       // malformed, undecodable, lost in reassembly
+    WB_CTR_AGG_TX_DGRAMS,     // aggregated datagrams and the frames in them
+    WB_CTR_AGG_TX_FRAMES,
+    WB_CTR_AGG_RX_DGRAMS,
+    WB_CTR_AGG_RX_FRAMES,
+
+    // Wi-Fi: datagrams through the transport, control included
+    WB_CTR_WIFI_TX_DGRAMS,
+    WB_CTR_WIFI_TX_BYTES,
+    WB_CTR_WIFI_TX_FAIL,
+    WB_CTR_WIFI_RX_DGRAMS,
+    WB_CTR_WIFI_RX_BYTES,
+
+    // packet capture (capture.h)
+    WB_CTR_CAP_FRAMES,        // into the ring
+    WB_CTR_CAP_CYCLES,        // CPU cycles recording, filtered and lost frames included
+    WB_CTR_CAP_FILTERED,      // left out by the capture filter
+    WB_CTR_CAP_LOST,          // overwritten before the writer got to them, or slot busy
+
+    WB_CTR_N,
+} wb_ctr_t;
+
+#define WB_STATS_SHARDS 16     // writer tasks; later ones share a locked shard
+
+typedef struct {
+    volatile uint32_t seq;     // odd while the owner is writing
+    uint8_t  shared;           // the overflow shard: written under a lock
+    uint64_t c[WB_CTR_N];
+} wb_stats_shard_t;
+
+typedef struct {
+    uint64_t c[WB_CTR_N];
+    int64_t  t_us;             // esp_timer time the snapshot was taken
+    uint32_t writers;          // tasks that have counted so far
+} wb_stats_t;
+
+// Each shard is read at one instant between its owner's updates; a
+// multi-counter update (frames + bytes) is seen whole or not at all
+void wb_stats_snapshot(wb_stats_t *out);
+
+uint64_t    wb_stats_get(wb_ctr_t c);
+const char *wb_stats_name(wb_ctr_t c);
+
+// ---- per-frame latency (CONFIG_WB_LAT)
+//
+// Time each frame spends inside this bridge, by stage, in log-linear
+// histograms: exact below 8 us, then 8 buckets per power of two (within
+// 12.5 %) up to 16 s. Each stage has a single writer: udp_tx_task for
+// TX, the transport's RX context for RX.
+
+typedef enum {
+    WB_LAT_TX_QUEUE,      // enqueue -> dequeue by udp_tx_task
+    WB_LAT_TX_FRAG,       // dequeue -> last fragment sent: codecs, aggregation hold, fragments
+    WB_LAT_TX_TOTAL,      // Ethernet (hub: tunnel) ingress -> last fragment sent
+    WB_LAT_RX_REASM,      // first -> last fragment, multi-fragment frames only
+    WB_LAT_RX_EGRESS,     // frame handed to Ethernet -> esp_eth_transmit() returned
+    WB_LAT_RX_TOTAL,      // first fragment received -> esp_eth_transmit() returned
+    WB_LAT_N,
+} wb_lat_t;
+
+#define WB_LAT_BUCKETS 176
+
+typedef struct {
+    uint32_t n;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t b[WB_LAT_BUCKETS];
+} wb_lat_hist_t;
+
+typedef struct {
+    uint32_t n;
+    uint32_t avg_us, p50_us, p99_us, p999_us, max_us;   // percentiles: bucket top, at most max
+} wb_lat_pct_t;
+
+void wb_stats_lat_add(wb_lat_t st, uint32_t us);
+
+// Copy of one histogram since start
+void wb_stats_lat_snapshot(wb_lat_t st, wb_lat_hist_t *out);
+// h -= prev: the interval between two copies. Its max is the top of its
+// highest bucket, at most h's max.
+void wb_stats_lat_sub(wb_lat_hist_t *h, const wb_lat_hist_t *prev);
+void wb_stats_lat_pct(const wb_lat_hist_t *h, wb_lat_pct_t *out);
+void wb_stats_lat_get(wb_lat_t st, wb_lat_pct_t *out);   // ~0.7 KB of stack
+const char *wb_stats_lat_name(wb_lat_t st);
+
+// ---- hot path
+
+extern __thread wb_stats_shard_t *wb_stats_self;
+wb_stats_shard_t *wb_stats_claim(void);
+void wb_stats_add_shared(wb_ctr_t c1, uint32_t v1, wb_ctr_t c2, uint32_t v2);
+
+static inline wb_stats_shard_t *wb_stats_begin(void)
+{
+    wb_stats_shard_t *s = wb_stats_self;
+    if (__builtin_expect(!s, 0)) s = wb_stats_claim();
+    if (__builtin_expect(s->shared, 0)) return s;
+    s->seq++;
+    __atomic_thread_fence(__ATOMIC_RELEASE);   // odd seq before the data
+    return s;
+}
+
+static inline void wb_stats_end(wb_stats_shard_t *s)
+{
+    __atomic_thread_fence(__ATOMIC_RELEASE);   // data before the even seq
+    s->seq++;
+}
+
+static inline void wb_stats_add(wb_ctr_t c, uint32_t v)
+{
+    wb_stats_shard_t *s = wb_stats_begin();
+    if (__builtin_expect(s->shared, 0)) {
+        wb_stats_add_shared(c, v, WB_CTR_N, 0);
+        return;
+    }
+    s->c[c] += v;
+    wb_stats_end(s);
+}
+
+static inline void wb_stats_inc(wb_ctr_t c)
+{
+    wb_stats_add(c, 1);
+}
+
+// One frame or datagram and its bytes (or an aggregate and its frames),
+// as one update
+static inline void wb_stats_frame(wb_ctr_t frames, wb_ctr_t bytes, uint32_t len)
+{
+    wb_stats_shard_t *s = wb_stats_begin();
+    if (__builtin_expect(s->shared, 0)) {
+        wb_stats_add_shared(frames, 1, bytes, len);
+        return;
+    }
+    s->c[frames] += 1;
+    s->c[bytes] += len;
+    wb_stats_end(s);
+}
@@ -7,6 +7,7 @@
 #include "esp_event.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
 
 #include "display_status.h"
 #include "buttons.h"
@@ -14,25 +15,27 @@
 #include "bridge_wifi.h"
 #include "udp_tunnel.h"
 #include "eth_tap.h"
+#include "bridge_core.h"
+#include "pmtu.h"
+#include "link_probe.h"
+#include "crypt.h"
+#include "task_topo.h"
+#include "wb_stats.h"
+#include "capture.h"
+#include "wb_ctl.h"
+
+#if CONFIG_WB_CONSOLE
+#include "esp_console.h"
+#endif
 
 static const char *TAG = "wire_bridge";
 static status_t g_st = {0};
 
-// ETH -> UDP
+// ETH -> UDP (bridge_core.c)
 static void on_eth_frame(const uint8_t *frame, size_t len, void *user)
 {
     (void)user;
-    if (!wb_udp_send_frame(frame, len)) {
-        // queue full etc.
-        g_st.udp_drop++;
-    }
-}
-
-// UDP -> ETH
-static void on_udp_frame(const uint8_t *frame, size_t len, void *user)
-{
-    (void)user;
-    (void)wb_eth_send(frame, len);
+    (void)wb_bridge_eth_in(frame, len, wb_eth_rx_time());
 }
 
 static void on_button(wb_btn_t btn, bool pressed, void *user)
@@ -45,9 +48,110 @@ static void on_button(wb_btn_t btn, bool pressed, void *user)
     else if (btn == BTN_DOWN) ui_menu_down();
 }
 
+#if CONFIG_WB_HUB
+// Every 10 s: one line per spoke with its rate, loss and relay count
+static void log_peers(void)
+{
+    static uint32_t tx_prev[CONFIG_WB_HUB_PEERS], rx_prev[CONFIG_WB_HUB_PEERS];
+
+    for (int i = 0; i < wb_udp_get_peers(); i++) {
+        wb_peer_stats_t ps;
+        if (!wb_udp_get_peer_stats(i, &ps)) continue;
+        uint32_t tx_kbps = (ps.tx_bytes - tx_prev[i]) * 8 / 10000;
+        uint32_t rx_kbps = (ps.rx_bytes - rx_prev[i]) * 8 / 10000;
+        tx_prev[i] = ps.tx_bytes;
+        rx_prev[i] = ps.rx_bytes;
+        if (!ps.active && !tx_kbps && !rx_kbps) continue;
+        ESP_LOGI(TAG, "peer .%u %s: tx %lu kbit/s rx %lu kbit/s lost %lu relayed %lu",
+                 ps.ip_last, ps.active ? "up" : "idle",
+                 (unsigned long)tx_kbps, (unsigned long)rx_kbps,
+                 (unsigned long)ps.rx_lost, (unsigned long)ps.relayed);
+    }
+}
+#endif
+
+#if CONFIG_WB_CRYPT
+// Every 10 s: drops by reason and the AEAD cost in cycles per byte
+static void log_crypt(void)
+{
+    wb_crypt_stats_t cs;
+    wb_crypt_get_stats(&cs);
+    ESP_LOGI(TAG, "crypt: sealed %lu opened %lu drop plain %lu bad %lu replay %lu, "
+             "seal %.1f open %.1f cycles/B",
+             (unsigned long)cs.sealed, (unsigned long)cs.opened, (unsigned long)cs.rx_plain,
+             (unsigned long)cs.rx_bad, (unsigned long)cs.rx_replay,
+             cs.seal_bytes ? (double)cs.seal_cycles / cs.seal_bytes : 0.0,
+             cs.open_bytes ? (double)cs.open_cycles / cs.open_bytes : 0.0);
+}
+#endif
+
+#if CONFIG_WB_LAT
+// Every 10 s: time frames spend in the bridge, by stage, since start
+static void log_lat(void)
+{
+    for (int i = 0; i < WB_LAT_N; i++) {
+        wb_lat_pct_t p;
+        wb_stats_lat_get((wb_lat_t)i, &p);
+        if (!p.n) continue;
+        ESP_LOGI(TAG, "lat %s: %lu frames, p50 %lu p99 %lu p99.9 %lu max %lu us",
+                 wb_stats_lat_name((wb_lat_t)i), (unsigned long)p.n, (unsigned long)p.p50_us,
+                 (unsigned long)p.p99_us, (unsigned long)p.p999_us, (unsigned long)p.max_us);
+    }
+}
+#endif
+
+#if CONFIG_WB_CAP
+// Every 10 s while a capture is armed or running
+static void log_cap(void)
+{
+    wb_cap_stats_t cs;
+    wb_cap_get_stats(&cs);
+    if (cs.state == WB_CAP_OFF) return;
+
+    wb_stats_t st;
+    wb_stats_snapshot(&st);
+    uint64_t n = st.c[WB_CTR_CAP_FRAMES] + st.c[WB_CTR_CAP_FILTERED] + st.c[WB_CTR_CAP_LOST];
+    ESP_LOGI(TAG, "cap %s: %llu kept %llu filtered %llu lost, %lu written to %s, ring %lu/%lu, "
+             "%.0f cycles/frame",
+             cs.state == WB_CAP_ARMED ? "armed" : "triggered",
+             (unsigned long long)st.c[WB_CTR_CAP_FRAMES], (unsigned long long)st.c[WB_CTR_CAP_FILTERED],
+             (unsigned long long)st.c[WB_CTR_CAP_LOST], (unsigned long)cs.written,
+             cs.file[0] ? cs.file : "-", (unsigned long)cs.ring_used, (unsigned long)cs.ring_size,
+             n ? (double)st.c[WB_CTR_CAP_CYCLES] / n : 0.0);
+}
+#endif
+
+// Every 10 s: each stage's placement, CPU share and stack headroom
+static void log_stages(void)
+{
+    static uint64_t cpu_prev[WB_STAGE_N];
+    static int64_t t_prev;
+    int64_t now = esp_timer_get_time();
+    int64_t dt = now - t_prev;
+    t_prev = now;
+
+    for (int i = 0; i < WB_STAGE_N; i++) {
+        wb_stage_stats_t s;
+        if (!wb_topo_get_stats((wb_stage_t)i, &s) || !s.running) continue;
+        uint64_t d = s.cpu_us - cpu_prev[i];
+        cpu_prev[i] = s.cpu_us;
+        char core[4] = "any";
+        if (s.cfg.core != WB_CORE_ANY) snprintf(core, sizeof(core), "%d", s.cfg.core);
+        if (wb_topo_cpu_stats()) {
+            ESP_LOGI(TAG, "stage %s: core %s prio %u, cpu %.1f%%, stack free %lu",
+                     s.name, core, s.cfg.prio, dt > 0 ? 100.0 * d / dt : 0.0,
+                     (unsigned long)s.stack_free);
+        } else {
+            ESP_LOGI(TAG, "stage %s: core %s prio %u, stack free %lu",
+                     s.name, core, s.cfg.prio, (unsigned long)s.stack_free);
+        }
+    }
+}
+
 static void status_task(void *arg)
 {
     (void)arg;
+    int ticks = 0;
 
     while (1) {
         wb_wifi_state_t ws = wb_wifi_get_state();
@@ -55,17 +159,86 @@ static void status_task(void *arg)
         g_st.eth_link = wb_eth_link_up();
         g_st.wifi_up  = ws.ok;
         g_st.rssi     = ws.rssi;
+#if CONFIG_WB_PMTU
+        wb_pmtu_set_rssi(ws.ok ? ws.rssi : 0);
+#endif
 
-        g_st.udp_tx   = wb_udp_get_tx();
-        g_st.udp_rx   = wb_udp_get_rx();
-        g_st.udp_drop = wb_udp_get_drop();
+        wb_stats_t st;
+        wb_stats_snapshot(&st);
+        g_st.udp_tx   = st.c[WB_CTR_WIFI_TX_DGRAMS];
+        g_st.udp_rx   = st.c[WB_CTR_WIFI_RX_DGRAMS];
+        g_st.udp_drop = st.c[WB_CTR_TUN_TX_DROP] + st.c[WB_CTR_TUN_RX_DROP] + st.c[WB_CTR_WIFI_TX_FAIL];
+
+#if CONFIG_WB_LP
+        wb_lp_stats_t lp;
+        wb_lp_get_stats(&lp);
+        g_st.link_ok    = lp.up;
+        g_st.rtt_p50_us = lp.rtt_p50_us;
+        g_st.rtt_p99_us = lp.rtt_p99_us;
+        g_st.jitter_us  = lp.jitter_us;
+        g_st.loss_rx_pm = lp.rx_loss_pm;
+        g_st.loss_tx_pm = lp.tx_loss_pm;
+        g_st.reordered  = lp.reordered;
+#endif
 
         display_set_status(&g_st);
 
+        if (++ticks == 40) {
+            ticks = 0;
+            log_stages();
+#if CONFIG_WB_LAT
+            log_lat();
+#endif
+#if CONFIG_WB_HUB
+            log_peers();
+#endif
+#if CONFIG_WB_CRYPT
+            log_crypt();
+#endif
+#if CONFIG_WB_CAP
+            log_cap();
+#endif
+        }
+
         vTaskDelay(pdMS_TO_TICKS(250));
     }
 }
 
+#if CONFIG_WB_CONSOLE
+static int console_cmd(int argc, char **argv)
+{
+    return wb_ctl_run(argc, argv) == ESP_OK ? 0 : 1;
+}
+
+// wb_ctl commands on the console UART
+static void console_start(void)
+{
+    esp_console_repl_t *repl = NULL;
+    esp_console_repl_config_t rc = ESP_CONSOLE_REPL_CONFIG_DEFAULT();
+    rc.prompt = "wb>";
+    esp_console_dev_uart_config_t uc = ESP_CONSOLE_DEV_UART_CONFIG_DEFAULT();
+    esp_err_t err = esp_console_new_repl_uart(&uc, &rc, &repl);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "console not started: %s", esp_err_to_name(err));
+        return;
+    }
+
+    int n;
+    const wb_ctl_cmd_t *c = wb_ctl_cmds(&n);
+    for (int i = 0; i < n; i++) {
+        const esp_console_cmd_t cmd = {
+            .command = c[i].name,
+            .help = c[i].help,
+            .hint = c[i].args,
+            .func = console_cmd,     // argv[0] tells them apart
+        };
+        esp_console_cmd_register(&cmd);
+    }
+    esp_console_register_help_command();
+    esp_console_start_repl(repl);
+}
+#endif
+
 void app_main(void)
 {
     ESP_ERROR_CHECK(nvs_flash_init());
@@ -77,11 +250,19 @@ void app_main(void)
 
     ESP_LOGI(TAG, "Starting WiFi...");
     wb_wifi_start();
+    wb_topo_adopt(WB_STAGE_WIFI, NULL);
 
-    wb_udp_start(on_udp_frame, NULL);
+    wb_bridge_init(wb_eth_send);
+    wb_udp_start(wb_bridge_udp_in, NULL);
     wb_eth_start(on_eth_frame, NULL);
+#if CONFIG_WB_CAP
+    wb_cap_init();
+#endif
 
-    xTaskCreate(status_task, "status", 4096, NULL, 10, NULL);
+    wb_task_create(WB_STAGE_STATUS, status_task, NULL, NULL);
+#if CONFIG_WB_CONSOLE
+    console_start();
+#endif
 
     ESP_LOGI(TAG, "Bridge running");
 }